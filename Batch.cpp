@@ -0,0 +1,408 @@
+//===========================================
+//
+//  Batch.cpp
+//
+// Author: Theo P. (theo_pap@otenet.gr)
+// Language used: C++
+// Copyright: No copyright. You can do with this software whatever
+// you like.
+// Warranty: No warranty. Use this software at your own risk.
+//===========================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <chrono>
+#include <thread>
+#include "Misc.h"
+#include "Parser.h"
+#include "Batch.h"
+
+//===========================================
+// Input of the jobs without an input set: an empty line, so INPUT
+// never waits on the terminal.
+
+static const char NoInput[] = "\n";
+//===========================================
+// Open a str as a read-only stream.
+
+static FILE* OpenInput(const char* s)
+{
+#ifdef _WIN32
+  FILE* fp = tmpfile();
+
+  if (fp != NULL)
+  {
+    fputs(s, fp);
+    rewind(fp);
+  }
+
+  return fp;
+#else
+  return fmemopen((void*) s, strlen(s), "r");
+#endif
+}
+//===========================================
+Batch::Batch()
+{
+  Progs = NULL;
+  NumProgs = ProgsSize = 0;
+  Jobs = NULL;
+  NumJobs = JobsSize = 0;
+  Queues = NULL;
+  NumThreads = 0;
+  Inputs = NULL;
+  NumInputLines = 0;
+  WallSecs = 0.0;
+  Cache = false;
+  JitMode = true;
+  StkLimit = DEF_STK_LIMIT;
+}
+//===========================================
+Batch::~Batch()
+{
+  int i;
+
+  for (i = 0; i < NumJobs; i++)
+    delete [] Jobs[i].Text;
+
+  delete [] Jobs;
+  Jobs = NULL;
+
+  for (i = 0; i < NumProgs; i++)
+  {
+    delete Progs[i].Prog;
+    delete [] Progs[i].Text;
+  }
+
+  delete [] Progs;
+  Progs = NULL;
+  delete [] Queues;
+  Queues = NULL;
+  delete [] Inputs;
+  Inputs = NULL;
+}
+//===========================================
+// Return the index in Progs of program fname.
+// A program not seen before is loaded now, with its output captured.
+
+int Batch::FindProgram(const char* fname)
+{
+  BatchProg* p;
+  int i;
+
+  for (i = 0; i < NumProgs; i++)
+    if (!strcmp(Progs[i].FName, fname))
+      return i;
+
+  if (NumProgs == ProgsSize)  // program array is full, so grow it
+  {
+    ProgsSize = ProgsSize ? 2 * ProgsSize : 16;
+    p = new BatchProg [ProgsSize];
+
+    if (NumProgs)
+      memcpy(p, Progs, NumProgs * sizeof(BatchProg));
+
+    delete [] Progs;
+    Progs = p;
+  }
+
+  p = &Progs[NumProgs];
+  p->FName = fname;
+  p->Prog = new Program;
+  p->Prog->GetContext().Out.SetCapture();
+  p->Ok = p->Prog->Load(fname, Cache) && p->Prog->GetNumErrors() == 0;
+  p->Text = p->Prog->GetContext().Out.ReleaseText(p->TextLen);
+  return NumProgs++;
+}
+//===========================================
+// Append a job that runs program prog, and return it.
+
+BatchJob& Batch::NewJob(int prog)
+{
+  BatchJob* p;
+
+  if (NumJobs == JobsSize)  // job array is full, so grow it
+  {
+    JobsSize = JobsSize ? 2 * JobsSize : 64;
+    p = new BatchJob [JobsSize];
+
+    if (NumJobs)
+      memcpy(p, Jobs, NumJobs * sizeof(BatchJob));
+
+    delete [] Jobs;
+    Jobs = p;
+  }
+
+  p = &Jobs[NumJobs++];
+  p->Prog = prog;
+  p->Input = NULL;
+  p->InputLine = 0;
+  p->Text = NULL;
+  p->TextLen = 0;
+  p->Secs = 0.0;
+  p->Ok = false;
+  return *p;
+}
+//===========================================
+// Load the input sets of the jobs from file fname.
+// Every non-blank line of the file is an input set: the values read
+// by the INPUT commands of one run, separated by blanks.
+// Return false if the file cannot be read.
+
+bool Batch::LoadInputs(const char* fname)
+{
+  FILE* fp;
+  long size;
+  char* p;
+
+  fp = fopen(fname, "rb");
+
+  if (fp == NULL)
+    return false;
+
+  fseek(fp, 0, SEEK_END);
+  size = ftell(fp);
+  rewind(fp);
+
+  if (size < 0)
+  {
+    fclose(fp);
+    return false;
+  }
+
+  delete [] Inputs;
+  Inputs = new char [size+1];
+
+  if (fread(Inputs, 1, size, fp) != size_t(size))
+  {
+    fclose(fp);
+    return false;
+  }
+
+  fclose(fp);
+  Inputs[size] = '\0';
+  NumInputLines = 1;
+
+  // split the file in lines, in place
+  for (p = Inputs; (p = strchr(p, '\n')) != NULL; p++)
+  {
+    *p = '\0';
+    NumInputLines++;
+  }
+
+  return true;
+}
+//===========================================
+// Add the jobs of program fname: one per input set if an inputs file
+// was loaded, else a single one without input.
+
+void Batch::AddProgram(const char* fname)
+{
+  const char *p, *s;
+  int line, prog = FindProgram(fname);
+
+  if (NumInputLines == 0)
+  {
+    NewJob(prog);
+    return;
+  }
+
+  for (line = 1, p = Inputs; line <= NumInputLines; line++)
+  {
+    for (s = p; isspace(*s); s++)
+      ;
+
+    if (*s)  // not a blank line
+    {
+      BatchJob& job = NewJob(prog);
+
+      job.Input = p;
+      job.InputLine = line;
+    }
+
+    p += strlen(p) + 1;
+  }
+}
+//===========================================
+// Run all the jobs on num_threads worker threads.
+// num_threads <= 0 means one thread per CPU.
+
+void Batch::Run(int num_threads)
+{
+  std::thread* threads;
+  auto start = std::chrono::steady_clock::now();
+  int i;
+
+  if (num_threads <= 0)
+    num_threads = std::thread::hardware_concurrency();
+
+  if (num_threads > NumJobs)
+    num_threads = NumJobs;
+
+  if (num_threads > BATCH_MAX_THREADS)
+    num_threads = BATCH_MAX_THREADS;
+
+  if (num_threads < 1)
+    num_threads = 1;
+
+  NumThreads = num_threads;
+  delete [] Queues;
+  Queues = new WorkQueue [NumThreads];
+
+  for (i = 0; i < NumThreads; i++)
+  {
+    Queues[i].Head = int(1LL * i * NumJobs / NumThreads);
+    Queues[i].Tail = int(1LL * (i + 1) * NumJobs / NumThreads);
+  }
+
+  threads = new std::thread [NumThreads];
+
+  for (i = 0; i < NumThreads; i++)
+    threads[i] = std::thread(&Batch::Worker, this, i);
+
+  for (i = 0; i < NumThreads; i++)
+    threads[i].join();
+
+  delete [] threads;
+  WallSecs = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+}
+//===========================================
+// Body of worker thread id.
+
+void Batch::Worker(int id)
+{
+  int job;
+
+  while (NextJob(id, job))
+    RunJob(Jobs[job]);
+}
+//===========================================
+// Get the next job of worker id in job.
+// The worker's own jobs are taken from the front of its range, and
+// the other workers' jobs from the back of theirs, so the owner and
+// the thieves rarely contend for the same job.
+// Return false if no job is left.
+
+bool Batch::NextJob(int id, int& job)
+{
+  int i;
+
+  for (i = 0; i < NumThreads; i++)
+  {
+    WorkQueue& q = Queues[(id + i) % NumThreads];
+    std::lock_guard<std::mutex> lock(q.Lock);
+
+    if (q.Head < q.Tail)
+    {
+      job = i == 0 ? q.Head++ : --q.Tail;
+      return true;
+    }
+  }
+
+  return false;
+}
+//===========================================
+// Run a job on a fresh Parser, capturing its output.
+
+void Batch::RunJob(BatchJob& job)
+{
+  auto start = std::chrono::steady_clock::now();
+  BatchProg& prog = Progs[job.Prog];
+  Parser* p = new Parser(*prog.Prog);
+  Context& ctx = p->GetContext();
+  FILE* in;
+
+  ctx.Out.SetCapture();
+  p->SetJit(JitMode);
+  p->SetStackLimit(StkLimit);
+  in = OpenInput(job.Input ? job.Input : NoInput);
+
+  if (in == NULL)
+  {
+    ctx.Out.PutStr("Cannot open the input set.\n");
+    job.Ok = false;
+  }
+  else
+  {
+    ctx.In = in;
+    job.Ok = p->Execute() && prog.Ok;
+    fclose(in);
+  }
+
+  job.Text = ctx.Out.ReleaseText(job.TextLen);
+  delete p;
+  job.Secs = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+}
+//===========================================
+// Display the output of every job on out, in the order the jobs were
+// added, and the time of every job and the throughput on rpt.
+// Return true if all the jobs ran without errors.
+
+bool Batch::Report(Output& out, Output& rpt)
+{
+  double total_secs = 0.0;
+  int i, failed = 0;
+
+  for (i = 0; i < NumJobs; i++)
+  {
+    BatchJob& job = Jobs[i];
+    BatchProg& prog = Progs[job.Prog];
+
+    out.Printf("=== Job %d: %s", i + 1, prog.FName);
+
+    if (job.InputLine)
+      out.Printf(", input line %d", job.InputLine);
+
+    out.PutStr(" ===\n");
+
+    if (prog.TextLen)  // errors of the load come first
+      out.PutStr(prog.Text, prog.TextLen);
+
+    if (job.TextLen)
+      out.PutStr(job.Text, job.TextLen);
+
+    if ((job.TextLen && job.Text[job.TextLen-1] != '\n') ||
+      (!job.TextLen && prog.TextLen && prog.Text[prog.TextLen-1] != '\n'))
+      out.PutCh('\n');
+  }
+
+  out.Flush();  // program output before the report
+
+  rpt.PutCh('=', SCR_LINE_WIDTH);
+  rpt.PutStr("\nBatch:\n\n");
+  rpt.PutStr(" Job  Status     Wall ms  Program\n");
+  rpt.PutCh('-', 55);
+  rpt.PutCh('\n');
+
+  for (i = 0; i < NumJobs; i++)
+  {
+    BatchJob& job = Jobs[i];
+
+    rpt.Printf("%4d  %-6s  %10.3f  %s", i + 1, job.Ok ? "ok" : "failed",
+      job.Secs * 1000.0, Progs[job.Prog].FName);
+
+    if (job.InputLine)
+      rpt.Printf(", input line %d", job.InputLine);
+
+    rpt.PutCh('\n');
+    total_secs += job.Secs;
+
+    if (!job.Ok)
+      failed++;
+  }
+
+  rpt.Printf("\nJobs = %d, Failed = %d, Threads = %d\n", NumJobs, failed,
+    NumThreads);
+  rpt.Printf("Wall = %.3f s, Jobs/s = %.1f, Job time = %.3f s (%.2fx)\n",
+    WallSecs, WallSecs > 0.0 ? NumJobs / WallSecs : 0.0, total_secs,
+    WallSecs > 0.0 ? total_secs / WallSecs : 0.0);
+  rpt.PutCh('=', SCR_LINE_WIDTH);
+  rpt.PutStr("\n\n");
+  rpt.Flush();
+  return failed == 0;
+}
+//===========================================
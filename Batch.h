@@ -0,0 +1,104 @@
+//===========================================
+//
+//  Batch.h
+//
+// Author: Theo P. (theo_pap@otenet.gr)
+// Language used: C++
+// Copyright: No copyright. You can do with this software whatever
+// you like.
+// Warranty: No warranty. Use this software at your own risk.
+//===========================================
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <mutex>
+#include "Output.h"
+#include "Program.h"
+
+//===========================================
+const int BATCH_MAX_THREADS = 256;  // max num of worker threads
+//===========================================
+struct BatchProg  // a program of a batch, loaded once
+{
+  const char* FName;  // source file name
+  Program* Prog;  // compiled program, shared by all its jobs
+  char* Text;  // captured output of the load, i.e. errors
+  int TextLen;  // num of chars in Text
+  bool Ok;  // true = the load had no errors
+};
+//===========================================
+struct BatchJob  // a program run of a batch
+{
+  int Prog;  // index of program in Progs
+  const char* Input;  // input set read by INPUT, NULL = none
+  int InputLine;  // line num of input set in inputs file, 0 = none
+
+  char* Text;  // captured output of the run
+  int TextLen;  // num of chars in Text
+  double Secs;  // wall time of the run
+  bool Ok;  // true = the run had no errors
+};
+//===========================================
+struct WorkQueue  // jobs of a worker thread
+{
+  std::mutex Lock;  // guards Head and Tail
+  int Head;  // next job taken by the owner
+  int Tail;  // 1 past the last job; thieves take Tail-1
+};
+//===========================================
+//===========================================
+// Batch runner.
+// Runs many programs, or one program with many input sets, on a pool
+// of worker threads inside one process. Every program is loaded and
+// compiled once, before the workers start. Every run has its own
+// Parser, so its own Context, and its output is captured in memory.
+// The jobs are split in equal ranges, one per worker. A worker takes
+// the jobs of its range from the front, and when the range is empty
+// it steals jobs from the back of the ranges of the other workers.
+
+class Batch
+{
+public:
+  Batch();
+  ~Batch();
+
+  bool LoadInputs(const char* fname);
+  void AddProgram(const char* fname);
+
+  void SetCache(bool on)  { Cache = on; }
+  void SetJit(bool on)  { JitMode = on; }
+  void SetStackLimit(int limit)  { StkLimit = limit; }
+  int GetNumJobs() const  { return NumJobs; }
+
+  void Run(int num_threads);
+  bool Report(Output& out, Output& rpt);
+
+private:
+  int FindProgram(const char* fname);
+  BatchJob& NewJob(int prog);
+  void Worker(int id);
+  bool NextJob(int id, int& job);
+  void RunJob(BatchJob& job);
+
+  BatchProg* Progs;  // distinct programs of the jobs
+  int NumProgs;  // num of programs
+  int ProgsSize;  // allocated size of Progs
+
+  BatchJob* Jobs;  // jobs in the order they were added
+  int NumJobs;  // num of jobs
+  int JobsSize;  // allocated size of Jobs
+
+  WorkQueue* Queues;  // one per worker thread
+  int NumThreads;  // num of worker threads
+
+  char* Inputs;  // lines of the inputs file, each NUL-terminated
+  int NumInputLines;  // num of lines in Inputs, 0 = no inputs file
+  double WallSecs;  // wall time of the whole batch
+  bool Cache;  // true = use the compiled caches of the programs
+  bool JitMode;  // true = hot loops of the jobs run as native code
+  int StkLimit;  // max num of items of each stack of a job
+};
+//===========================================
+
+#endif
@@ -0,0 +1,986 @@
+//===========================================
+//
+//  Compiler.cpp
+//
+// Author: Theo P. (theo_pap@otenet.gr)
+// Language used: C++
+// Copyright: No copyright. You can do with this software whatever
+// you like.
+// Warranty: No warranty. Use this software at your own risk.
+//
+// Precedence Table
+// ------------------------------------------------
+// op                     level  func
+// ------------------------------------------------
+// num  var  func  arr  8   CompileFactor()
+// ( )                        7   CompilePar()
+// un+ un-                6   CompileUnPlusMinus()
+// NOT                     5   CompileNot()
+// * / %                   4   CompileMultDivMod()
+// + -                      3   CompileAddSub()
+// < <= > >= = <>  2   CompileComp()
+// AND                     1   CompileAnd()
+// OR                       0   CompileOr()
+// ------------------------------------------------
+//===========================================
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "Error.h"
+#include "Misc.h"
+#include "SupportClasses.h"
+#include "Compiler.h"
+
+//===========================================
+// Names of the opcodes, for the code dump.
+
+static const char* const OpNames[] =
+{
+  "NUM", "VAR", "OR", "AND", "NOT", "LT", "LE", "GT", "GE", "EQ", "NE",
+  "ADD", "SUB", "MUL", "DIV", "MOD", "PLUS", "NEG", "LPAR", "RPAR",
+  "ABS", "SGN", "CINT", "FIX", "SQR", "POW", "EXP", "LOG", "RND", "ARR1",
+  "ARR2", "REF", "SUM", "DOT", "MIN", "MAX", "DUP", "END"
+};
+
+static_assert(sizeof(OpNames) / sizeof(OpNames[0]) == opEND + 1,
+  "OpNames must have a name per OpCode");
+//===========================================
+Compiler::Compiler(Context* ctx)
+{
+  Ctx = ctx;
+  Scn = NULL;
+  Code = NULL;
+  CodeLen = CodeSize = 0;
+  ExprTbl = NULL;
+  Depth = MaxDepth = 0;
+  Attached = false;
+}
+//===========================================
+Compiler::~Compiler()
+{
+  if (!Attached)
+  {
+    delete [] Code;
+    delete [] ExprTbl;
+  }
+
+  Code = NULL;
+  ExprTbl = NULL;
+}
+//===========================================
+// Use the code and the expr table of a compiled cache instead of
+// compiling. The arrays stay owned by the caller.
+
+void Compiler::Attach(Instr* code, int code_len, ExprTblItem* expr_tbl)
+{
+  Code = code;
+  CodeLen = CodeSize = code_len;
+  ExprTbl = expr_tbl;
+  Attached = true;
+}
+//===========================================
+// Return true if token tok is a relational op, i.e. one of:
+//   < <= > >= = <>
+
+bool Compiler::IsRelOp(TokCode tok)
+{
+  return tok >= tcLT && tok <= tcNE;
+}
+//===========================================
+// Compile all the exprs of the program into bytecode.
+// The statements are walked the same way the command executor walks
+// them, and every expr is compiled at the token loc where the
+// executor will evaluate it.
+
+void Compiler::Compile(Scanner& scn)
+{
+  int i, num_toks;
+  bool done = false;
+
+  Scn = &scn;
+  num_toks = Scn->GetNumToks();
+  ExprTbl = new ExprTblItem [num_toks];
+
+  if (ExprTbl == NULL)
+    Ctx->ErrRpt.FatalError(ecMEM_ALLOC);
+
+  for (i = 0; i < num_toks; i++)
+  {
+    ExprTbl[i].Code = -1;
+    ExprTbl[i].Opt = -1;
+    ExprTbl[i].End = -1;
+  }
+
+  Scn->SetPos(0);
+  Scn->ReadToken();
+
+  while (!done)
+  {
+    switch (Scn->GetToken())
+    {
+      case tcEOF:
+        done = true;
+        break;
+
+      // var = expr
+      case tcVAR:
+        if (Scn->ReadToken() == tcEQ)
+        {
+          Scn->ReadToken();
+          CompileExpr();
+        }
+        break;
+
+      // arr(expr [, expr]) = expr
+      case tcARR:
+        Scn->ReadToken();  // read (
+        CompileIndexes();
+
+        if (Scn->GetToken() == tcEQ)
+        {
+          Scn->ReadToken();
+          CompileExpr();
+        }
+        break;
+
+      // DIM arr(expr [, expr]) [, ...]
+      case tcDIM:
+        while (Scn->ReadToken() == tcARR)
+        {
+          Scn->ReadToken();  // read (
+          CompileIndexes();
+
+          if (Scn->GetToken() != tcCOMMA)
+            break;
+        }
+        break;
+
+      // MAT arr = arr * expr
+      case tcMAT:
+        if (Scn->ReadToken() != tcVAR || Scn->ReadToken() != tcEQ ||
+          Scn->ReadToken() != tcVAR || Scn->ReadToken() != tcSTAR)
+          break;
+
+        Scn->ReadToken();
+        CompileExpr();
+        break;
+
+      // IF expr THEN, RANDOMIZE expr, PRECISION expr
+      case tcIF:
+      case tcRANDOMIZE:
+      case tcPRECISION:
+        Scn->ReadToken();
+        CompileExpr();
+        break;
+
+      // FOR var = expr TO expr [ STEP expr ]
+      case tcFOR:
+        if (Scn->ReadToken() != tcVAR || Scn->ReadToken() != tcEQ)
+          break;
+
+        Scn->ReadToken();
+        CompileExpr();
+
+        if (Scn->GetToken() != tcTO)
+          break;
+
+        Scn->ReadToken();
+        CompileExpr();
+
+        if (Scn->GetToken() != tcSTEP)
+          break;
+
+        Scn->ReadToken();
+        CompileExpr();
+        break;
+
+      // WHILE var op expr, UNTIL var op expr
+      case tcWHILE:
+      case tcUNTIL:
+        if (Scn->ReadToken() != tcVAR || !IsRelOp(Scn->ReadToken()))
+          break;
+
+        Scn->ReadToken();
+        CompileExpr();
+        break;
+
+      // PRINT [ str | expr ] [, ...]
+      case tcPRINT:
+        Scn->ReadToken();
+
+        while (Scn->GetToken() != tcEOL && Scn->GetToken() != tcEOF)
+        {
+          if (Scn->GetToken() == tcCOMMA || Scn->GetToken() == tcSEMI ||
+            Scn->GetToken() == tcSTR)
+            Scn->ReadToken();
+          else
+            CompileExpr();
+        }
+        break;
+
+      default:
+        Scn->ReadToken();
+        break;
+    }
+  }
+
+  Scn->SetPos(0);
+}
+//===========================================
+// Compile an expr beginning at the current token.
+
+void Compiler::CompileExpr()
+{
+  int loc = Scn->GetCur();  // loc of 1st token of expr
+
+  ExprTbl[loc].Code = CodeLen;
+  Depth = MaxDepth = 0;
+  CompileOr();
+  Emit(opEND, 0, 0);
+  ExprTbl[loc].End = Scn->GetCur();
+
+  // the VM operand stack has a fixed size
+  if (MaxDepth > MAX_STACK)
+  {
+    Ctx->ErrRpt.Error(ecEXPR_COMPLEX);
+    ExprTbl[loc].Opt = ExprTbl[loc].Code;
+  }
+  else
+    Optimize(loc);
+}
+//===========================================
+// Append an instr to the code buffer.
+// effect = change of operand stack depth caused by the instr.
+
+void Compiler::Emit(OpCode op, int arg, int effect)
+{
+  Instr* p;
+
+  if (CodeLen == CodeSize)  // code buffer is full, so grow it
+  {
+    CodeSize = CodeSize ? 2 * CodeSize : 1024;
+    p = new Instr [CodeSize];
+
+    if (p == NULL)
+      Ctx->ErrRpt.FatalError(ecMEM_ALLOC);
+
+    if (CodeLen)
+      memcpy(p, Code, CodeLen * sizeof(Instr));
+
+    delete [] Code;
+    Code = p;
+  }
+
+  Code[CodeLen].Op = op;
+  Code[CodeLen].Arg = arg;
+  CodeLen++;
+
+  Depth += effect;
+
+  if (Depth > MaxDepth)
+    MaxDepth = Depth;
+}
+//===========================================
+// Append an instr that pushes the number num.
+// num is not in the source, so it is added to NumPool.
+
+void Compiler::EmitNum(double num)
+{
+  Emit(opNUM, Scn->AddNum(num), 1);
+}
+//===========================================
+// Append an instr that pushes the current NUM token.
+// The literal was converted and interned by the scanner.
+
+void Compiler::EmitLit()
+{
+  Emit(opNUM, Scn->GetNumIndex(), 1);
+}
+//===========================================
+// level 0
+// OR
+// opnd1 OR opnd2
+
+void Compiler::CompileOr()
+{
+  CompileAnd();
+
+  while (Scn->GetToken() == tcOR)
+  {
+    Scn->ReadToken();
+    CompileAnd();
+    Emit(opOR, tcOR, -1);
+  }
+}
+//===========================================
+// level 1
+// AND
+// opnd1 AND opnd2
+
+void Compiler::CompileAnd()
+{
+  CompileComp();
+
+  while (Scn->GetToken() == tcAND)
+  {
+    Scn->ReadToken();
+    CompileComp();
+    Emit(opAND, tcAND, -1);
+  }
+}
+//===========================================
+// level 2
+// Comparison
+// opnd1 op opnd2
+// op = rel op, one of:  < <= > >= = <>.
+
+void Compiler::CompileComp()
+{
+  TokCode op;
+
+  CompileAddSub();
+  op = Scn->GetToken();
+
+  if (!IsRelOp(op))  // not a rel op, so do nothing
+    return;
+
+  Scn->ReadToken();
+  CompileAddSub();
+  Emit(OpCode(opLT + (op - tcLT)), op, -1);
+}
+//===========================================
+// level 3
+// Add/Subtract
+// opnd1 op opnd2
+// op =  + -
+
+void Compiler::CompileAddSub()
+{
+  TokCode op;
+
+  CompileMultDivMod();
+
+  while ((op = Scn->GetToken()) == tcPLUS || op == tcMINUS)
+  {
+    Scn->ReadToken();
+    CompileMultDivMod();
+    Emit(op == tcPLUS ? opADD : opSUB, op, -1);
+  }
+}
+//===========================================
+// level 4
+// Multiply/Divide/Modulus
+// opnd1 op opnd2
+// op =  * / %
+
+void Compiler::CompileMultDivMod()
+{
+  TokCode op;
+
+  CompileNot();
+
+  while ((op = Scn->GetToken()) == tcSTAR || op == tcSLASH ||
+    op == tcPERC)
+  {
+    Scn->ReadToken();
+    CompileNot();
+
+    switch (op)
+    {
+      case tcSTAR: Emit(opMUL, op, -1); break;
+      case tcSLASH: Emit(opDIV, op, -1); break;
+      case tcPERC: Emit(opMOD, op, -1); break;
+      default: break;
+    }
+  }
+}
+//===========================================
+// level 5
+// NOT
+// NOT opnd
+
+void Compiler::CompileNot()
+{
+  TokCode op;
+
+  if ((op = Scn->GetToken()) == tcNOT)
+    Scn->ReadToken();
+
+  CompileUnPlusMinus();
+
+  if (op == tcNOT)
+    Emit(opNOT, op, 0);
+}
+//===========================================
+// level 6
+// Unary + -
+// op opnd
+// op =  + -
+
+void Compiler::CompileUnPlusMinus()
+{
+  TokCode op;
+
+  if ((op = Scn->GetToken()) == tcPLUS || op == tcMINUS)
+    Scn->ReadToken();
+
+  CompilePar();
+
+  if (op == tcPLUS || op == tcMINUS)
+    Emit(op == tcPLUS ? opPLUS : opNEG, op, 0);
+}
+//===========================================
+// level 7
+// Parentheses
+// ( )
+
+void Compiler::CompilePar()
+{
+  if (Scn->GetToken() != tcLPAR)  // no parenthesis, so do nothing
+  {
+    CompileFactor();
+    return;
+  }
+
+  Emit(opLPAR, tcLPAR, 0);
+  Scn->ReadToken();
+  CompileOr();
+
+  if (Scn->GetToken() != tcRPAR)
+    Ctx->ErrRpt.Error(ecRPAR_MISSING);
+  else
+    Emit(opRPAR, tcRPAR, 0);
+
+  Scn->ReadToken();
+}
+//===========================================
+// level 8
+// Factor
+// num  var  func()  arr()
+
+void Compiler::CompileFactor()
+{
+  switch (Scn->GetToken())
+  {
+    case tcNUM:
+      EmitLit();
+      Scn->ReadToken();
+      break;
+
+    case tcVAR:
+      Emit(opVAR, Scn->GetVarIndex(), 1);  // var slot
+      Scn->ReadToken();
+      break;
+
+    case tcARR:
+      CompileArr();
+      break;
+
+    case tcABS: CompileFunc(opABS, 1); break;
+    case tcSGN: CompileFunc(opSGN, 1); break;
+    case tcCINT: CompileFunc(opCINT, 1); break;
+    case tcFIX: CompileFunc(opFIX, 1); break;
+    case tcSQR: CompileFunc(opSQR, 1); break;
+    case tcPOW: CompileFunc(opPOW, 2); break;
+    case tcEXP: CompileFunc(opEXP, 1); break;
+    case tcLOG: CompileFunc(opLOG, 1); break;
+    case tcRND: CompileFunc(opRND, 2); break;
+    case tcSUM: CompileVec(opSUM, 1); break;
+    case tcDOT: CompileVec(opDOT, 2); break;
+    case tcMIN: CompileVec(opMIN, 1); break;
+    case tcMAX: CompileVec(opMAX, 1); break;
+
+    default:
+      Ctx->ErrRpt.Error(ecUNEXP_TOKEN, Scn->GetTokStr());
+      EmitNum(0.0);
+      Scn->ReadToken();
+      break;
+  }
+}
+//===========================================
+// Built-in func with nargs arguments.
+// func(x)
+// func(a, b)
+
+void Compiler::CompileFunc(OpCode op, int nargs)
+{
+  TokCode func = Scn->GetToken();
+
+  Scn->ReadToken();  // read (
+
+  if (Scn->GetToken() != tcLPAR)
+  {
+    Ctx->ErrRpt.Error(ecLPAR_MISSING);
+    EmitNum(0.0);
+    return;
+  }
+
+  Scn->ReadToken();  // read 1st arg
+  CompileOr();
+
+  if (nargs == 2)
+  {
+    if (Scn->GetToken() != tcCOMMA)
+    {
+      Ctx->ErrRpt.Error(ecCOMMA_MISSING);
+      EmitNum(0.0);  // dummy 2nd arg
+    }
+    else
+    {
+      Scn->ReadToken();  // read 2nd arg
+      CompileOr();
+    }
+  }
+
+  if (Scn->GetToken() != tcRPAR)
+    Ctx->ErrRpt.Error(ecRPAR_MISSING);
+  else
+    Scn->ReadToken();
+
+  Emit(op, func, 1 - nargs);
+}
+//===========================================
+// Whole-array built-in func with nargs array names as arguments.
+// func(A)
+// func(A, B)
+
+void Compiler::CompileVec(OpCode op, int nargs)
+{
+  TokCode func = Scn->GetToken();
+  int i;
+
+  if (Scn->ReadToken() != tcLPAR)  // read (
+  {
+    Ctx->ErrRpt.Error(ecLPAR_MISSING);
+    EmitNum(0.0);
+    return;
+  }
+
+  for (i = 0; i < nargs; i++)
+  {
+    if (i > 0 && Scn->ReadToken() != tcCOMMA)  // read ,
+    {
+      Ctx->ErrRpt.Error(ecCOMMA_MISSING);
+      break;
+    }
+
+    if (Scn->ReadToken() != tcVAR)  // read array name
+    {
+      Ctx->ErrRpt.Error(ecARR_MISSING);
+      break;
+    }
+
+    Emit(opREF, Scn->GetVarIndex(), 1);  // array slot
+  }
+
+  if (i < nargs)  // keep the operand stack as the op expects it
+  {
+    while (i++ < nargs)
+      EmitNum(0.0);
+  }
+  else if (Scn->ReadToken() != tcRPAR)  // read )
+    Ctx->ErrRpt.Error(ecRPAR_MISSING);
+  else
+    Scn->ReadToken();
+
+  Emit(op, func, 1 - nargs);
+}
+//===========================================
+// Array element.
+// arr(i)
+// arr(i, j)
+
+void Compiler::CompileArr()
+{
+  int arr = Scn->GetVarIndex();  // array slot
+  int nargs = 1;
+
+  Scn->ReadToken();  // read (, always there after an array name
+  Scn->ReadToken();  // read 1st index
+  CompileOr();
+
+  if (Scn->GetToken() == tcCOMMA)
+  {
+    Scn->ReadToken();  // read 2nd index
+    CompileOr();
+    nargs = 2;
+  }
+
+  if (Scn->GetToken() != tcRPAR)
+    Ctx->ErrRpt.Error(ecRPAR_MISSING);
+  else
+    Scn->ReadToken();
+
+  Emit(nargs == 1 ? opARR1 : opARR2, arr, 1 - nargs);
+}
+//===========================================
+// Compile the indexes of an array in a command, each one a separate
+// expr, as the executor evaluates them one by one.
+// The current token is the (. Stop at the token after the ).
+
+void Compiler::CompileIndexes()
+{
+  Scn->ReadToken();
+  CompileExpr();
+
+  if (Scn->GetToken() == tcCOMMA)
+  {
+    Scn->ReadToken();
+    CompileExpr();
+  }
+
+  if (Scn->GetToken() == tcRPAR)
+    Scn->ReadToken();
+}
+//===========================================
+// *** OPTIMIZER ***
+//===========================================
+// Build the optimized code of the expr beginning at token loc and
+// append it to the code buffer. The expr code is the last one in the
+// buffer.
+// The code is walked once, keeping a stack with the 1st instr of the
+// optimized code of every operand, as the VM would keep its value.
+// Every op either becomes a NUM, when its operands are NUMs, or is
+// dropped, or is copied after the code of its operands.
+// The optimized code is never longer than the code, nor does it need
+// a deeper operand stack.
+
+void Compiler::Optimize(int loc)
+{
+  OptItem stk[MAX_STACK];  // operands
+  OptItem* sp = stk;  // 1st free item of stk
+  OptItem *x, *y;  // operands of current op
+  int start = ExprTbl[loc].Code, len = CodeLen - start, n = 0, i;
+  Instr* out;  // optimized code
+  Instr in;  // current instr
+  double res;
+
+  out = new Instr [len];
+
+  if (out == NULL)
+    Ctx->ErrRpt.FatalError(ecMEM_ALLOC);
+
+  for (i = start; i < CodeLen; i++)
+  {
+    in = Code[i];
+
+    switch (in.Op)
+    {
+      case opNUM:
+        sp->Start = n;
+        sp->IsConst = true;
+        sp->Value = Scn->GetNumPool()[in.Arg].Value;
+        sp->IsBool = sp->Value == 0.0 || sp->Value == 1.0;
+        sp->IsNotBool = false;
+        sp++;
+        out[n++] = in;
+        break;
+
+      case opVAR:
+        sp->Start = n;
+        sp->IsConst = sp->IsBool = sp->IsNotBool = false;
+        sp++;
+        out[n++] = in;
+        break;
+
+      // array elements are never folded
+      case opARR1:
+      case opARR2:
+        if (in.Op == opARR2)
+          sp--;
+
+        x = sp - 1;
+        x->IsConst = x->IsBool = x->IsNotBool = false;
+        out[n++] = in;
+        break;
+
+      case opREF:
+        sp->Start = n;
+        sp->IsConst = sp->IsBool = sp->IsNotBool = false;
+        sp++;
+        out[n++] = in;
+        break;
+
+      // whole-array funcs are never folded
+      case opSUM:
+      case opDOT:
+      case opMIN:
+      case opMAX:
+        if (in.Op == opDOT)
+          sp--;
+
+        x = sp - 1;
+        x->IsConst = x->IsBool = x->IsNotBool = false;
+        out[n++] = in;
+        break;
+
+      // no effect on the value
+      case opLPAR:
+      case opRPAR:
+      case opPLUS:
+        break;
+
+      case opEND:
+        out[n++] = in;
+        break;
+
+      // unary ops
+      case opNOT:
+      case opNEG:
+      case opABS:
+      case opSGN:
+      case opCINT:
+      case opFIX:
+      case opSQR:
+      case opEXP:
+      case opLOG:
+        x = sp - 1;
+
+        if (x->IsConst && FoldUnary(in.Op, x->Value, res))
+          FoldTo(*x, out, n, res);
+        else if (in.Op == opNOT && x->IsNotBool)  // NOT NOT b = b
+        {
+          n--;
+          x->IsBool = true;
+          x->IsNotBool = false;
+        }
+        else if (in.Op == opNEG && out[n-1].Op == opNEG)  // - - x = x
+        {
+          n--;
+          x->IsBool = x->IsNotBool = false;
+        }
+        else
+        {
+          x->IsConst = false;
+          x->IsNotBool = in.Op == opNOT && x->IsBool;
+          x->IsBool = in.Op == opNOT;
+          out[n++] = in;
+        }
+        break;
+
+      // binary ops
+      default:
+        y = --sp;
+        x = sp - 1;
+
+        if (x->IsConst && y->IsConst && FoldBinary(in.Op, x->Value,
+          y->Value, res))
+          FoldTo(*x, out, n, res);
+        else if (y->IsConst &&
+          (((in.Op == opMUL || in.Op == opDIV) && y->Value == 1.0) ||
+          ((in.Op == opADD || in.Op == opSUB) && y->Value == 0.0)))
+          n = y->Start;  // x*1, x/1, x+0, x-0 = x
+        else if (x->IsConst &&
+          ((in.Op == opMUL && x->Value == 1.0) ||
+          (in.Op == opADD && x->Value == 0.0)))
+        {
+          // 1*y, 0+y = y: move the code of y over the NUM
+          memmove(out + x->Start, out + y->Start,
+            (n - y->Start) * sizeof(Instr));
+          n -= y->Start - x->Start;
+          y->Start = x->Start;
+          *x = *y;
+        }
+        else if (in.Op == opPOW && y->IsConst && y->Value == 2.0)
+        {
+          // POW(x, 2) = x*x; a single instr x is repeated, else the
+          // value of x is duplicated
+          n = y->Start;
+
+          if (n - x->Start == 1)
+            out[n] = out[x->Start];
+          else
+          {
+            out[n].Op = opDUP;
+            out[n].Arg = tcPOW;
+          }
+
+          out[n+1].Op = opMUL;
+          out[n+1].Arg = tcSTAR;
+          n += 2;
+          x->IsConst = x->IsBool = x->IsNotBool = false;
+        }
+        else
+        {
+          x->IsConst = x->IsNotBool = false;
+          x->IsBool = in.Op >= opOR && in.Op <= opNE;  // logical, rel op
+          out[n++] = in;
+        }
+        break;
+    }
+  }
+
+  // nothing changed, so the code is also the optimized code
+  if (n == len && !memcmp(out, Code + start, len * sizeof(Instr)))
+    ExprTbl[loc].Opt = start;
+  else
+  {
+    ExprTbl[loc].Opt = CodeLen;
+
+    for (i = 0; i < n; i++)
+      Emit(out[i].Op, out[i].Arg, 0);
+  }
+
+  delete [] out;
+}
+//===========================================
+// Replace the code of operand opnd, the last one in out, with a NUM of
+// value value. n is the num of instrs in out.
+
+void Compiler::FoldTo(OptItem& opnd, Instr* out, int& n, double value)
+{
+  n = opnd.Start;
+  out[n].Op = opNUM;
+  out[n].Arg = Scn->AddNum(value);
+  n++;
+
+  opnd.IsConst = true;
+  opnd.Value = value;
+  opnd.IsBool = value == 0.0 || value == 1.0;
+  opnd.IsNotBool = false;
+}
+//===========================================
+// Compute unary op on constant x, the same way as the VM does, and
+// return the result in res.
+// Return false if op cannot be folded: x is out of the domain of op
+// and the VM would raise an error.
+
+bool Compiler::FoldUnary(OpCode op, double x, double& res)
+{
+  switch (op)
+  {
+    case opNOT: res = !x; return true;
+    case opNEG: res = -x; return true;
+    case opABS: res = (x < 0.0) ? -x : x; return true;
+    case opSGN: res = (x < 0.0) ? -1.0 : (x > 0.0) ? 1.0 : 0.0; return true;
+    case opCINT: res = double(RoundOff(x)); return true;
+    case opFIX: res = double(Trunc(x)); return true;
+    case opEXP: res = exp(x); return true;
+
+    case opSQR:
+      if (x < 0.0)
+        return false;
+
+      res = sqrt(x);
+      return true;
+
+    case opLOG:
+      if (x <= 0.0)
+        return false;
+
+      res = log(x);
+      return true;
+
+    default:
+      return false;
+  }
+}
+//===========================================
+// Compute binary op on constants x and y, the same way as the VM does,
+// and return the result in res.
+// Return false if op cannot be folded: the VM would raise an error
+// (division by 0, non-int operand), or op is RND.
+
+bool Compiler::FoldBinary(OpCode op, double x, double y, double& res)
+{
+  switch (op)
+  {
+    case opOR: res = x || y; return true;
+    case opAND: res = x && y; return true;
+    case opLT: res = x < y; return true;
+    case opLE: res = x <= y; return true;
+    case opGT: res = x > y; return true;
+    case opGE: res = x >= y; return true;
+    case opEQ: res = x == y; return true;
+    case opNE: res = x != y; return true;
+    case opADD: res = x + y; return true;
+    case opSUB: res = x - y; return true;
+    case opMUL: res = x * y; return true;
+
+    case opDIV:
+      if (y == 0.0)
+        return false;
+
+      res = x / y;
+      return true;
+
+    case opMOD:
+      if (!IsInt(x) || !IsInt(y) || int(y) == 0)
+        return false;
+
+      res = double(int(x) % int(y));
+      return true;
+
+    case opPOW:
+      if (y < 0.0 || !IsInt(y))
+        return false;
+
+      res = pow(x, y);
+      return true;
+
+    default:  // opRND
+      return false;
+  }
+}
+//===========================================
+// *** CODE DUMP ***
+//===========================================
+// Display the code of every expr of the program, and its optimized
+// code if it differs. scn is the scanner the program was compiled
+// with.
+
+void Compiler::DispCode(const Scanner& scn)
+{
+  const TokItem* toks = scn.GetTokens();
+  int loc;
+
+  Ctx->Out.PutCh('=', SCR_LINE_WIDTH);
+  Ctx->Out.PutStr("\nCompiled exprs:\n\n");
+  Ctx->Out.PutStr("Line  Code\n");
+  Ctx->Out.PutCh('-', SCR_LINE_WIDTH);
+  Ctx->Out.PutCh('\n');
+
+  for (loc = 0; loc < scn.GetNumToks(); loc++)
+  {
+    if (ExprTbl[loc].Code < 0)
+      continue;
+
+    Ctx->Out.Printf("%4d  ", toks[loc].Line);
+    DispInstrs(scn, ExprTbl[loc].Code);
+
+    if (ExprTbl[loc].Opt != ExprTbl[loc].Code)
+    {
+      Ctx->Out.PutStr("  opt ");
+      DispInstrs(scn, ExprTbl[loc].Opt);
+    }
+  }
+
+  Ctx->Out.PutCh('=', SCR_LINE_WIDTH);
+  Ctx->Out.PutCh('\n');
+}
+//===========================================
+// Display the instrs beginning at loc start, up to opEND, on a line.
+
+void Compiler::DispInstrs(const Scanner& scn, int start)
+{
+  const Instr* ip;
+
+  for (ip = Code + start; ip->Op != opEND; ip++)
+  {
+    Ctx->Out.PutStr(OpNames[ip->Op]);
+
+    if (ip->Op == opNUM)
+      Ctx->Out.Printf(" %.15g", scn.GetNumPool()[ip->Arg].Value);
+    else if (ip->Op == opVAR || ip->Op == opARR1 || ip->Op == opARR2 ||
+      ip->Op == opREF)
+      Ctx->Out.Printf(" %s", scn.GetVarName(ip->Arg));
+
+    Ctx->Out.PutCh(' ');
+  }
+
+  Ctx->Out.PutStr("END\n");
+}
+//===========================================
@@ -0,0 +1,188 @@
+//===========================================
+//
+//  Compiler.h
+//
+// Author: Theo P. (theo_pap@otenet.gr)
+// Language used: C++
+// Copyright: No copyright. You can do with this software whatever
+// you like.
+// Warranty: No warranty. Use this software at your own risk.
+//
+// Precedence Table
+// ------------------------------------------------
+// op                     level  func
+// ------------------------------------------------
+// num  var  func  arr  8   CompileFactor()
+// ( )                        7   CompilePar()
+// un+ un-                6   CompileUnPlusMinus()
+// NOT                     5   CompileNot()
+// * / %                   4   CompileMultDivMod()
+// + -                      3   CompileAddSub()
+// < <= > >= = <>  2   CompileComp()
+// AND                     1   CompileAnd()
+// OR                       0   CompileOr()
+// ------------------------------------------------
+//===========================================
+
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "Scanner.h"
+
+//===========================================
+// *** DEFINITIONS ***
+
+enum OpCode  // bytecode operation code
+{
+// operands
+  opNUM,  // push number literal
+  opVAR,  // push var value
+
+// logical ops
+  opOR,
+  opAND,
+  opNOT,
+
+// relational ops
+  opLT,
+  opLE,
+  opGT,
+  opGE,
+  opEQ,
+  opNE,
+
+// arithmetic ops
+  opADD,
+  opSUB,
+  opMUL,
+  opDIV,
+  opMOD,
+  opPLUS,  // unary +
+  opNEG,  // unary -
+
+// parentheses, used for debug info only
+  opLPAR,
+  opRPAR,
+
+// built-in funcs
+  opABS,
+  opSGN,
+  opCINT,
+  opFIX,
+  opSQR,
+  opPOW,
+  opEXP,
+  opLOG,
+  opRND,
+
+// array elements
+  opARR1,  // A(i), pop i, push the element
+  opARR2,  // A(i, j), pop i and j, push the element
+
+// whole-array built-in funcs
+  opREF,  // array name as a func arg, push its slot
+  opSUM,  // pop a slot, push the sum of the elements
+  opDOT,  // pop 2 slots, push the dot product
+  opMIN,  // pop a slot, push the smallest element
+  opMAX,  // pop a slot, push the largest element
+
+// optimized code only
+  opDUP,  // push a copy of the top of the operand stack
+
+  opEND  // end of expr code
+};
+//===========================================
+struct Instr  // bytecode instruction
+{
+  OpCode Op;  // operation code
+  // index in NumPool for opNUM, var index for opVAR, array slot for
+  // opARR1, opARR2 and opREF, source token code for the rest
+  int Arg;
+};
+//===========================================
+struct ExprTblItem  // item of compiled expr table
+{
+  int Code;  // loc of 1st instr of expr in code buffer, -1 = none
+  int Opt;  // loc of 1st instr of optimized code of expr
+  int End;  // loc of 1st token after expr in token array
+};
+//===========================================
+struct OptItem  // operand of an expr being optimized
+{
+  int Start;  // loc of 1st instr of the operand code
+  bool IsConst;  // true = the operand is a NUM
+  bool IsBool;  // true = the operand value is 0 or 1
+  bool IsNotBool;  // true = the operand is NOT of a 0/1 value
+  double Value;  // value of a NUM operand
+};
+//===========================================
+//===========================================
+// Every expr is compiled twice: the code as written, run in debug mode
+// so every op is displayed, and an optimized code, run otherwise.
+// The optimizer folds constant subexprs, drops the parentheses, unary +
+// and identities (x*1, x+0, x-0, x/1, NOT NOT of a 0/1 value, - - x),
+// and turns POW(x, 2) into x*x. An op that would raise a run-time error
+// on its constant operands (e.g. 1/0) is not folded, so the error is
+// still raised when the expr runs.
+
+class Compiler
+{
+public:
+  Compiler(Context* ctx);
+  ~Compiler();
+
+  void Compile(Scanner& scn);
+  void Attach(Instr* code, int code_len, ExprTblItem* expr_tbl);
+  void DispCode(const Scanner& scn);
+
+  // compiled expr beginning at token loc
+  const ExprTblItem& GetExpr(int loc) const  { return ExprTbl[loc]; }
+  const Instr* GetCode() const  { return Code; }
+  int GetCodeLen() const  { return CodeLen; }
+  const ExprTblItem* GetExprTbl() const  { return ExprTbl; }
+
+private:
+  bool IsRelOp(TokCode tok);
+
+  void CompileExpr();
+  void CompileOr();                // level 0
+  void CompileAnd();              // level 1
+  void CompileComp();           // level 2
+  void CompileAddSub();        // level 3
+  void CompileMultDivMod();   // level 4
+  void CompileNot();              // level 5
+  void CompileUnPlusMinus();  // level 6
+  void CompilePar();               // level 7
+  void CompileFactor();           // level 8
+  void CompileFunc(OpCode op, int nargs);
+  void CompileVec(OpCode op, int nargs);
+  void CompileArr();
+  void CompileIndexes();
+
+  void Emit(OpCode op, int arg, int effect);
+  void EmitNum(double num);
+  void EmitLit();
+
+  void Optimize(int loc);
+  void FoldTo(OptItem& opnd, Instr* out, int& n, double value);
+  bool FoldUnary(OpCode op, double x, double& res);
+  bool FoldBinary(OpCode op, double x, double y, double& res);
+  void DispInstrs(const Scanner& scn, int start);
+
+///////////////////////////////////////////
+
+  Context* Ctx;  // state of the interpreter run
+  Scanner* Scn;  // scanner that supplies the tokens
+
+  Instr* Code;  // code buffer
+  int CodeLen;  // num of instrs in code buffer
+  int CodeSize;  // allocated size of code buffer
+
+  ExprTblItem* ExprTbl;  // compiled exprs, indexed by token loc
+  int Depth;  // current operand stack depth of expr
+  int MaxDepth;  // max operand stack depth of expr
+  bool Attached;  // true = the arrays belong to a compiled cache
+};
+//===========================================
+
+#endif
@@ -0,0 +1,33 @@
+//===========================================
+//
+//  Context.cpp
+//
+// Author: Theo P. (theo_pap@otenet.gr)
+// Language used: C++
+// Copyright: No copyright. You can do with this software whatever
+// you like.
+// Warranty: No warranty. Use this software at your own risk.
+//===========================================
+
+#include <stdio.h>
+#include "Context.h"
+
+//===========================================
+Context::Context() : Out(1), ErrRpt(&Out, &Line)
+{
+  Line = 0;
+  In = stdin;
+  RandSeed = 1;  // same as the C library before srand()
+}
+//===========================================
+// Return a pseudo-random num in the range 0 ... RND_MAX.
+// This is the linear congruential generator of the Microsoft C
+// library, so programs get the same RND values as the original
+// interpreter, on every platform.
+
+int Context::Rand()
+{
+  RandSeed = RandSeed * 214013 + 2531011;
+  return (RandSeed >> 16) & RND_MAX;
+}
+//===========================================
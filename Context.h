@@ -0,0 +1,45 @@
+//===========================================
+//
+//  Context.h
+//
+// Author: Theo P. (theo_pap@otenet.gr)
+// Language used: C++
+// Copyright: No copyright. You can do with this software whatever
+// you like.
+// Warranty: No warranty. Use this software at your own risk.
+//===========================================
+
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include <stdio.h>
+#include "Output.h"
+#include "Error.h"
+
+//===========================================
+const int RND_MAX = 32767;  // max value returned by Context::Rand()
+//===========================================
+// Per-run state of an interpreter.
+// Each Parser owns a Context, and all the objects of the Parser reach
+// the state through a pointer to it, so no mutable state is global.
+// Different Parsers can run at the same time on different threads.
+
+class Context
+{
+public:
+  Context();
+
+  void SetRandSeed(unsigned int seed)  { RandSeed = seed; }
+  int Rand();
+
+  int Line;  // current line num in source
+  Output Out;  // program output, stdout by default
+  FILE* In;  // program input, stdin by default
+  ErrReporter ErrRpt;  // error reporter of the run
+
+private:
+  unsigned int RandSeed;  // state of the pseudo-random-number generator
+};
+//===========================================
+
+#endif
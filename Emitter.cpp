@@ -0,0 +1,1463 @@
+//===========================================
+//
+//  Emitter.cpp
+//
+// Author: Theo P. (theo_pap@otenet.gr)
+// Language used: C++
+// Copyright: No copyright. You can do with this software whatever
+// you like.
+// Warranty: No warranty. Use this software at your own risk.
+//===========================================
+
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "Error.h"
+#include "Emitter.h"
+
+//===========================================
+Emitter::Emitter(Program& prog, Output& rpt)
+{
+  int i;
+
+  Prog = &prog;
+  Ctx = &prog.GetContext();
+  Tokens = prog.GetTokens();
+  NumToks = prog.GetNumToks();
+  NumVars = prog.GetNumVars();
+  Rpt = &rpt;
+  Fp = NULL;
+
+  Reached = new bool [NumToks];
+  Labeled = new bool [NumToks];
+  IsDyn = new bool [NumToks];
+  LoopTop = new int [NumToks];
+  Work = new int [NumToks];
+
+  if (Reached == NULL || Labeled == NULL || IsDyn == NULL ||
+    LoopTop == NULL || Work == NULL)
+    Ctx->ErrRpt.FatalError(ecMEM_ALLOC);
+
+  for (i = 0; i < NumToks; i++)
+  {
+    Reached[i] = Labeled[i] = IsDyn[i] = false;
+    LoopTop[i] = -1;
+  }
+
+  NumWork = 0;
+  NumTemps = MaxTemps = 0;
+  LineSet = CanFail = false;
+  UsesLoc = false;
+  Failed = false;
+}
+//===========================================
+Emitter::~Emitter()
+{
+  delete [] Reached;
+  delete [] Labeled;
+  delete [] IsDyn;
+  delete [] LoopTop;
+  delete [] Work;
+}
+//===========================================
+// Translate the program into the C++ file fname.
+// The 1st pass finds the commands that can be run and the locs that
+// need a label; the 2nd pass writes the code of those commands in
+// source order. Return false if the program cannot be translated.
+
+bool Emitter::Emit(const char* fname)
+{
+  int loc, succ, line = -1;
+
+  if (!Prog->IsLoaded() || Prog->GetNumErrors() || NumToks == 0)
+  {
+    Rpt->PutStr("Cannot translate a program with errors.\n");
+    return false;
+  }
+
+  // 1st pass: nothing is written
+  Reach(0);
+
+  while (NumWork > 0 && !Failed)
+  {
+    loc = Work[--NumWork];
+    succ = EmitCmd(loc);
+
+    if (succ != EMIT_NONE)
+    {
+      Reach(succ);
+
+      if (succ <= loc)  // always a goto
+        Labeled[succ] = true;
+    }
+  }
+
+  if (Failed)
+    return false;
+
+  // 2nd pass
+  Fp = fopen(fname, "w");
+
+  if (Fp == NULL)
+  {
+    Rpt->Printf("Cannot write C++ file %s.\n", fname);
+    return false;
+  }
+
+  Put("//===========================================\n");
+  Put("// %s\n", fname);
+  Put("// Translated from BASIC by Interpreter --emit-cpp.\n");
+  Put("// Build it with the support library, from the interpreter "
+    "sources:\n");
+  Put("//   g++ -O2 -I<src> %s <src>/Runtime.cpp <src>/Context.cpp \\\n",
+    fname);
+  Put("//     <src>/Output.cpp <src>/Error.cpp <src>/Misc.cpp \\\n");
+  Put("//     <src>/SupportClasses.cpp <src>/Simd.cpp\n");
+  Put("// (no -ffast-math, or the numbers may differ from the "
+    "interpreter's)\n");
+  Put("//===========================================\n\n");
+  Put("#include \"Runtime.h\"\n\n");
+  Put("int main()\n{\n");
+  Put("  Runtime Rt;\n");
+  Put("  double Vars[%d] = {};\n", NumVars > 0 ? NumVars : 1);
+
+  PutVars();
+
+  if (MaxTemps > 0)
+  {
+    Put("  double t0");
+
+    for (loc = 1; loc < MaxTemps; loc++)
+      Put(", t%d", loc);
+
+    Put(";\n");
+  }
+
+  if (UsesLoc)
+    Put("  int Loc;\n");
+
+  for (loc = 0; loc < NumToks; loc++)
+  {
+    if (!Reached[loc])
+      continue;
+
+    if (Tokens[loc].Line != line && Tokens[loc].Token != tcEOL)
+    {
+      line = Tokens[loc].Line;
+      Put("\n  // line %d\n", line);
+    }
+
+    if (Labeled[loc])
+      Put("L%d:\n", loc);
+
+    succ = EmitCmd(loc);
+
+    if (succ != EMIT_NONE && succ != NextReached(loc))
+      Jump(NULL, succ);
+  }
+
+  // the locs that a stack returns
+  if (UsesLoc)
+  {
+    Put("\ndispatch:\n");
+    Put("  switch (Loc)\n  {\n");
+
+    for (loc = 0; loc < NumToks; loc++)
+      if (IsDyn[loc])
+        Put("    case %d: goto L%d;\n", loc, loc);
+
+    Put("  }\n\n");
+    Put("  return Rt.Finish(false);\n");
+  }
+
+  Put("}\n");
+  Put("//===========================================\n");
+
+  if (fclose(Fp) != 0)
+  {
+    Rpt->Printf("Cannot write C++ file %s.\n", fname);
+    Fp = NULL;
+    return false;
+  }
+
+  Fp = NULL;
+  return true;
+}
+//===========================================
+// Declare a named reference to every var of the program, so the code
+// reads like the source. The names get a V_ prefix, so they cannot
+// clash with C++ names. An array gets a const A_ name for its slot.
+
+void Emitter::PutVars()
+{
+  bool* is_arr = new bool [NumVars > 0 ? NumVars : 1];
+  bool any = false;
+  int i;
+
+  for (i = 0; i < NumVars; i++)
+  {
+    Put("  double& V_%s = Vars[%d];\n", Prog->GetVarName(i), i);
+    is_arr[i] = false;
+  }
+
+  for (i = 0; i < NumToks; i++)
+    switch (Tokens[i].Token)
+    {
+      case tcARR:
+        is_arr[Tokens[i].Index] = any = true;
+        break;
+
+      // func(A [, B])
+      case tcSUM:
+      case tcDOT:
+      case tcMIN:
+      case tcMAX:
+        if (Tokens[i+1].Token != tcLPAR || Tokens[i+2].Token != tcVAR)
+          break;
+
+        is_arr[Tokens[i+2].Index] = any = true;
+
+        if (Tokens[i].Token == tcDOT && Tokens[i+3].Token == tcCOMMA &&
+          Tokens[i+4].Token == tcVAR)
+          is_arr[Tokens[i+4].Index] = true;
+        break;
+
+      // MAT C = A + B | A * expr | func(A)
+      case tcMAT:
+        if (Tokens[i+1].Token != tcVAR || Tokens[i+2].Token != tcEQ)
+          break;
+
+        is_arr[Tokens[i+1].Index] = any = true;
+
+        if (Tokens[i+3].Token == tcVAR)
+        {
+          is_arr[Tokens[i+3].Index] = true;
+
+          if (Tokens[i+4].Token == tcPLUS && Tokens[i+5].Token == tcVAR)
+            is_arr[Tokens[i+5].Index] = true;
+        }
+        else if ((Tokens[i+3].Token == tcSQR || Tokens[i+3].Token == tcEXP ||
+          Tokens[i+3].Token == tcLOG) && Tokens[i+4].Token == tcLPAR &&
+          Tokens[i+5].Token == tcVAR)
+          is_arr[Tokens[i+5].Index] = true;
+        break;
+
+      default:
+        break;
+    }
+
+  for (i = 0; i < NumVars; i++)
+    if (is_arr[i])
+      Put("  const int A_%s = %d;\n", Prog->GetVarName(i), i);
+
+  if (any)
+    Put("  Rt.InitArrays(%d);\n", NumVars);
+
+  delete [] is_arr;
+}
+//===========================================
+// *** PASSES ***
+//===========================================
+// Mark loc as a command that can be run, and scan it later.
+
+void Emitter::Reach(int loc)
+{
+  if (Reached[loc])
+    return;
+
+  Reached[loc] = true;
+  Work[NumWork++] = loc;
+}
+//===========================================
+// Return the 1st loc after loc that can be run, -1 = none.
+
+int Emitter::NextReached(int loc)
+{
+  for (loc++; loc < NumToks; loc++)
+    if (Reached[loc])
+      return loc;
+
+  return -1;
+}
+//===========================================
+// loc is entered from a stack, through the dispatch switch.
+
+void Emitter::Dynamic(int loc)
+{
+  IsDyn[loc] = true;
+  Labeled[loc] = true;
+  UsesLoc = true;
+  Reach(loc);
+}
+//===========================================
+// Emit the code of the command at loc.
+// Return the loc of the command run next when the code falls through,
+// or EMIT_NONE if it never does.
+
+int Emitter::EmitCmd(int loc)
+{
+  const TokItem& t = Tokens[loc];
+
+  CurLoc = loc;
+  NumTemps = 0;
+  LineSet = CanFail = false;
+
+  switch (t.Token)
+  {
+    case tcVAR:
+      return EmitAssign(loc);
+
+    case tcARR:
+      return EmitSetArr(loc);
+
+    case tcDIM:
+      return EmitDim(loc);
+
+    case tcMAT:
+      return EmitMat(loc);
+
+    case tcIF:
+      return EmitIf(loc);
+
+    case tcELSE:  // skip block2
+      if (t.Jump < 0)
+        break;
+
+      return Tokens[t.Jump].Token == tcENDIF ? t.Jump + 1 : t.Jump;
+
+    case tcGOTO:
+      return EmitGoto(loc, false);
+
+    case tcGOSUB:
+      return EmitGoto(loc, true);
+
+    case tcRETURN:
+      SetLine(loc);
+      UsesLoc = true;
+      Put("  Loc = Rt.Return();\n");
+      CheckAbort();
+      Put("  if (Loc >= 0) goto dispatch;\n");
+      return loc + 1;
+
+    case tcFOR:
+      return EmitFor(loc);
+
+    case tcNEXT:
+      return EmitLoopEnd(loc, "Next(Vars)");
+
+    case tcWHILE:
+      return EmitWhile(loc);
+
+    case tcWEND:
+      return EmitLoopEnd(loc, "Wend(Vars)");
+
+    case tcDO:
+      if (Tokens[t.Jump].Token == tcUNTIL)
+        LoopTop[t.Jump] = loc + 1;
+
+      Dynamic(loc + 1);
+      SetLine(loc);
+      Put("  Rt.Do(%d);\n", loc + 1);
+      CheckAbort();
+      return loc + 1;
+
+    case tcUNTIL:
+      return EmitUntil(loc);
+
+    case tcBREAK:
+      return EmitBreak(loc);
+
+    case tcCONTINUE:  // go to the end of the innermost loop
+      if (t.Jump < 0)
+        break;
+
+      return t.Jump;
+
+    case tcINPUT:
+      return EmitInput(loc);
+
+    case tcPRINT:
+      return EmitPrint(loc);
+
+    case tcRANDOMIZE:
+      return EmitCall(loc, "Randomize");
+
+    case tcPRECISION:
+      return EmitCall(loc, "SetPrecision");
+
+    case tcDEB_MODE:
+      if (Tokens[loc+1].Token == tcOFF)
+        return loc + 2;
+
+      Fail(loc, "DEB_MODE ON");
+      return EMIT_NONE;
+
+    case tcEND:
+      Put("  return Rt.Finish(true);\n");
+      return EMIT_NONE;
+
+    case tcEOF:  // END is missing
+      SetLine(loc);
+      Put("  return Rt.Finish(false);\n");
+      return EMIT_NONE;
+
+    default:  // EOL, ENDIF and the rest do nothing
+      return loc + 1;
+  }
+
+  Fail(loc, "a block without its end");
+  return EMIT_NONE;
+}
+//===========================================
+// *** COMMANDS ***
+//===========================================
+// var = expr
+
+int Emitter::EmitAssign(int loc)
+{
+  char* s;
+
+  if (Tokens[loc+1].Token != tcEQ)
+  {
+    Fail(loc, "an assignment without =");
+    return EMIT_NONE;
+  }
+
+  s = Expr(loc + 2, false);
+
+  if (s == NULL)
+    return EMIT_NONE;
+
+  Put("  V_%s = %s;\n", VarName(loc), Bare(s));
+  delete [] s;
+  CheckAbort();
+  return Prog->GetExpr(loc + 2).End;
+}
+//===========================================
+// arr(i [, j]) = expr
+// The indexes are computed before expr, as in the executor.
+
+int Emitter::EmitSetArr(int loc)
+{
+  char *i, *j = NULL, *s;
+  int next = Prog->GetExpr(loc + 2).End;
+
+  i = Expr(loc + 2, false);
+
+  if (i == NULL)
+    return EMIT_NONE;
+
+  if (Tokens[next].Token == tcCOMMA)
+  {
+    j = Expr(next + 1, false);
+    next = Prog->GetExpr(next + 1).End;
+  }
+
+  if (!Failed &&
+    (Tokens[next].Token != tcRPAR || Tokens[next+1].Token != tcEQ))
+    Fail(loc, "an array assignment without ) =");
+
+  if (Failed)
+  {
+    delete [] i;
+    delete [] j;
+    return EMIT_NONE;
+  }
+
+  s = Expr(next + 2, false);
+
+  if (s != NULL)
+  {
+    if (!LineSet)
+      SetLine(loc);
+
+    if (j == NULL)
+      Put("  Rt.SetArr(A_%s, %s, %s);\n", VarName(loc), Bare(i), Bare(s));
+    else
+      Put("  Rt.SetArr(A_%s, %s, %s, %s);\n", VarName(loc), Bare(i),
+        Bare(j), Bare(s));
+
+    CheckAbort();
+  }
+
+  delete [] i;
+  delete [] j;
+  delete [] s;
+  return s != NULL ? Prog->GetExpr(next + 2).End : EMIT_NONE;
+}
+//===========================================
+// DIM arr(n [, m]) [, ...]
+
+int Emitter::EmitDim(int loc)
+{
+  char *n, *m;
+  int arr, next = loc + 1;
+
+  for (;;)
+  {
+    if (Tokens[next].Token != tcARR)
+    {
+      Fail(loc, "DIM without an array");
+      return EMIT_NONE;
+    }
+
+    arr = next;
+    next = Prog->GetExpr(arr + 2).End;
+    n = Expr(arr + 2, false);
+    m = NULL;
+
+    if (n != NULL && Tokens[next].Token == tcCOMMA)
+    {
+      m = Expr(next + 1, false);
+      next = Prog->GetExpr(next + 1).End;
+    }
+
+    if (!Failed && Tokens[next].Token != tcRPAR)
+      Fail(loc, "DIM without )");
+
+    if (Failed)
+    {
+      delete [] n;
+      delete [] m;
+      return EMIT_NONE;
+    }
+
+    if (!LineSet)
+      SetLine(loc);
+
+    if (m == NULL)
+      Put("  Rt.Dim(A_%s, %s);\n", VarName(arr), Bare(n));
+    else
+      Put("  Rt.Dim(A_%s, %s, %s);\n", VarName(arr), Bare(n), Bare(m));
+
+    delete [] n;
+    delete [] m;
+
+    if (Tokens[++next].Token != tcCOMMA)
+      break;
+
+    next++;
+  }
+
+  CheckAbort();
+  return next;
+}
+//===========================================
+// IF expr THEN block1 [ ELSE block2 ] ENDIF
+
+int Emitter::EmitIf(int loc)
+{
+  const ExprTblItem& e = Prog->GetExpr(loc + 1);
+  int false_loc = Tokens[loc].Jump;
+  char *s, *cond;
+
+  s = Expr(loc + 1, true);
+
+  if (s == NULL)
+    return EMIT_NONE;
+
+  if (Tokens[e.End].Token != tcTHEN)
+  {
+    delete [] s;
+    Fail(loc, "IF without THEN");
+    return EMIT_NONE;
+  }
+
+  if (Tokens[false_loc].Token == tcELSE || Tokens[false_loc].Token == tcENDIF)
+    false_loc++;
+
+  CheckAbort();
+  cond = Format("!%s", s);
+  Jump(cond, false_loc);
+  delete [] cond;
+  delete [] s;
+  return e.End + 2;
+}
+//===========================================
+// GOTO label, GOSUB label
+
+int Emitter::EmitGoto(int loc, bool gosub)
+{
+  const TokItem& t = Tokens[loc+1];
+
+  if (t.Token != tcNUM)
+  {
+    Fail(loc, "an invalid label");
+    return EMIT_NONE;
+  }
+
+  if (t.Jump < 0)
+  {
+    Fail(loc, "an undefined label");
+    return EMIT_NONE;
+  }
+
+  if (gosub)  // push the return loc
+  {
+    Dynamic(loc + 2);
+    SetLine(loc);
+    Put("  Rt.Gosub(%d);\n", loc + 2);
+    CheckAbort();
+  }
+
+  return t.Jump;
+}
+//===========================================
+// FOR var = start TO end [ STEP step ]
+
+int Emitter::EmitFor(int loc)
+{
+  int next_loc = Tokens[loc].Jump;
+  int end_loc, body;
+  char *start = NULL, *end = NULL, *step = NULL;
+
+  if (Tokens[loc+1].Token != tcVAR || Tokens[loc+2].Token != tcEQ)
+  {
+    Fail(loc, "FOR without var =");
+    return EMIT_NONE;
+  }
+
+  if (Tokens[next_loc].Token != tcNEXT)
+  {
+    Fail(loc, "FOR without NEXT");
+    return EMIT_NONE;
+  }
+
+  start = Expr(loc + 3, false);
+
+  if (start == NULL)
+    return EMIT_NONE;
+
+  end_loc = Prog->GetExpr(loc + 3).End;
+
+  if (Tokens[end_loc].Token == tcTO)
+    end = Expr(end_loc + 1, false);
+
+  if (end == NULL)
+  {
+    delete [] start;
+    Fail(loc, "FOR without TO");
+    return EMIT_NONE;
+  }
+
+  end_loc = Prog->GetExpr(end_loc + 1).End;
+
+  if (Tokens[end_loc].Token == tcSTEP)
+  {
+    step = Expr(end_loc + 1, false);
+
+    if (step == NULL)
+    {
+      delete [] start;
+      delete [] end;
+      return EMIT_NONE;
+    }
+
+    end_loc = Prog->GetExpr(end_loc + 1).End;
+  }
+
+  body = end_loc + 1;
+  Dynamic(body);
+  LoopTop[next_loc] = body;
+
+  if (!LineSet)
+    SetLine(loc);
+
+  Put("  Loc = Rt.For(Vars, %d, %s, %s, %s, %d);\n", VarIndex(loc + 1),
+    Bare(start), Bare(end), step != NULL ? Bare(step) : "1.0", body);
+  delete [] start;
+  delete [] end;
+  delete [] step;
+
+  CanFail = true;
+  CheckAbort();
+  Jump("!Loc", next_loc + 1);  // skip the loop
+  return body;
+}
+//===========================================
+// WHILE var op expr
+
+int Emitter::EmitWhile(int loc)
+{
+  int wend_loc = Tokens[loc].Jump;
+  int tmp, body;
+  char* s;
+
+  if (Tokens[wend_loc].Token != tcWEND)
+  {
+    Fail(loc, "WHILE without WEND");
+    return EMIT_NONE;
+  }
+
+  if (!Condition(loc, tmp))
+    return EMIT_NONE;
+
+  body = Prog->GetExpr(loc + 3).End + 1;
+  Dynamic(body);
+  LoopTop[wend_loc] = body;
+
+  if (!LineSet)
+    SetLine(loc);
+
+  s = Compare(loc, tmp);
+  Put("  Loc = Rt.While(%s, %d);\n", s, body);
+  delete [] s;
+
+  CanFail = true;
+  CheckAbort();
+  Jump("!Loc", wend_loc + 1);  // skip the loop
+  return body;
+}
+//===========================================
+// UNTIL var op expr
+
+int Emitter::EmitUntil(int loc)
+{
+  int end_loc, tmp;
+  char* s;
+
+  if (!Condition(loc, tmp))
+    return EMIT_NONE;
+
+  end_loc = Prog->GetExpr(loc + 3).End;
+
+  if (Tokens[end_loc].Token != tcEOL && Tokens[end_loc].Token != tcEOF)
+  {
+    Fail(loc, "UNTIL with more than a condition");
+    return EMIT_NONE;
+  }
+
+  if (!LineSet)
+    SetLine(loc);
+
+  s = Compare(loc, tmp);
+  Put("  Loc = Rt.Until(%s);\n", s);
+  delete [] s;
+
+  UsesLoc = CanFail = true;
+  CheckAbort();
+
+  if (LoopTop[loc] >= 0)  // back to the body of the loop
+  {
+    s = Format("Loc == %d", LoopTop[loc]);
+    Jump(s, LoopTop[loc]);
+    delete [] s;
+  }
+
+  Put("  if (Loc >= 0) goto dispatch;\n");
+  return Tokens[end_loc].Token == tcEOF ? end_loc : end_loc + 1;
+}
+//===========================================
+// NEXT or WEND. func = Runtime func that steps the loop.
+
+int Emitter::EmitLoopEnd(int loc, const char* func)
+{
+  char* s;
+
+  SetLine(loc);
+  Put("  Loc = Rt.%s;\n", func);
+  UsesLoc = CanFail = true;
+  CheckAbort();
+
+  if (LoopTop[loc] >= 0)  // back to the body of the loop
+  {
+    s = Format("Loc == %d", LoopTop[loc]);
+    Jump(s, LoopTop[loc]);
+    delete [] s;
+  }
+
+  Put("  if (Loc >= 0) goto dispatch;\n");
+  return loc + 1;
+}
+//===========================================
+// BREAK
+// Leave the innermost loop: remove it from its stack and skip its end.
+
+int Emitter::EmitBreak(int loc)
+{
+  int end_loc = Tokens[loc].Jump;
+
+  if (end_loc < 0)
+  {
+    Fail(loc, "BREAK without a loop");
+    return EMIT_NONE;
+  }
+
+  switch (Tokens[end_loc].Token)
+  {
+    case tcNEXT:
+      Put("  Rt.Break(tcNEXT);\n");
+      return end_loc + 1;
+
+    case tcWEND:
+      Put("  Rt.Break(tcWEND);\n");
+      return end_loc + 1;
+
+    case tcUNTIL:  // skip the UNTIL condition too
+      Put("  Rt.Break(tcUNTIL);\n");
+
+      while (Tokens[end_loc].Token != tcEOL && Tokens[end_loc].Token != tcEOF)
+        end_loc++;
+
+      return end_loc;
+
+    default:
+      return end_loc;
+  }
+}
+//===========================================
+// INPUT [ prompt, ] var
+
+int Emitter::EmitInput(int loc)
+{
+  const char* prompt = NULL;
+
+  loc++;
+
+  if (Tokens[loc].Token == tcSTR)  // user-defined prompt
+  {
+    prompt = Prog->GetTokStr(loc);
+
+    if (Tokens[loc+1].Token != tcCOMMA)
+    {
+      Fail(loc, "INPUT without ,");
+      return EMIT_NONE;
+    }
+
+    loc += 2;
+  }
+
+  if (Tokens[loc].Token != tcVAR)
+  {
+    Fail(loc, "INPUT without var");
+    return EMIT_NONE;
+  }
+
+  Put("  V_%s = Rt.Input(", VarName(loc));
+
+  if (prompt != NULL)
+    PutStrLit(prompt);
+  else
+    Put("NULL");
+
+  Put(");\n");
+  return loc + 1;
+}
+//===========================================
+// PRINT item ...
+// item = str, expr, , (space) or ; (tab)
+
+int Emitter::EmitPrint(int loc)
+{
+  char* s;
+
+  for (loc++; ; )
+  {
+    switch (Tokens[loc].Token)
+    {
+      case tcEOL:
+        Put("  Rt.PrintCh('\\n');\n");
+        CheckAbort();
+        return loc + 1;
+
+      case tcEOF:  // END is missing
+        Put("  Rt.PrintCh('\\n');\n");
+        CheckAbort();
+        return loc;
+
+      case tcCOMMA:
+        Put("  Rt.PrintCh(' ');\n");
+        loc++;
+        break;
+
+      case tcSEMI:
+        Put("  Rt.PrintCh('\\t');\n");
+        loc++;
+        break;
+
+      case tcSTR:
+        Put("  Rt.PrintStr(");
+        PutStrLit(Prog->GetTokStr(loc));
+        Put(");\n");
+        loc++;
+        break;
+
+      default:  // expr
+        s = Expr(loc, false);
+
+        if (s == NULL)
+          return EMIT_NONE;
+
+        Put("  Rt.PrintNum(%s);\n", Bare(s));
+        delete [] s;
+        loc = Prog->GetExpr(loc).End;
+        break;
+    }
+  }
+}
+//===========================================
+// MAT C = A + B | A * expr | SQR | EXP | LOG (A)
+
+int Emitter::EmitMat(int loc)
+{
+  const TokItem* t = Tokens + loc;
+  TokCode func;
+  char* s;
+
+  if (t[1].Token != tcVAR || t[2].Token != tcEQ)
+  {
+    Fail(loc, "MAT without an array and =");
+    return EMIT_NONE;
+  }
+
+  func = t[3].Token;
+
+  if (func == tcVAR && t[4].Token == tcPLUS && t[5].Token == tcVAR)
+  {
+    SetLine(loc);
+    Put("  Rt.MatAdd(A_%s, A_%s, A_%s);\n", VarName(loc + 1),
+      VarName(loc + 3), VarName(loc + 5));
+    CheckAbort();
+    return loc + 6;
+  }
+
+  if (func == tcVAR && t[4].Token == tcSTAR)
+  {
+    s = Expr(loc + 5, false);
+
+    if (s == NULL)
+      return EMIT_NONE;
+
+    if (!LineSet)
+      SetLine(loc);
+
+    Put("  Rt.MatScale(A_%s, A_%s, %s);\n", VarName(loc + 1),
+      VarName(loc + 3), Bare(s));
+    delete [] s;
+    CheckAbort();
+    return Prog->GetExpr(loc + 5).End;
+  }
+
+  if ((func == tcSQR || func == tcEXP || func == tcLOG) &&
+    t[4].Token == tcLPAR && t[5].Token == tcVAR && t[6].Token == tcRPAR)
+  {
+    SetLine(loc);
+    Put("  Rt.MatApply(A_%s, A_%s, %s);\n", VarName(loc + 1),
+      VarName(loc + 5), func == tcSQR ? "tcSQR" : func == tcEXP ?
+      "tcEXP" : "tcLOG");
+    CheckAbort();
+    return loc + 7;
+  }
+
+  Fail(loc, "a malformed MAT");
+  return EMIT_NONE;
+}
+//===========================================
+// RANDOMIZE expr, PRECISION expr
+// func = Runtime func that runs the command.
+
+int Emitter::EmitCall(int loc, const char* func)
+{
+  char* s = Expr(loc + 1, false);
+
+  if (s == NULL)
+    return EMIT_NONE;
+
+  if (!LineSet)
+    SetLine(loc);
+
+  Put("  Rt.%s(%s);\n", func, Bare(s));
+  delete [] s;
+
+  CanFail = true;
+  CheckAbort();
+  return Prog->GetExpr(loc + 1).End;
+}
+//===========================================
+// Check the var op expr condition of WHILE or UNTIL at loc, and emit
+// the value of expr into temp tmp.
+
+bool Emitter::Condition(int loc, int& tmp)
+{
+  char* s;
+
+  if (Tokens[loc+1].Token != tcVAR || !IsRelOp(Tokens[loc+2].Token))
+  {
+    Fail(loc, "a condition without var and rel op");
+    return false;
+  }
+
+  s = Expr(loc + 3, false);
+
+  if (s == NULL)
+    return false;
+
+  tmp = NewTemp();
+  Put("  t%d = %s;\n", tmp, Bare(s));
+  delete [] s;
+  return true;
+}
+//===========================================
+// Args of Runtime::While() and Until() for the condition at loc:
+// result, var slot, op and value of expr.
+
+char* Emitter::Compare(int loc, int tmp)
+{
+  TokCode op = Tokens[loc+2].Token;
+
+  return Format("V_%s %s t%d, %d, %s, t%d", VarName(loc + 1),
+    RelOpStr(op), tmp, VarIndex(loc + 1), RelOpName(op), tmp);
+}
+//===========================================
+// *** EXPRS ***
+//===========================================
+// Translate the expr beginning at token loc.
+// cond = true => return a C++ bool, else a double.
+// The ops that can raise errors are called into temps first, in the
+// order the VM runs them, so the errors come in the same order; the
+// rest is a single C++ expr.
+// Return the new str, NULL if the expr cannot be translated.
+
+char* Emitter::Expr(int loc, bool cond)
+{
+  const ExprTblItem& e = Prog->GetExpr(loc);
+  const Instr* ip;
+  EmitOpnd stk[MAX_STACK], x, y;
+  char *s, *a, *b;
+  int n = 0;
+
+  if (e.Code < 0)
+  {
+    Fail(loc, "an invalid expr");
+    return NULL;
+  }
+
+  for (ip = Prog->GetCode() + e.Opt; ip->Op != opEND; ip++)
+  {
+    if (n + 1 > MAX_STACK)  // cannot happen, the compiler checks it
+    {
+      Fail(loc, "a too complex expr");
+      break;
+    }
+
+    s = NULL;
+
+    switch (ip->Op)
+    {
+      case opNUM:
+        s = NumStr(Prog->GetNumPool()[ip->Arg].Value);
+        break;
+
+      case opVAR:
+        s = Format("V_%s", Prog->GetVarName(ip->Arg));
+        break;
+
+      case opDUP:
+        s = Format("%s", stk[n-1].Str);
+        stk[n].IsBool = stk[n-1].IsBool;
+        stk[n++].Str = s;
+        continue;
+
+      case opPLUS:
+      case opLPAR:
+      case opRPAR:
+        continue;
+
+      case opNOT:
+        x = stk[--n];
+        a = Cond(x);
+        s = Format("!%s", a);
+        delete [] a;
+        delete [] x.Str;
+        stk[n].Str = s;
+        stk[n++].IsBool = true;
+        continue;
+
+      case opNEG:
+      case opABS:
+      case opSGN:
+      case opCINT:
+      case opFIX:
+      case opEXP:
+        x = stk[--n];
+        a = Val(x);
+        s = Format(ip->Op == opNEG ? "(-%s)" : ip->Op == opABS ?
+          "Runtime::Abs(%s)" : ip->Op == opSGN ? "Runtime::Sgn(%s)" :
+          ip->Op == opCINT ? "Runtime::CInt(%s)" : ip->Op == opFIX ?
+          "Runtime::Fix(%s)" : "exp(%s)", a);
+        delete [] a;
+        delete [] x.Str;
+        break;
+
+      case opARR1:
+      case opARR2:
+        a = Format("A_%s", Prog->GetVarName(ip->Arg));
+        n -= ip->Op == opARR1 ? 1 : 2;
+        s = Temp("Arr", stk + n, ip->Op == opARR1 ? 1 : 2, a);
+        delete [] a;
+        break;
+
+      case opSQR:
+      case opLOG:
+        s = Temp(ip->Op == opSQR ? "Sqr" : "Log", stk + n - 1, 1);
+        n--;
+        break;
+
+      case opREF:
+        s = Format("A_%s", Prog->GetVarName(ip->Arg));
+        break;
+
+      case opSUM:
+      case opMIN:
+      case opMAX:
+        s = Temp(ip->Op == opSUM ? "Sum" : ip->Op == opMIN ? "Min" : "Max",
+          stk + n - 1, 1);
+        n--;
+        break;
+
+      case opDOT:
+        s = Temp("Dot", stk + n - 2, 2);
+        n -= 2;
+        break;
+
+      case opDIV:
+      case opMOD:
+      case opPOW:
+      case opRND:
+        s = Temp(ip->Op == opDIV ? "Div" : ip->Op == opMOD ? "Mod" :
+          ip->Op == opPOW ? "Pow" : "Rnd", stk + n - 2, 2);
+        n -= 2;
+        break;
+
+      case opOR:
+      case opAND:
+        y = stk[--n];
+        x = stk[--n];
+        a = Cond(x);
+        b = Cond(y);
+        s = Format("(%s %s %s)", a, ip->Op == opOR ? "||" : "&&", b);
+        delete [] a;
+        delete [] b;
+        delete [] x.Str;
+        delete [] y.Str;
+        stk[n].Str = s;
+        stk[n++].IsBool = true;
+        continue;
+
+      case opLT:
+      case opLE:
+      case opGT:
+      case opGE:
+      case opEQ:
+      case opNE:
+      case opADD:
+      case opSUB:
+      case opMUL:
+        y = stk[--n];
+        x = stk[--n];
+        a = Val(x);
+        b = Val(y);
+        s = Format("(%s %s %s)", a, OpStr(ip->Op), b);
+        delete [] a;
+        delete [] b;
+        delete [] x.Str;
+        delete [] y.Str;
+        stk[n].Str = s;
+        stk[n++].IsBool = ip->Op <= opNE;
+        continue;
+
+      default:
+        Fail(loc, "an unknown op");
+        break;
+    }
+
+    if (s == NULL)
+      break;
+
+    stk[n].Str = s;
+    stk[n++].IsBool = false;
+  }
+
+  if (Failed || n != 1)
+  {
+    while (n > 0)
+      delete [] stk[--n].Str;
+
+    if (!Failed)
+      Fail(loc, "an invalid expr");
+
+    return NULL;
+  }
+
+  s = cond ? Cond(stk[0]) : Val(stk[0]);
+  delete [] stk[0].Str;
+  return s;
+}
+//===========================================
+// Emit a call of Runtime func on the num_args operands args into a new
+// temp, and free the operands. arr != NULL => the 1st arg of func is
+// the array arr. Return the name of the temp.
+
+char* Emitter::Temp(const char* func, EmitOpnd* args, int num_args,
+  const char* arr)
+{
+  char *a, *b = NULL;
+  int tmp;
+
+  if (!LineSet)  // errors report the line of the command
+    SetLine(-1);
+
+  tmp = NewTemp();
+  a = Val(args[0]);
+  Put("  t%d = Rt.%s(", tmp, func);
+
+  if (arr != NULL)
+    Put("%s, ", arr);
+
+  if (num_args == 2)
+  {
+    b = Val(args[1]);
+    Put("%s, %s);\n", Bare(a), Bare(b));
+    delete [] args[1].Str;
+  }
+  else
+    Put("%s);\n", Bare(a));
+
+  delete [] args[0].Str;
+  delete [] a;
+  delete [] b;
+  CanFail = true;
+  return Format("t%d", tmp);
+}
+//===========================================
+// Return a new temp of the current command.
+
+int Emitter::NewTemp()
+{
+  if (++NumTemps > MaxTemps)
+    MaxTemps = NumTemps;
+
+  return NumTemps - 1;
+}
+//===========================================
+// Return operand x as a new double expr.
+
+char* Emitter::Val(const EmitOpnd& x)
+{
+  if (!x.IsBool)
+    return Format("%s", x.Str);
+
+  // a bool in parentheses needs no more of them
+  return Format(x.Str[0] == '(' ? "double%s" : "double(%s)", x.Str);
+}
+//===========================================
+// Return operand x as a new bool expr.
+
+char* Emitter::Cond(const EmitOpnd& x)
+{
+  if (x.IsBool)
+    return Format("%s", x.Str);
+
+  return Format("(%s != 0.0)", x.Str);
+}
+//===========================================
+// Return num as a new C++ literal that converts back to the same double.
+
+char* Emitter::NumStr(double num)
+{
+  char str[32];
+
+  if (isnan(num))
+    return Format("NAN");
+
+  if (isinf(num))
+    return Format(num > 0.0 ? "HUGE_VAL" : "(-HUGE_VAL)");
+
+  snprintf(str, sizeof(str), "%.15g", num);
+
+  if (strtod(str, NULL) != num)
+    snprintf(str, sizeof(str), "%.17g", num);
+
+  if (strpbrk(str, ".e") == NULL)  // a double, not an int
+    strcat(str, ".0");
+
+  return Format(str[0] == '-' ? "(%s)" : "%s", str);
+}
+//===========================================
+// Drop the outer parentheses of expr s, if any. s is changed.
+
+const char* Emitter::Bare(char* s)
+{
+  int len = strlen(s), depth = 0, i;
+
+  if (s[0] != '(' || s[len-1] != ')')
+    return s;
+
+  for (i = 0; i < len - 1; i++)  // do they match each other?
+  {
+    if (s[i] == '(')
+      depth++;
+    else if (s[i] == ')' && --depth == 0)
+      return s;
+  }
+
+  s[len-1] = '\0';
+  return s + 1;
+}
+//===========================================
+const char* Emitter::OpStr(OpCode op)
+{
+  switch (op)
+  {
+    case opLT: return "<";
+    case opLE: return "<=";
+    case opGT: return ">";
+    case opGE: return ">=";
+    case opEQ: return "==";
+    case opNE: return "!=";
+    case opADD: return "+";
+    case opSUB: return "-";
+    default: return "*";
+  }
+}
+//===========================================
+const char* Emitter::RelOpStr(TokCode op)
+{
+  switch (op)
+  {
+    case tcLT: return "<";
+    case tcLE: return "<=";
+    case tcGT: return ">";
+    case tcGE: return ">=";
+    case tcEQ: return "==";
+    default: return "!=";
+  }
+}
+//===========================================
+const char* Emitter::RelOpName(TokCode op)
+{
+  switch (op)
+  {
+    case tcLT: return "tcLT";
+    case tcLE: return "tcLE";
+    case tcGT: return "tcGT";
+    case tcGE: return "tcGE";
+    case tcEQ: return "tcEQ";
+    default: return "tcNE";
+  }
+}
+//===========================================
+bool Emitter::IsRelOp(TokCode tok)
+{
+  return tok == tcLT || tok == tcLE || tok == tcGT || tok == tcGE ||
+    tok == tcEQ || tok == tcNE;
+}
+//===========================================
+// Slot of the var at loc.
+
+int Emitter::VarIndex(int loc)
+{
+  return Tokens[loc].Index;
+}
+//===========================================
+// Name of the var at loc.
+
+const char* Emitter::VarName(int loc)
+{
+  return Prog->GetVarName(Tokens[loc].Index);
+}
+//===========================================
+// *** OUTPUT ***
+//===========================================
+// Emit str s as a C++ str literal.
+
+void Emitter::PutStrLit(const char* s)
+{
+  Put("\"");
+
+  for (; *s; s++)
+    if (*s == '"' || *s == '\\')
+      Put("\\%c", *s);
+    else if (isprint((unsigned char)*s))
+      Put("%c", *s);
+    else
+      Put("\\%03o", (unsigned char)*s);
+
+  Put("\"");
+}
+//===========================================
+// Set the line of the errors to the line of the command at loc,
+// -1 = the command being emitted. The command can raise errors.
+
+void Emitter::SetLine(int loc)
+{
+  Put("  Rt.SetLine(%d);\n", Tokens[loc < 0 ? CurLoc : loc].Line);
+  LineSet = CanFail = true;
+}
+//===========================================
+// Stop the run if the command has aborted it.
+
+void Emitter::CheckAbort()
+{
+  if (CanFail)
+    Put("  if (Rt.IsAborted()) return Rt.Finish(false);\n");
+}
+//===========================================
+// Go to loc if cond is true, or always if cond = NULL.
+
+void Emitter::Jump(const char* cond, int loc)
+{
+  Labeled[loc] = true;
+  Reach(loc);
+
+  if (cond != NULL)
+    Put("  if (%s) goto L%d;\n", cond, loc);
+  else
+    Put("  goto L%d;\n", loc);
+}
+//===========================================
+void Emitter::Fail(int loc, const char* msg)
+{
+  Rpt->Printf("Line %d: cannot translate %s.\n", Tokens[loc].Line, msg);
+  Failed = true;
+}
+//===========================================
+// Write a printf-style formatted str to the C++ file.
+// Nothing is written in the 1st pass.
+
+void Emitter::Put(const char* format, ...)
+{
+  va_list args;
+
+  if (Fp == NULL)
+    return;
+
+  va_start(args, format);
+  vfprintf(Fp, format, args);
+  va_end(args);
+}
+//===========================================
+// Return a new printf-style formatted str.
+
+char* Emitter::Format(const char* format, ...)
+{
+  va_list args;
+  char* s;
+  int len;
+
+  va_start(args, format);
+  len = vsnprintf(NULL, 0, format, args);
+  va_end(args);
+
+  s = new char [len+1];
+
+  if (s == NULL)
+    Ctx->ErrRpt.FatalError(ecMEM_ALLOC);
+
+  va_start(args, format);
+  vsnprintf(s, len + 1, format, args);
+  va_end(args);
+  return s;
+}
+//===========================================
@@ -0,0 +1,127 @@
+//===========================================
+//
+//  Emitter.h
+//
+// Author: Theo P. (theo_pap@otenet.gr)
+// Language used: C++
+// Copyright: No copyright. You can do with this software whatever
+// you like.
+// Warranty: No warranty. Use this software at your own risk.
+//===========================================
+
+#ifndef EMITTER_H
+#define EMITTER_H
+
+#include <stdio.h>
+#include "SupportClasses.h"
+#include "Program.h"
+#include "Output.h"
+
+//===========================================
+const int EMIT_NONE = -1;  // EmitCmd(): the command has no successor
+//===========================================
+struct EmitOpnd  // operand of an expr being translated
+{
+  char* Str;  // C++ expr; a var, a literal, a call or in parentheses
+  bool IsBool;  // true = Str is a C++ bool, not a double
+};
+//===========================================
+// Translator of a BASIC program into a self-contained C++ program.
+// The vars are locals of main(), every command becomes a few C++
+// statements and every loc that is a jump target becomes a C++ label,
+// so GOTO is a goto. The exprs are translated from their optimized
+// bytecode. The output, the errors, RND, the arrays and the loop and
+// GOSUB stacks are left to a Runtime (see Runtime.h), so the compiled
+// program prints exactly what the interpreter prints, errors included.
+// An array is named by a const with the slot of its name.
+// A loc that is entered from a stack (the body of a loop, the return
+// loc of a GOSUB) is reached through a switch on the loc; a NEXT, WEND
+// or UNTIL jumps straight to the body of its own loop.
+// Programs with load errors, DEB_MODE ON or malformed commands are not
+// translated.
+
+class Emitter
+{
+public:
+  Emitter(Program& prog, Output& rpt);
+  ~Emitter();
+
+  bool Emit(const char* fname);
+
+private:
+  // passes
+  void PutVars();
+  void Reach(int loc);
+  int NextReached(int loc);
+  void Dynamic(int loc);
+  int EmitCmd(int loc);
+
+  // commands
+  int EmitAssign(int loc);
+  int EmitSetArr(int loc);
+  int EmitDim(int loc);
+  int EmitMat(int loc);
+  int EmitIf(int loc);
+  int EmitGoto(int loc, bool gosub);
+  int EmitFor(int loc);
+  int EmitWhile(int loc);
+  int EmitUntil(int loc);
+  int EmitLoopEnd(int loc, const char* func);
+  int EmitBreak(int loc);
+  int EmitInput(int loc);
+  int EmitPrint(int loc);
+  int EmitCall(int loc, const char* func);
+  bool Condition(int loc, int& tmp);
+  char* Compare(int loc, int tmp);
+
+  // exprs
+  char* Expr(int loc, bool cond);
+  char* Temp(const char* func, EmitOpnd* args, int num_args,
+    const char* arr = NULL);
+  int NewTemp();
+  char* Val(const EmitOpnd& x);
+  char* Cond(const EmitOpnd& x);
+  char* NumStr(double num);
+  const char* Bare(char* s);
+  const char* OpStr(OpCode op);
+  const char* RelOpStr(TokCode op);
+  const char* RelOpName(TokCode op);
+  bool IsRelOp(TokCode tok);
+  int VarIndex(int loc);
+  const char* VarName(int loc);
+
+  // output
+  void PutStrLit(const char* s);
+  void SetLine(int loc);
+  void CheckAbort();
+  void Jump(const char* cond, int loc);
+  void Fail(int loc, const char* msg);
+  void Put(const char* format, ...);
+  char* Format(const char* format, ...);
+
+  Program* Prog;  // program translated
+  Context* Ctx;  // context of Prog
+  const TokItem* Tokens;  // token array of Prog
+  int NumToks;
+  int NumVars;  // num of var slots of Prog
+  Output* Rpt;  // where the errors of the translation go
+  FILE* Fp;  // C++ file, NULL = 1st pass, nothing is written
+
+  bool* Reached;  // per loc: the command at loc can be run
+  bool* Labeled;  // per loc: the C++ code has a label for loc
+  bool* IsDyn;  // per loc: loc is entered from a stack
+  int* LoopTop;  // per loc of NEXT, WEND, UNTIL: loc of body, -1 = none
+  int* Work;  // locs reached but not scanned yet
+  int NumWork;
+
+  int CurLoc;  // loc of the command being emitted
+  int NumTemps;  // num of temps of the current command
+  int MaxTemps;  // max num of temps of any command
+  bool LineSet;  // true = the current command has set the line
+  bool CanFail;  // true = the current command can raise an error
+  bool UsesLoc;  // true = the code needs Loc and the dispatch switch
+  bool Failed;  // true = the program cannot be translated
+};
+//===========================================
+
+#endif
@@ -11,6 +11,7 @@
 
 #include <stdio.h>
 #include "Misc.h"
+#include "Output.h"
 #include "Error.h"
 
 //===========================================
@@ -29,6 +30,7 @@ ErrTblItem ErrTbl[] =  // error table
   ecFOPEN, "cannot open file",
 
   ecEXPR_MISSING, "no expression present",
+  ecEXPR_COMPLEX, "expression too complex",
   ecEQ_MISSING, "equal sign = expected",
   ecCOMMA_MISSING, "comma , expected",
   ecVAR_MISSING, "variable expected",
@@ -50,6 +52,7 @@ ErrTblItem ErrTbl[] =  // error table
   ecUNEXP_TOKEN, "unexpected token",
   ecILL_VAR_NAME, "illegal var name",
   ecILL_VAR_NAME_FOR, "illegal var name in FOR loop",
+  ecNUM_TOO_LONG, "number too long:",
   ecRAND_ARG_NEG, "RANDOMIZE argument cannot be negative",
   ecRAND_ARG_INT, "RANDOMIZE argument must be integer",
   ecRND_ARG_NEG, "RND() argument canot be negative",
@@ -64,6 +67,12 @@ ErrTblItem ErrTbl[] =  // error table
   ecPREC_ARG_NEG,  "PRECISION argument cannot be negative",
   ecPREC_ARG_INT,  "PRECISION argument must be integer",
   ecON_OFF_MISSING,  "ON or OFF expected",
+  ecARR_MISSING, "array expected",
+  ecARR_NOT_DIM, "array not dimensioned",
+  ecARR_NUM_INDEX, "wrong number of array indexes",
+  ecARR_INDEX, "array index out of range",
+  ecDIM_SIZE, "illegal array size",
+  ecARR_DIMS, "arrays of different dimensions",
 
   ecTOO_MANY_FOR_NEST, "too many nested FORs",
   ecNEXT_WITHOUT_FOR, "NEXT without FOR",
@@ -84,9 +93,6 @@ ErrTblItem ErrTbl[] =  // error table
   ecLBL_UNDEF, "undefined label",
   ecLBL_INVALID, "invalid label",
 
-  ecSTK_FULL, "cannot push: stack is full",
-  ecSTK_EMPTY, "cannot pop: stack is empty",
-
   ecGOSUB_FULL, "cannot push: GOSUB stack is full",
   ecGOSUB_EMPTY, "cannot pop: GOSUB stack is empty",
 
@@ -104,45 +110,69 @@ ErrTblItem ErrTbl[] =  // error table
   ecEOT,  ""  /* end of table = terminal mark. Do not remove. */
 };
 //===========================================
-// Display an error message.
+ErrReporter::ErrReporter(Output* out, const int* line)
+{
+  Out = out;
+  Line = line;
+  Counter = 0;
+  Aborted = false;
+}
+//===========================================
+// Forget the errors of a previous run.
 
-void ErrReporter::Error(ErrCode ec, const char* s)
+void ErrReporter::Reset()
 {
-  for (int i = 0; ErrTbl[i].Code != ecEOT; i++)
-    if (ErrTbl[i].Code == ec)
-    {
-      printf("\nERROR: Line = %d, Msg = %s", Line, ErrTbl[i].Msg);
-    
-      if (s)  // s is optional
-        printf(" %s", s);
-
-      printf(".\n\n");
-      Counter++;
-
-      if (Counter = MAX_ERRORS)
-      {
-        printf("\nToo many errors. Program aborted.\n\n");
-        exit(1);
-      }
-    }
+  Counter = 0;
+  Aborted = false;
 }
 //===========================================
-// Fatal error happened. Display error message and abort the program.
+// Return the message of error ec.
 
-void ErrReporter::FatalError(ErrCode ec, const char* s)
+const char* ErrReporter::FindMsg(ErrCode ec)
 {
   for (int i = 0; ErrTbl[i].Code != ecEOT; i++)
     if (ErrTbl[i].Code == ec)
-    {
-      printf("\nERROR: %s", ErrTbl[i].Msg);
-    
-      if (s)
-        printf(" %s", s);
-
-      printf(".\n\n");
-      exit(1);
-    }
+      return ErrTbl[i].Msg;
+
+  return "unknown error";
 }
 //===========================================
-ErrReporter ErrRpt;  // the globar error reporter object
+// Display an error message.
+// Abort the run after MAX_ERRORS errors.
+
+void ErrReporter::Error(ErrCode ec, const char* s)
+{
+  if (Aborted)  // the run is over, so nothing more to report
+    return;
+
+  Out->Printf("\nERROR: Line = %d, Msg = %s", *Line, FindMsg(ec));
+
+  if (s)  // s is optional
+    Out->Printf(" %s", s);
+
+  Out->PutStr(".\n\n");
+  Counter++;
+
+  if (Counter == MAX_ERRORS)
+  {
+    Out->PutStr("\nToo many errors. Program aborted.\n\n");
+    Aborted = true;
+  }
+}
+//===========================================
+// Fatal error happened. Display error message and abort the run.
+
+void ErrReporter::FatalError(ErrCode ec, const char* s)
+{
+  if (Aborted)
+    return;
+
+  Out->Printf("\nERROR: %s", FindMsg(ec));
+
+  if (s)
+    Out->Printf(" %s", s);
+
+  Out->PutStr(".\n\n");
+  Aborted = true;
+}
 //===========================================
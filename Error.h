@@ -15,7 +15,7 @@
 #include <stdlib.h>
 
 //===========================================
-// max num of errors before prog is terminated
+// max num of errors before prog is aborted
 const int MAX_ERRORS = 10;
 //===========================================
 enum ErrCode  // error code
@@ -27,6 +27,7 @@ enum ErrCode  // error code
   ecFOPEN,
 
   ecEXPR_MISSING,
+  ecEXPR_COMPLEX,
   ecEQ_MISSING,
   ecCOMMA_MISSING,
   ecVAR_MISSING,
@@ -48,6 +49,7 @@ enum ErrCode  // error code
   ecUNEXP_TOKEN,
   ecILL_VAR_NAME,
   ecILL_VAR_NAME_FOR,
+  ecNUM_TOO_LONG,
   ecRAND_ARG_NEG,
   ecRAND_ARG_INT,
   ecRND_ARG_NEG,
@@ -62,6 +64,12 @@ enum ErrCode  // error code
   ecPREC_ARG_NEG,
   ecPREC_ARG_INT,
   ecON_OFF_MISSING,
+  ecARR_MISSING,
+  ecARR_NOT_DIM,
+  ecARR_NUM_INDEX,
+  ecARR_INDEX,
+  ecDIM_SIZE,
+  ecARR_DIMS,
 
   ecTOO_MANY_FOR_NEST,
   ecNEXT_WITHOUT_FOR,
@@ -82,9 +90,6 @@ enum ErrCode  // error code
   ecLBL_UNDEF,
   ecLBL_INVALID,
 
-  ecSTK_FULL,
-  ecSTK_EMPTY,
-
   ecGOSUB_FULL,
   ecGOSUB_EMPTY,
 
@@ -102,20 +107,34 @@ enum ErrCode  // error code
   ecEOT  // end of table = terminal mark. Do not remove.
 };
 //===========================================
+class Output;
+//===========================================
+// Error reporter of an interpreter.
+// An error is displayed on the interpreter output. After MAX_ERRORS
+// errors, or after a fatal error, the run is aborted: the reporter
+// is marked aborted and the executor stops. The process never exits.
+
 class ErrReporter  // error reporter
 {
 public:
-  ErrReporter()  { Counter = 0; }
+  ErrReporter(Output* out, const int* line);
 
   void Error(ErrCode ec, const char* s = NULL);
   void FatalError(ErrCode ec, const char* s = NULL);
 
+  bool IsAborted() const  { return Aborted; }
+  int GetCount() const  { return Counter; }
+  void Reset();
+
 private:
+  const char* FindMsg(ErrCode ec);
+
+  Output* Out;  // where errors are displayed
+  const int* Line;  // current line num in source
   int Counter;  // num of errors happened so far
+  bool Aborted;  // true => run was aborted
 };
 //===========================================
-extern ErrReporter ErrRpt;  // the global error reporter object
-//===========================================
 
 #endif
 
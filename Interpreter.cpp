@@ -11,34 +11,211 @@
 
 #include <stdio.h>
 #include "Parser.h"
+#include "Output.h"
+#include "Batch.h"
+#include "Emitter.h"
+#include "Simd.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 //===========================================
 void main0()
 {
-  Parser p;
+  Program prog;
 
-  p.Init("Test0.bas.");
-  p.DispSource();
-  p.DispLblTbl();
-  p.DispTokens();
-  printf("\n");
+  prog.Load("Test0.bas.");
+  prog.DispSource();
+  prog.DispLblTbl();
+  prog.DispTokens();
+  prog.GetContext().Out.PutCh('\n');
 }
 //===========================================
-void main(int argc, const char* argv[])
+// Display the usage message.
+
+void DispUsage(Output& out)
+{
+  out.PutStr("Usage: argv[0] [--profile] [--cache] [--dump] [--no-jit] ");
+  out.PutStr("[--no-simd] [--stack n] [--emit-cpp] <file_name>\n");
+  out.PutStr("       argv[0] --batch [--threads n] [--inputs <inputs_file>]");
+  out.PutStr(" [--cache] [--no-jit] [--no-simd] [--stack n]");
+  out.PutStr(" <file_name> ...\n");
+  out.PutStr("  --profile  display the time spent per source line ");
+  out.PutStr("and save it to <file_name>.prof\n");
+  out.PutStr("  --cache    run the compiled program saved in ");
+  out.PutStr("<file_name>.cache, or save it there\n");
+  out.PutStr("  --dump     display the compiled and optimized code of ");
+  out.PutStr("every expr, do not run\n");
+  out.PutStr("  --no-jit   run in the interpreter only, ");
+  out.PutStr("hot loops are not compiled to native code\n");
+  out.PutStr("  --no-simd  run SUM, DOT, MIN, MAX and MAT in plain C++, ");
+  out.PutStr("without SIMD instructions\n");
+  out.PutStr("  --stack    allow n nested GOSUBs, FORs, WHILEs and DOs ");
+  out.PutStr("of each kind, default 65536\n");
+  out.PutStr("  --emit-cpp translate the program into the C++ program ");
+  out.PutStr("<file_name>.cpp, do not run\n");
+  out.PutStr("  --batch    run many programs, or one program per line of ");
+  out.PutStr("<inputs_file>, on n threads\n");
+}
+//===========================================
+// Set limit to the --stack value s, if all of s is a num in
+// 1 ... STK_MAX_LIMIT, and return true, else return false.
+
+bool ReadStackLimit(const char* s, int& limit)
+{
+  char* end;
+  long n;
+
+  n = strtol(s, &end, 10);
+  if (end == s || *end != '\0' || n < 1 || n > STK_MAX_LIMIT)
+    return false;
+  limit = int(n);
+  return true;
+}
+//===========================================
+// Batch mode.
+// Run the programs argv[i] ... argv[argc-1], or each program with
+// every input set of an inputs file, on a pool of threads.
+// --threads n  num of worker threads, default one per CPU
+// --inputs f   file with one input set per line
+// --cache      use the compiled caches of the programs
+// --no-jit     run in the interpreter only
+// --no-simd    run the whole-array built-ins in plain C++
+// --stack n    max depth of each GOSUB, FOR, WHILE and DO stack
+
+int RunBatch(int argc, const char* argv[], int i)
 {
-  Parser p;
+  Batch b;
+  Output out(1), rpt(2);  // stdout, stderr
+  int num_threads = 0, stk_limit;
+
+  for (; i < argc && !strncmp(argv[i], "--", 2); i++)
+  {
+    if (!strcmp(argv[i], "--cache"))
+      b.SetCache(true);
+    else if (!strcmp(argv[i], "--no-jit"))
+      b.SetJit(false);
+    else if (!strcmp(argv[i], "--no-simd"))
+      SetSimdLimit(siSCALAR);
+    else if (i + 1 == argc)
+      break;
+    else if (!strcmp(argv[i], "--threads"))
+      num_threads = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--stack"))
+    {
+      if (!ReadStackLimit(argv[++i], stk_limit))
+      {
+        DispUsage(rpt);
+        return 1;
+      }
+      b.SetStackLimit(stk_limit);
+    }
+    else if (!strcmp(argv[i], "--inputs"))
+    {
+      if (!b.LoadInputs(argv[++i]))
+      {
+        rpt.Printf("Cannot read inputs file %s.\n", argv[i]);
+        return 1;
+      }
+    }
+    else
+      break;
+  }
+
+  for (; i < argc; i++)
+    b.AddProgram(argv[i]);
+
+  if (b.GetNumJobs() == 0)
+  {
+    rpt.PutStr("No jobs to run.\n");
+    return 1;
+  }
+
+  b.Run(num_threads);
+  return b.Report(out, rpt) ? 0 : 1;
+}
+//===========================================
+int main(int argc, const char* argv[])
+{
+  Program prog;
+  Parser p(prog);
+  Output& out = p.GetContext().Out;
+  const char* fname;
+  char prof_fname[FILENAME_MAX], cpp_fname[FILENAME_MAX];
+  bool profile = false, cache = false, dump = false, jit = true, ok;
+  bool emit = false;
+  int i, stk_limit = DEF_STK_LIMIT;
+
+  if (argc >= 3 && !strcmp(argv[1], "--batch"))
+    return RunBatch(argc, argv, 2);
+
+  for (i = 1; i < argc - 1; i++)
+    if (!strcmp(argv[i], "--profile"))
+      profile = true;
+    else if (!strcmp(argv[i], "--cache"))
+      cache = true;
+    else if (!strcmp(argv[i], "--dump"))
+      dump = true;
+    else if (!strcmp(argv[i], "--no-jit"))
+      jit = false;
+    else if (!strcmp(argv[i], "--no-simd"))
+      SetSimdLimit(siSCALAR);
+    else if (!strcmp(argv[i], "--emit-cpp"))
+      emit = true;
+    else if (!strcmp(argv[i], "--stack") && i + 2 < argc)
+    {
+      if (!ReadStackLimit(argv[++i], stk_limit))
+        break;  // display the usage message
+    }
+    else
+      break;
+
+  if (i != argc - 1)
+  {
+    DispUsage(out);
+    return 1;
+  }
+
+  fname = argv[i];
+
+  if (!prog.Load(fname, cache))
+    return 1;
+
+  prog.DispSource();
+
+  if (dump)
+  {
+    prog.DispCode();
+    return prog.GetNumErrors() == 0 ? 0 : 1;
+  }
+
+  if (emit)
+  {
+    Output rpt(2);  // stderr
+    Emitter em(prog, rpt);
+
+    snprintf(cpp_fname, FILENAME_MAX, "%s.cpp", fname);
+    ok = em.Emit(cpp_fname);
+
+    if (ok)
+      out.Printf("C++ program saved in %s.\n", cpp_fname);
+
+    return ok ? 0 : 1;
+  }
+
+  p.SetProfile(profile);
+  p.SetJit(jit);
+  p.SetStackLimit(stk_limit);
+  ok = p.Execute() && prog.GetNumErrors() == 0;
+  out.PutCh('\n');
 
-  if (argc != 2)
+  if (profile)
   {
-    printf("Usage: argv[0] <file_name>\n");
-    return;
+    out.Flush();  // program output before the report
+    snprintf(prof_fname, FILENAME_MAX, "%s.prof", fname);
+    p.DispProfile(prof_fname);
   }
 
-  p.Init(argv[1]);
-  p.DispSource();
-  p.Execute();
-  printf("\n");
+  return ok ? 0 : 1;
 }
 //===========================================
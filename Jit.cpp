@@ -0,0 +1,1905 @@
+//===========================================
+//
+//  Jit.cpp
+//
+// Author: Theo P. (theo_pap@otenet.gr)
+// Language used: C++
+// Copyright: No copyright. You can do with this software whatever
+// you like.
+// Warranty: No warranty. Use this software at your own risk.
+//===========================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+#include "Misc.h"
+#include "Parser.h"
+#include "Jit.h"
+
+#ifdef JIT_SUPPORTED
+#include <sys/mman.h>
+#endif
+
+//===========================================
+typedef int (*JitFunc)();  // native code of a loop
+//===========================================
+Jit::Jit(Parser* prs, const Program* prog, VarTable* vars, ArrTable* arrs)
+{
+  Prs = prs;
+  Prog = prog;
+  Vars = vars;
+  Arrs = arrs;
+  Loops = NULL;
+  memset(&Frame, 0, sizeof(JitFrame));
+
+  Code = NULL;
+  CodeLen = Pos = 0;
+  Failed = false;
+  Labels = NULL;
+  NumLabels = 0;
+  Fixups = NULL;
+  NumFixups = 0;
+  NumBlocks = NumFor = NumWhile = MaxFor = MaxWhile = 0;
+  Slow = Abort = -1;
+  ExprCode = NULL;
+  NumChecks = 0;
+  Hoisted = false;
+}
+//===========================================
+Jit::~Jit()
+{
+#ifdef JIT_SUPPORTED
+  if (Code != NULL)
+    munmap(Code, JIT_CODE_SIZE);
+#endif
+
+  Code = NULL;
+  delete [] Loops;
+  Loops = NULL;
+  delete [] Labels;
+  Labels = NULL;
+  delete [] Fixups;
+  Fixups = NULL;
+}
+//===========================================
+// Run the loop whose body begins at token loc, natively, from the top
+// of the body. end = loc of its NEXT or WEND, item = its stack item.
+// back_edge = true => the executor has just done a pass of the loop;
+// the passes are counted, and a loop becomes hot after JIT_HOT_COUNT.
+// for_room, while_room = num of items the FOR and WHILE stacks can
+// still take. A loop whose nested loops would overflow them is left to
+// the executor, so it reports the error.
+// Return the loc after the loop, where the executor goes on, -1 if the
+// run was aborted, or JIT_NOT_RUN if the loop was not run.
+
+int Jit::Run(int loc, int end, bool back_edge, void* item, int for_room,
+  int while_room)
+{
+#ifdef JIT_SUPPORTED
+  JitLoop* l;
+  int i, n;
+
+  if (Loops == NULL)
+  {
+    n = Prog->GetNumToks();
+    Loops = new JitLoop [n];
+
+    for (i = 0; i < n; i++)
+    {
+      Loops[i].Count = 0;
+      Loops[i].Code = JIT_NONE;
+      Loops[i].NumFor = Loops[i].NumWhile = 0;
+    }
+  }
+
+  l = &Loops[loc];
+
+  if (l->Code == JIT_NONE)
+  {
+    if (!back_edge || ++l->Count < JIT_HOT_COUNT)
+      return JIT_NOT_RUN;
+
+    if (!Compile(loc, end, *l, item))
+      l->Code = JIT_FAILED;  // never tried again
+  }
+
+  if (l->Code < 0 || l->NumFor > for_room || l->NumWhile > while_room)
+    return JIT_NOT_RUN;
+
+  Frame.Item = item;
+  return ((JitFunc) (Code + l->Code))();
+#else
+  return JIT_NOT_RUN;
+#endif
+}
+//===========================================
+#ifdef JIT_SUPPORTED
+//===========================================
+// *** CALLBACKS ***
+//===========================================
+// Called by the native code to run the command at loc in the executor.
+// Return 1 if the run was aborted, else 0.
+
+int Jit::CallStmt(Parser* prs, int loc)
+{
+  return prs->JitStmt(loc) ? 0 : 1;
+}
+//===========================================
+// Called by the native code for the array assignment at loc whose
+// indexes are not legal; elem = indexes and value.
+// Return 1 if the run was aborted, else 0.
+
+int Jit::CallSetArr(Parser* prs, int loc, double* elem)
+{
+  return prs->JitSetArr(loc, elem) ? 0 : 1;
+}
+//===========================================
+// Called by the native code to compute the expr at loc in the VM.
+// Return 1 if the run was aborted, else 0.
+
+int Jit::CallEval(Parser* prs, int loc, double* res)
+{
+  return prs->JitEval(loc, *res) ? 0 : 1;
+}
+//===========================================
+// Called by the native code to start the FOR loop at loc.
+// Return 1 to run the loop, 0 to skip it, -1 if the run was aborted.
+
+int Jit::CallFor(Parser* prs, int loc, ForStkItem* item)
+{
+  return prs->JitFor(loc, *item);
+}
+//===========================================
+// Called by the native code for the NEXT of a loop that is not an int
+// loop, or whose counter var the block assigned.
+// Return 1 to do another pass, 0 to leave the loop.
+
+int Jit::CallNext(Parser* prs, ForStkItem* item)
+{
+  prs->SyncFor(*item);
+  return prs->StepFor(*item);
+}
+//===========================================
+static double CallRoundOff(double x)
+{
+  return double(RoundOff(x));
+}
+//===========================================
+static double CallTrunc(double x)
+{
+  return double(Trunc(x));
+}
+//===========================================
+// *** COMPILER ***
+//===========================================
+// Registers and condition codes of x86-64.
+
+enum JitReg
+{
+  rAX, rCX, rDX, rBX, rSP, rBP, rSI, rDI
+};
+
+const int VARS_REG = rBX;  // base of the var table
+const int FRAME_REG = rBP;  // base of the JitFrame
+const int XMM_TMP = 14;  // scratch xmm reg
+const int XMM_ZERO = 15;  // xmm reg cleared for a comparison with 0
+
+enum JitCond  // condition codes of jcc and setcc
+{
+  ccB = 2, ccAE = 3, ccE = 4, ccNE = 5, ccBE = 6, ccA = 7, ccS = 8,
+  ccP = 10, ccNP = 11, ccL = 12, ccGE = 13, ccLE = 14, ccG = 15
+};
+
+const int PFX_SD = 0xF2;  // prefix of scalar double SSE2 instrs
+const int PFX_PD = 0x66;  // prefix of packed double SSE2 instrs
+
+enum SseOp  // SSE2 opcodes, the byte after 0F
+{
+  ssLOAD = 0x10, ssSTORE = 0x11, ssMOVAPD = 0x28, ssCVTSI2SD = 0x2A,
+  ssCVTTSD2SI = 0x2C, ssUCOMISD = 0x2E, ssSQRT = 0x51, ssXORPD = 0x57,
+  ssADD = 0x58, ssMUL = 0x59, ssSUB = 0x5C, ssDIV = 0x5E
+};
+//===========================================
+// Compile the loop whose body begins at token loc and ends at the
+// NEXT or WEND at loc end. item = stack item of the loop.
+// The code is appended to the code buffer, and loop gets its offset.
+// Return false if the loop cannot be compiled.
+// The code is entered at the top of the body, with the item of the
+// loop on the stack, and returns the loc after the loop, or -1.
+
+bool Jit::Compile(int loc, int end, JitLoop& loop, void* item)
+{
+  const TokItem* toks = Prog->GetTokens();
+  TokCode kind = toks[end].Token;
+  int top, ret, i, rel;
+
+  if ((kind != tcNEXT && kind != tcWEND) || loc > end)
+    return false;
+
+  if (Code == NULL)  // 1st compile of the run
+  {
+    Code = (unsigned char*) mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (Code == MAP_FAILED)
+    {
+      Code = NULL;
+      return false;
+    }
+
+    Labels = new int [JIT_MAX_LABELS];
+    Fixups = new JitFixup [JIT_MAX_FIXUPS];
+  }
+  else if (mprotect(Code, JIT_CODE_SIZE, PROT_READ | PROT_WRITE) != 0)
+    return false;
+
+  Pos = CodeLen;
+  Failed = false;
+  NumLabels = NumFixups = 0;
+  NumFor = NumWhile = MaxFor = MaxWhile = 0;
+
+  // rbx and rbp are callee-saved; rsp stays 16-byte aligned for calls
+  Byte(0x53);  // push rbx
+  Byte(0x55);  // push rbp
+  Byte(0x48); Byte(0x83); Byte(0xEC); Byte(0x08);  // sub rsp, 8
+  MovImm(VARS_REG, (long long) Vars->GetVars());
+  MovImm(FRAME_REG, (long long) &Frame);
+
+  Abort = NewLabel();
+  ret = NewLabel();
+  Blocks[0].End = end;
+  Blocks[0].Exit = NewLabel();
+  NumBlocks = 1;
+
+  // the stack item is in the frame
+  if (kind == tcNEXT)
+  {
+    if (!CompileForBody(loc, end, 0, rCX, 0, ((ForStkItem*) item)->Var))
+      Failed = true;
+  }
+  else
+  {
+    WhileStkItem* w = (WhileStkItem*) item;
+
+    top = NewLabel();
+    Blocks[0].Step = NewLabel();
+    Bind(top);
+
+    if (CompileBlock(loc, end) < 0)
+      Failed = true;
+
+    Bind(Blocks[0].Step);  // WEND
+    EmitLoadItem();
+    SseRM(PFX_SD, ssLOAD, 0, VARS_REG, 8 * w->Var);
+    SseRM(PFX_SD, ssLOAD, 1, rCX, offsetof(WhileStkItem, Expr));
+    EmitBranch(OpCode(opLT + (w->Op - tcLT)), 0, 1, Blocks[0].Exit);
+    Jmp(top);
+  }
+
+  // the executor pops the stack item and goes on after the loop
+  Bind(Blocks[0].Exit);
+  MovImm(rAX, end + 1);
+  Jmp(ret);
+  Bind(Abort);
+  MovImm(rAX, -1);
+  Bind(ret);
+  Byte(0x48); Byte(0x83); Byte(0xC4); Byte(0x08);  // add rsp, 8
+  Byte(0x5D);  // pop rbp
+  Byte(0x5B);  // pop rbx
+  Byte(0xC3);  // ret
+
+  for (i = 0; i < NumFixups && !Failed; i++)
+  {
+    if (Labels[Fixups[i].Label] < 0)
+    {
+      Failed = true;
+      break;
+    }
+
+    rel = Labels[Fixups[i].Label] - (Fixups[i].Pos + 4);
+    memcpy(Code + Fixups[i].Pos, &rel, 4);
+  }
+
+  if (!Failed)
+  {
+    loop.Code = CodeLen;
+    loop.NumFor = MaxFor;
+    loop.NumWhile = MaxWhile;
+    CodeLen = Pos;
+  }
+
+  if (mprotect(Code, JIT_CODE_SIZE, PROT_READ | PROT_EXEC) != 0)
+    return false;
+
+  return !Failed;
+}
+//===========================================
+// Compile the commands from loc up to loc stop.
+// Return stop, or -1 if a command cannot be compiled.
+
+int Jit::CompileBlock(int loc, int stop)
+{
+  const TokItem* toks = Prog->GetTokens();
+  int var, i;
+
+  while (loc >= 0 && loc < stop && !Failed)
+  {
+    switch (toks[loc].Token)
+    {
+      case tcVAR:  // var = expr
+        var = GetVar(loc);
+
+        if (var < 0 || toks[loc+1].Token != tcEQ ||
+          Prog->GetExpr(loc+2).Code < 0)
+          return -1;
+
+        EmitExpr(loc + 2, -1);
+        SseRM(PFX_SD, ssSTORE, 0, VARS_REG, 8 * var);
+        loc = Prog->GetExpr(loc+2).End;
+        break;
+
+      case tcARR:  // arr(i [, j]) = expr
+        loc = CompileArr(loc, stop);
+        break;
+
+      case tcIF:
+        loc = CompileIf(loc, stop);
+        break;
+
+      case tcFOR:
+        loc = CompileFor(loc, stop);
+        break;
+
+      case tcWHILE:
+        loc = CompileWhile(loc, stop);
+        break;
+
+      case tcINPUT:
+      case tcPRINT:
+      case tcRANDOMIZE:
+      case tcPRECISION:
+      case tcMAT:
+        loc = CompileCall(loc, stop);
+        break;
+
+      case tcBREAK:
+      case tcCONTINUE:
+        i = FindBlock(toks[loc].Jump);
+
+        if (i < 0)
+          return -1;
+
+        Jmp(toks[loc].Token == tcBREAK ? Blocks[i].Exit : Blocks[i].Step);
+        loc++;
+        break;
+
+      // commands that leave the loop or change the state of the executor
+      case tcELSE:
+      case tcENDIF:
+      case tcNEXT:
+      case tcWEND:
+      case tcDO:
+      case tcUNTIL:
+      case tcGOTO:
+      case tcGOSUB:
+      case tcRETURN:
+      case tcEND:
+      case tcDEB_MODE:
+      case tcDIM:
+      case tcEOF:
+        return -1;
+
+      default:  // EOL, label etc., skipped by the executor too
+        loc++;
+        break;
+    }
+  }
+
+  return loc == stop ? loc : -1;
+}
+//===========================================
+// IF expr THEN
+//   block1
+// [ ELSE
+//   block2 ]
+// ENDIF
+// Return the loc after ENDIF, or -1.
+
+int Jit::CompileIf(int loc, int stop)
+{
+  const TokItem* toks = Prog->GetTokens();
+  const ExprTblItem& e = Prog->GetExpr(loc+1);
+  int block1, loc2, end_loc, label2, end_label;
+
+  if (e.Code < 0 || toks[e.End].Token != tcTHEN ||
+    toks[e.End+1].Token != tcEOL)
+    return -1;
+
+  block1 = e.End + 2;
+  loc2 = toks[loc].Jump;  // ELSE or ENDIF
+
+  if (loc2 < block1 || loc2 >= stop)
+    return -1;
+
+  end_label = NewLabel();
+
+  if (toks[loc2].Token == tcENDIF)
+  {
+    EmitExpr(loc + 1, end_label);
+
+    if (CompileBlock(block1, loc2) < 0)
+      return -1;
+
+    Bind(end_label);
+    return loc2 + 1;
+  }
+
+  end_loc = toks[loc2].Jump;  // ENDIF
+
+  if (toks[loc2].Token != tcELSE || end_loc <= loc2 || end_loc >= stop ||
+    toks[end_loc].Token != tcENDIF)
+    return -1;
+
+  label2 = NewLabel();
+  EmitExpr(loc + 1, label2);
+
+  if (CompileBlock(block1, loc2) < 0)
+    return -1;
+
+  Jmp(end_label);
+  Bind(label2);
+
+  if (CompileBlock(loc2 + 1, end_loc) < 0)
+    return -1;
+
+  Bind(end_label);
+  return end_loc + 1;
+}
+//===========================================
+// FOR var = start_value TO end_value [ STEP step_value ]
+//   block
+// NEXT
+// The executor starts the loop, checking the values, and the item of
+// the loop is kept in the frame. Return the loc after NEXT, or -1.
+
+int Jit::CompileFor(int loc, int stop)
+{
+  const TokItem* toks = Prog->GetTokens();
+  int var, block, end_loc, disp, exit;
+
+  var = GetVar(loc + 1);
+
+  if (toks[loc+1].Token != tcVAR || var < 0 || toks[loc+2].Token != tcEQ)
+    return -1;
+
+  const ExprTblItem& e1 = Prog->GetExpr(loc+3);  // start_value
+
+  if (e1.Code < 0 || toks[e1.End].Token != tcTO)
+    return -1;
+
+  const ExprTblItem& e2 = Prog->GetExpr(e1.End+1);  // end_value
+
+  if (e2.Code < 0)
+    return -1;
+
+  block = e2.End + 1;
+
+  if (toks[e2.End].Token == tcSTEP)
+  {
+    const ExprTblItem& e3 = Prog->GetExpr(e2.End+1);  // step_value
+
+    if (e3.Code < 0)
+      return -1;
+
+    block = e3.End + 1;
+  }
+
+  end_loc = toks[loc].Jump;  // NEXT
+
+  if (toks[end_loc].Token != tcNEXT || end_loc < block || end_loc >= stop ||
+    NumFor == JIT_MAX_FOR || NumBlocks == JIT_MAX_FOR + JIT_MAX_WHILE)
+    return -1;
+
+  disp = offsetof(JitFrame, For) + NumFor * sizeof(ForStkItem);
+  exit = NewLabel();
+
+  EmitHelper((void*) CallFor, loc, disp);
+  Byte(0x85); Byte(0xC0);  // test eax, eax
+  Jcc(ccS, Abort);
+  Jcc(ccE, exit);
+
+  Blocks[NumBlocks].End = end_loc;
+  Blocks[NumBlocks].Exit = exit;
+  NumBlocks++;
+
+  if (++NumFor > MaxFor)
+    MaxFor = NumFor;
+
+  if (!CompileForBody(block, end_loc, NumBlocks - 1, FRAME_REG, disp, var))
+    return -1;
+
+  Bind(exit);
+  NumFor--;
+  NumBlocks--;
+  return end_loc + 1;
+}
+//===========================================
+// Compile the block of the FOR loop Blocks[b], from loc block up to its
+// NEXT at loc end, and the NEXT. The item of the loop is at
+// [base + disp]; base = rCX => the item is the one of Frame.Item.
+// A loop with bounds checks that can be hoisted is compiled twice: a
+// version without them, run if the checks pass before the loop, and a
+// version with them. Return false if the block cannot be compiled.
+
+bool Jit::CompileForBody(int block, int end, int b, int base, int disp,
+  int var)
+{
+  int top, checked;
+  bool ok = true;
+
+  if (FindChecks(block, end, var) > 0)
+  {
+    checked = NewLabel();
+
+    if (base == rCX)
+      EmitLoadItem();
+
+    EmitGuard(base, disp, var, checked);
+    top = NewLabel();
+    Blocks[b].Step = NewLabel();
+    Bind(top);
+    Hoisted = true;
+    ok = CompileBlock(block, end) >= 0;
+    Hoisted = false;
+    Bind(Blocks[b].Step);
+
+    if (base == rCX)
+      EmitLoadItem();
+
+    EmitNext(base, disp, var, top);
+    Jmp(Blocks[b].Exit);
+    Bind(checked);
+    NumChecks = 0;
+  }
+
+  top = NewLabel();
+  Blocks[b].Step = NewLabel();
+  Bind(top);
+
+  if (ok && CompileBlock(block, end) < 0)
+    ok = false;
+
+  Bind(Blocks[b].Step);
+
+  if (base == rCX)
+    EmitLoadItem();
+
+  EmitNext(base, disp, var, top);
+  return ok;
+}
+//===========================================
+// WHILE var op expr
+//   block
+// WEND
+// expr is computed once, when the loop starts, and kept in the frame.
+// Return the loc after WEND, or -1.
+
+int Jit::CompileWhile(int loc, int stop)
+{
+  const TokItem* toks = Prog->GetTokens();
+  const ExprTblItem& e = Prog->GetExpr(loc+3);
+  int var, block, end_loc, disp, top, step, exit;
+  OpCode op;
+
+  var = GetVar(loc + 1);
+
+  if (toks[loc+1].Token != tcVAR || var < 0 ||
+    toks[loc+2].Token < tcLT || toks[loc+2].Token > tcNE || e.Code < 0)
+    return -1;
+
+  op = OpCode(opLT + (toks[loc+2].Token - tcLT));
+  block = e.End + 1;
+  end_loc = toks[loc].Jump;  // WEND
+
+  if (toks[end_loc].Token != tcWEND || end_loc < block || end_loc >= stop ||
+    NumWhile == JIT_MAX_WHILE || NumBlocks == JIT_MAX_FOR + JIT_MAX_WHILE)
+    return -1;
+
+  disp = offsetof(JitFrame, While) + NumWhile * sizeof(double);
+  top = NewLabel();
+  step = NewLabel();
+  exit = NewLabel();
+
+  EmitExpr(loc + 3, -1);
+  SseRM(PFX_SD, ssSTORE, 0, FRAME_REG, disp);
+  SseRM(PFX_SD, ssLOAD, 0, VARS_REG, 8 * var);
+  SseRM(PFX_SD, ssLOAD, 1, FRAME_REG, disp);
+  EmitBranch(op, 0, 1, exit);
+
+  Blocks[NumBlocks].End = end_loc;
+  Blocks[NumBlocks].Step = step;
+  Blocks[NumBlocks].Exit = exit;
+  NumBlocks++;
+
+  if (++NumWhile > MaxWhile)
+    MaxWhile = NumWhile;
+
+  Bind(top);
+
+  if (CompileBlock(block, end_loc) < 0)
+    return -1;
+
+  Bind(step);
+  SseRM(PFX_SD, ssLOAD, 0, VARS_REG, 8 * var);
+  SseRM(PFX_SD, ssLOAD, 1, FRAME_REG, disp);
+  EmitBranch(op, 0, 1, exit);
+  Jmp(top);
+  Bind(exit);
+  NumWhile--;
+  NumBlocks--;
+  return end_loc + 1;
+}
+//===========================================
+// INPUT, PRINT, RANDOMIZE, PRECISION or MAT: the executor runs the
+// command.
+// Return the loc where the executor stops after it, or -1.
+
+int Jit::CompileCall(int loc, int stop)
+{
+  const TokItem* toks = Prog->GetTokens();
+  int next;
+
+  switch (toks[loc].Token)
+  {
+    case tcPRINT:  // up to the end of line
+      for (next = loc + 1; toks[next].Token != tcEOL; next++)
+        if (toks[next].Token == tcEOF)
+          return -1;
+
+      next++;
+      break;
+
+    case tcINPUT:  // INPUT [ prompt, ] var
+      if (toks[loc+1].Token == tcSTR && toks[loc+2].Token == tcCOMMA &&
+        toks[loc+3].Token == tcVAR)
+        next = loc + 4;
+      else if (toks[loc+1].Token == tcVAR)
+        next = loc + 2;
+      else
+        return -1;
+      break;
+
+    case tcMAT:  // MAT arr = arr + arr | arr * expr | func(arr)
+      if (toks[loc+1].Token != tcVAR || toks[loc+2].Token != tcEQ)
+        return -1;
+
+      if (toks[loc+3].Token == tcVAR && toks[loc+4].Token == tcPLUS &&
+        toks[loc+5].Token == tcVAR)
+        next = loc + 6;
+      else if (toks[loc+3].Token == tcVAR && toks[loc+4].Token == tcSTAR &&
+        Prog->GetExpr(loc+5).Code >= 0)
+        next = Prog->GetExpr(loc+5).End;
+      else if ((toks[loc+3].Token == tcSQR || toks[loc+3].Token == tcEXP ||
+        toks[loc+3].Token == tcLOG) && toks[loc+4].Token == tcLPAR &&
+        toks[loc+5].Token == tcVAR && toks[loc+6].Token == tcRPAR)
+        next = loc + 7;
+      else
+        return -1;
+      break;
+
+    default:  // RANDOMIZE, PRECISION expr
+      if (Prog->GetExpr(loc+1).Code < 0)
+        return -1;
+
+      next = Prog->GetExpr(loc+1).End;
+      break;
+  }
+
+  if (next > stop)
+    return -1;
+
+  EmitHelper((void*) CallStmt, loc, -1);
+  Byte(0x85); Byte(0xC0);  // test eax, eax
+  Jcc(ccNE, Abort);
+  return next;
+}
+//===========================================
+// arr(i [, j]) = expr
+// The indexes are kept in the frame while expr is computed, then the
+// element is written at its offset in the array. An illegal index is
+// left to the executor, which reports it. Return the loc after expr,
+// or -1.
+
+int Jit::CompileArr(int loc, int stop)
+{
+  const TokItem* toks = Prog->GetTokens();
+  const Instr *code1, *code2 = NULL, *end1, *end2 = NULL;
+  int arr = toks[loc].Index, loc2 = -1, rpar, fail, done;
+  bool check_i, check_j = false;
+
+  const ExprTblItem& e1 = Prog->GetExpr(loc+2);  // i
+
+  if (toks[loc+1].Token != tcLPAR || e1.Code < 0)
+    return -1;
+
+  rpar = e1.End;
+
+  if (toks[rpar].Token == tcCOMMA)
+  {
+    loc2 = rpar + 1;
+
+    if (Prog->GetExpr(loc2).Code < 0)  // j
+      return -1;
+
+    rpar = Prog->GetExpr(loc2).End;
+  }
+
+  if (toks[rpar].Token != tcRPAR || toks[rpar+1].Token != tcEQ)
+    return -1;
+
+  const ExprTblItem& e = Prog->GetExpr(rpar+2);  // expr
+
+  if (e.Code < 0 || e.End > stop)
+    return -1;
+
+  EmitExpr(loc + 2, -1);
+  SseRM(PFX_SD, ssSTORE, 0, FRAME_REG, offsetof(JitFrame, Elem));
+
+  if (loc2 >= 0)
+  {
+    EmitExpr(loc2, -1);
+    SseRM(PFX_SD, ssSTORE, 0, FRAME_REG, offsetof(JitFrame, Elem) + 8);
+  }
+
+  EmitExpr(rpar + 2, -1);
+
+  // the checks of indexes in their own exprs
+  code1 = Prog->GetCode() + e1.Opt;
+
+  for (end1 = code1; end1->Op != opEND; end1++)
+    ;
+
+  if (loc2 >= 0)
+  {
+    code2 = Prog->GetCode() + Prog->GetExpr(loc2).Opt;
+
+    for (end2 = code2; end2->Op != opEND; end2++)
+      ;
+
+    check_i = !IsHoisted(arr, offsetof(ArrItem, Rows), code1, end1);
+    check_j = !IsHoisted(arr, offsetof(ArrItem, Cols), code2, end2);
+  }
+  else
+    check_i = !IsHoisted(arr, offsetof(ArrItem, Size), code1, end1);
+
+  fail = NewLabel();
+  done = NewLabel();
+  SseRM(PFX_SD, ssCVTTSD2SI, rAX, FRAME_REG, offsetof(JitFrame, Elem));
+
+  if (loc2 >= 0)
+    SseRM(PFX_SD, ssCVTTSD2SI, rDX, FRAME_REG, offsetof(JitFrame, Elem) + 8);
+
+  EmitElem(arr, loc2 >= 0 ? 2 : 1, check_i, check_j, fail);
+  SseIdx(PFX_SD, ssSTORE, 0, rDX, rAX);
+
+  if (check_i || check_j)
+  {
+    Jmp(done);
+    Bind(fail);
+    SseRM(PFX_SD, ssSTORE, 0, FRAME_REG, offsetof(JitFrame, Elem) + 16);
+    EmitHelper((void*) CallSetArr, loc, offsetof(JitFrame, Elem));
+    Byte(0x85); Byte(0xC0);  // test eax, eax
+    Jcc(ccNE, Abort);
+    Bind(done);
+  }
+
+  return e.End;
+}
+//===========================================
+// Return the index in Blocks of the loop ending at loc end, or -1.
+
+int Jit::FindBlock(int end)
+{
+  for (int i = NumBlocks - 1; i >= 0; i--)
+    if (Blocks[i].End == end)
+      return i;
+
+  return -1;
+}
+//===========================================
+// Return the index of the var at token loc, or -1.
+
+int Jit::GetVar(int loc)
+{
+  const TokItem& t = Prog->GetTokens()[loc];
+
+  return t.Token == tcVAR ? t.Index : -1;
+}
+//===========================================
+// *** BOUNDS CHECKS ***
+//===========================================
+// Find the bounds checks that can be hoisted out of the FOR loop whose
+// block runs from loc block up to loc end, with counter var var, and
+// keep them in Checks. Only an innermost loop whose counter var is not
+// assigned in the block has them. Return their num.
+
+int Jit::FindChecks(int block, int end, int var)
+{
+  const TokItem* toks = Prog->GetTokens();
+  const Instr *code, *ip;
+  int loc, arr, len, v, offset;
+
+  NumChecks = 0;
+
+  if (IsAssigned(var, block, end))
+    return 0;
+
+  for (loc = block; loc < end; loc++)
+    if (toks[loc].Token == tcFOR || toks[loc].Token == tcWHILE)
+      return 0;
+
+  for (loc = block; loc < end; loc++)
+  {
+    if (toks[loc].Token == tcARR && Prog->GetExpr(loc+2).Code >= 0)
+    {
+      // the indexes of an assignment are exprs of their own
+      const ExprTblItem& e1 = Prog->GetExpr(loc+2);
+
+      arr = toks[loc].Index;
+      code = Prog->GetCode() + e1.Opt;
+
+      for (ip = code; ip->Op != opEND; ip++)
+        ;
+
+      if (toks[e1.End].Token != tcCOMMA)
+      {
+        AddCheck(arr, offsetof(ArrItem, Size), code, ip, block, end);
+        continue;
+      }
+
+      AddCheck(arr, offsetof(ArrItem, Rows), code, ip, block, end);
+      code = Prog->GetCode() + Prog->GetExpr(e1.End+1).Opt;
+
+      for (ip = code; ip->Op != opEND; ip++)
+        ;
+
+      AddCheck(arr, offsetof(ArrItem, Cols), code, ip, block, end);
+      continue;
+    }
+
+    if (Prog->GetExpr(loc).Code < 0)
+      continue;
+
+    code = Prog->GetCode() + Prog->GetExpr(loc).Opt;
+
+    for (ip = code; ip->Op != opEND; ip++)
+      if (ip->Op == opARR1)
+        AddCheck(ip->Arg, offsetof(ArrItem, Size), code, ip, block, end);
+      else if (ip->Op == opARR2)
+      {
+        AddCheck(ip->Arg, offsetof(ArrItem, Cols), code, ip, block, end);
+        len = MatchIndex(code, ip, v, offset);
+
+        if (len > 0)
+          AddCheck(ip->Arg, offsetof(ArrItem, Rows), code, ip - len, block,
+            end);
+      }
+  }
+
+  return NumChecks;
+}
+//===========================================
+// Add the check of the index whose code ends before end, if it can be
+// hoisted out of the loop whose block runs from loc block up to loc
+// end_loc. Its var must be the counter var, or not be assigned in the
+// block.
+
+void Jit::AddCheck(int arr, int bound, const Instr* start, const Instr* end,
+  int block, int end_loc)
+{
+  int var, offset, i;
+
+  if (MatchIndex(start, end, var, offset) == 0 ||
+    NumChecks == JIT_MAX_CHECKS)
+    return;
+
+  for (i = 0; i < NumChecks; i++)
+    if (Checks[i].Arr == arr && Checks[i].Bound == bound &&
+      Checks[i].Var == var && Checks[i].Offset == offset)
+      return;
+
+  if (IsAssigned(var, block, end_loc))
+    return;
+
+  Checks[NumChecks].Arr = arr;
+  Checks[NumChecks].Bound = bound;
+  Checks[NumChecks].Var = var;
+  Checks[NumChecks++].Offset = offset;
+}
+//===========================================
+// Match the index whose code ends before end, and begins at start or
+// later, with var, var + c, c + var or var - c; c = int constant.
+// Return the num of instrs of the index, or 0 if it does not match.
+
+int Jit::MatchIndex(const Instr* start, const Instr* end, int& var,
+  int& offset)
+{
+  double c;
+
+  if (end - start >= 1 && end[-1].Op == opVAR)
+  {
+    var = end[-1].Arg;
+    offset = 0;
+    return 1;
+  }
+
+  if (end - start < 3 || (end[-1].Op != opADD && end[-1].Op != opSUB))
+    return 0;
+
+  if (end[-3].Op == opVAR && end[-2].Op == opNUM)
+  {
+    var = end[-3].Arg;
+    c = Prog->GetNumPool()[end[-2].Arg].Value;
+
+    if (end[-1].Op == opSUB)
+      c = -c;
+  }
+  else if (end[-1].Op == opADD && end[-3].Op == opNUM &&
+    end[-2].Op == opVAR)
+  {
+    var = end[-2].Arg;
+    c = Prog->GetNumPool()[end[-3].Arg].Value;
+  }
+  else
+    return 0;
+
+  if (!(c >= -ARR_MAX_SIZE && c <= ARR_MAX_SIZE) || c != floor(c))
+    return 0;
+
+  offset = int(c);
+  return 3;
+}
+//===========================================
+// Return true if var can be assigned in the block from loc block up to
+// loc end: by var = expr, INPUT or FOR. var = in an expr is a
+// comparison.
+
+bool Jit::IsAssigned(int var, int block, int end)
+{
+  const TokItem* toks = Prog->GetTokens();
+  TokCode prev;
+  int loc;
+
+  for (loc = block; loc < end; loc++)
+  {
+    if (toks[loc].Token != tcVAR || toks[loc].Index != var)
+      continue;
+
+    prev = toks[loc-1].Token;
+
+    if (prev == tcINPUT || (prev == tcCOMMA && toks[loc-2].Token == tcSTR &&
+      toks[loc-3].Token == tcINPUT))
+      return true;
+
+    if (toks[loc+1].Token != tcEQ)
+      continue;
+
+    switch (prev)
+    {
+      case tcOR: case tcAND: case tcNOT:
+      case tcIF: case tcWHILE: case tcUNTIL:
+      case tcPRINT: case tcRANDOMIZE: case tcPRECISION:
+      case tcTO: case tcSTEP:
+      case tcPLUS: case tcMINUS: case tcSTAR: case tcSLASH: case tcPERC:
+      case tcLPAR: case tcCOMMA: case tcSEMI:
+      case tcLT: case tcLE: case tcGT: case tcGE: case tcEQ: case tcNE:
+        break;  // in an expr
+
+      default:
+        return true;
+    }
+  }
+
+  return false;
+}
+//===========================================
+// Return true if the check of the index whose code ends before end is
+// done before the loop being compiled.
+
+bool Jit::IsHoisted(int arr, int bound, const Instr* start, const Instr* end)
+{
+  int var, offset, i;
+
+  if (!Hoisted || MatchIndex(start, end, var, offset) == 0)
+    return false;
+
+  for (i = 0; i < NumChecks; i++)
+    if (Checks[i].Arr == arr && Checks[i].Bound == bound &&
+      Checks[i].Var == var && Checks[i].Offset == offset)
+      return true;
+
+  return false;
+}
+//===========================================
+// Do the hoisted checks before the FOR loop whose item is at
+// [base + disp] and whose counter var is var. Jump to fail if an
+// index could be out of range in the loop. The counter of an int loop
+// goes from Count to EndCount, so its index is checked at both ends.
+
+void Jit::EmitGuard(int base, int disp, int var, int fail)
+{
+  long long bits;
+  double value;
+  int i, label;
+
+  for (i = 0; i < NumChecks; i++)
+  {
+    const JitCheck& c = Checks[i];
+
+    MovImm(rDI, (long long) &Arrs->GetArrs()[c.Arr]);
+    Byte(0x8B);  // mov edi, [rdi + Bound]
+    RegMem(rDI, rDI, c.Bound);
+
+    if (c.Var == var)
+    {
+      Rex(false, 0, base);
+      Byte(0x80);  // cmp byte [IsInt], 0
+      RegMem(7, base, disp + offsetof(ForStkItem, IsInt));
+      Byte(0);
+      Jcc(ccE, fail);
+
+      Rex(true, rAX, base);
+      Byte(0x8B);  // mov rax, [Count]
+      RegMem(rAX, base, disp + offsetof(ForStkItem, Count));
+      Rex(true, rDX, base);
+      Byte(0x8B);  // mov rdx, [EndCount]
+      RegMem(rDX, base, disp + offsetof(ForStkItem, EndCount));
+      Byte(0x48); Byte(0x39); RegReg(rDX, rAX);  // cmp rax, rdx
+      label = NewLabel();
+      Jcc(ccLE, label);
+      Byte(0x48); Byte(0x92);  // xchg rax, rdx
+      Bind(label);
+
+      Rex(true, rSI, rAX);
+      Byte(0x8D);  // lea rsi, [rax + Offset]
+      RegMem(rSI, rAX, c.Offset);
+      Byte(0x48); Byte(0x85); RegReg(rSI, rSI);  // test rsi, rsi
+      Jcc(ccS, fail);
+      Rex(true, rSI, rDX);
+      Byte(0x8D);  // lea rsi, [rdx + Offset]
+      RegMem(rSI, rDX, c.Offset);
+      Byte(0x48); Byte(0x39); RegReg(rDI, rSI);  // cmp rsi, rdi
+      Jcc(ccGE, fail);
+      continue;
+    }
+
+    // a var not assigned in the loop: trunc(var + Offset) as in the loop
+    SseRM(PFX_SD, ssLOAD, 0, VARS_REG, 8 * c.Var);
+
+    if (c.Offset != 0)
+    {
+      value = c.Offset;
+      memcpy(&bits, &value, sizeof(bits));
+      MovImm(rAX, bits);
+      Byte(0x66); Rex(true, 1, rAX);  // movq xmm1, rax
+      Byte(0x0F); Byte(0x6E); RegReg(1, rAX);
+      SseRR(PFX_SD, ssADD, 0, 1);
+    }
+
+    SseRR(PFX_SD, ssCVTTSD2SI, rAX, 0);
+    Byte(0x39); RegReg(rDI, rAX);  // cmp eax, edi
+    Jcc(ccAE, fail);
+  }
+}
+//===========================================
+// Return true if the expr code at ip can be run natively: it has no
+// RND and its operand stack fits in the xmm regs.
+
+bool Jit::IsNative(const Instr* ip)
+{
+  int depth = 0;
+
+  for (; ip->Op != opEND; ip++)
+    switch (ip->Op)
+    {
+      case opNUM:
+      case opVAR:
+      case opDUP:
+        if (++depth > JIT_NUM_REGS)
+          return false;
+        break;
+
+      case opRND:
+      case opREF:  // whole-array funcs
+        return false;
+
+      // unary ops
+      case opNOT:
+      case opPLUS:
+      case opNEG:
+      case opLPAR:
+      case opRPAR:
+      case opABS:
+      case opSGN:
+      case opCINT:
+      case opFIX:
+      case opSQR:
+      case opEXP:
+      case opLOG:
+      case opARR1:
+        break;
+
+      default:  // binary ops
+        depth--;
+        break;
+    }
+
+  return depth == 1;
+}
+//===========================================
+// Compile the expr at token loc.
+// false_label < 0 => leave the value in xmm0, else jump to false_label
+// if the value is 0 and go on if it is not.
+// An op whose operands would raise an error jumps to the slow path,
+// where the VM computes the whole expr and reports the error.
+
+void Jit::EmitExpr(int loc, int false_label)
+{
+  const ExprTblItem& e = Prog->GetExpr(loc);
+  const Instr* code = Prog->GetCode() + e.Opt;
+  const Instr *ip, *last = NULL;
+  int depth = 0, done = -1;
+  bool cond_done = false;
+
+  Slow = -1;
+  ExprCode = code;
+
+  if (IsNative(code))
+  {
+    for (ip = code; ip->Op != opEND; ip++)
+      last = ip;
+
+    for (ip = code; ip->Op != opEND; ip++)
+      if (false_label >= 0 && ip == last && ip->Op >= opLT &&
+        ip->Op <= opNE)
+      {
+        // a final comparison jumps, no 0/1 value needed
+        EmitBranch(ip->Op, depth - 2, depth - 1, false_label);
+        cond_done = true;
+      }
+      else
+        EmitOp(ip, depth);
+
+    if (false_label >= 0 && !cond_done)
+      EmitTest(0, false_label);
+
+    if (Slow < 0)
+      return;
+
+    done = NewLabel();
+    Jmp(done);
+    Bind(Slow);
+  }
+
+  EmitHelper((void*) CallEval, loc, offsetof(JitFrame, Tmp));
+  Byte(0x85); Byte(0xC0);  // test eax, eax
+  Jcc(ccNE, Abort);
+  SseRM(PFX_SD, ssLOAD, 0, FRAME_REG, offsetof(JitFrame, Tmp));
+
+  if (false_label >= 0)
+    EmitTest(0, false_label);
+
+  if (done >= 0)
+    Bind(done);
+}
+//===========================================
+// Compile the op of instr ip. The operand stack is held in xmm0 ...
+// xmm(depth-1). Every op computes exactly what the VM computes.
+
+void Jit::EmitOp(const Instr* ip, int& depth)
+{
+  int x = depth - 1;  // operand of unary op
+  int y = depth - 1;  // 2nd operand of binary op
+  long long bits;
+  double value;
+  int label;
+
+  switch (ip->Op)
+  {
+    case opNUM:
+      value = Prog->GetNumPool()[ip->Arg].Value;
+      memcpy(&bits, &value, sizeof(bits));
+
+      if (bits == 0)
+        SseRR(PFX_PD, ssXORPD, depth, depth);
+      else
+      {
+        MovImm(rAX, bits);
+        Byte(0x66); Rex(true, depth, rAX);  // movq xmm, rax
+        Byte(0x0F); Byte(0x6E); RegReg(depth, rAX);
+      }
+      depth++;
+      return;
+
+    case opVAR:
+      SseRM(PFX_SD, ssLOAD, depth, VARS_REG, 8 * ip->Arg);
+      depth++;
+      return;
+
+    case opDUP:
+      SseRR(PFX_PD, ssMOVAPD, depth, depth - 1);
+      depth++;
+      return;
+
+    case opPLUS:
+    case opLPAR:
+    case opRPAR:
+      return;
+
+    case opNEG:
+      EmitNeg(x);
+      return;
+
+    case opABS:  // negate if x < 0
+      Zero();
+      SseRR(PFX_PD, ssUCOMISD, XMM_ZERO, x);
+      label = NewLabel();
+      Jcc(ccBE, label);
+      EmitNeg(x);
+      Bind(label);
+      return;
+
+    case opSGN:  // (x > 0) - (x < 0)
+      Zero();
+      SseRR(PFX_PD, ssUCOMISD, x, XMM_ZERO);
+      SetCC(ccA, rAX);
+      SseRR(PFX_PD, ssUCOMISD, XMM_ZERO, x);
+      SetCC(ccA, rCX);
+      Byte(0x0F); Byte(0xB6); Byte(0xC0);  // movzx eax, al
+      Byte(0x0F); Byte(0xB6); Byte(0xC9);  // movzx ecx, cl
+      Byte(0x29); Byte(0xC8);  // sub eax, ecx
+      CvtInt(x, rAX);
+      return;
+
+    case opNOT:  // x == 0
+      Zero();
+      SseRR(PFX_PD, ssUCOMISD, x, XMM_ZERO);
+      SetCC(ccE, rAX);
+      SetCC(ccNP, rCX);
+      Byte(0x20); Byte(0xC8);  // and al, cl
+      Byte(0x0F); Byte(0xB6); Byte(0xC0);  // movzx eax, al
+      CvtInt(x, rAX);
+      return;
+
+    case opCINT:
+      EmitCallFunc((void*) CallRoundOff, x, -1);
+      return;
+
+    case opFIX:
+      EmitCallFunc((void*) CallTrunc, x, -1);
+      return;
+
+    case opEXP:
+      EmitCallFunc((void*) (double (*)(double)) exp, x, -1);
+      return;
+
+    case opSQR:  // x < 0 is an error
+      Zero();
+      SseRR(PFX_PD, ssUCOMISD, XMM_ZERO, x);
+      Jcc(ccA, GetSlow());
+      SseRR(PFX_SD, ssSQRT, x, x);
+      return;
+
+    case opLOG:  // x <= 0 is an error
+      Zero();
+      SseRR(PFX_PD, ssUCOMISD, XMM_ZERO, x);
+      Jcc(ccAE, GetSlow());
+      EmitCallFunc((void*) (double (*)(double)) log, x, -1);
+      return;
+
+    case opARR1:
+    case opARR2:
+      EmitArr(ip, depth);
+      return;
+
+    default:  // binary ops
+      break;
+  }
+
+  x = depth - 2;
+  depth--;
+
+  switch (ip->Op)
+  {
+    case opADD:
+      SseRR(PFX_SD, ssADD, x, y);
+      break;
+
+    case opSUB:
+      SseRR(PFX_SD, ssSUB, x, y);
+      break;
+
+    case opMUL:
+      SseRR(PFX_SD, ssMUL, x, y);
+      break;
+
+    case opDIV:  // y == 0 is an error
+      Zero();
+      SseRR(PFX_PD, ssUCOMISD, y, XMM_ZERO);
+      label = NewLabel();
+      Jcc(ccP, label);
+      Jcc(ccE, GetSlow());
+      Bind(label);
+      SseRR(PFX_SD, ssDIV, x, y);
+      break;
+
+    case opMOD:  // int(x) % int(y); x, y not int or y == 0 is an error
+      SseRR(PFX_SD, ssCVTTSD2SI, rAX, x);
+      CvtInt(XMM_TMP, rAX);
+      SseRR(PFX_PD, ssUCOMISD, XMM_TMP, x);
+      Jcc(ccNE, GetSlow());
+      Jcc(ccP, GetSlow());
+      SseRR(PFX_SD, ssCVTTSD2SI, rCX, y);
+      CvtInt(XMM_TMP, rCX);
+      SseRR(PFX_PD, ssUCOMISD, XMM_TMP, y);
+      Jcc(ccNE, GetSlow());
+      Jcc(ccP, GetSlow());
+      Byte(0x85); Byte(0xC9);  // test ecx, ecx
+      Jcc(ccE, GetSlow());
+      Byte(0x83); Byte(0xF9); Byte(0xFF);  // cmp ecx, -1
+      Jcc(ccE, GetSlow());  // left to the VM, idiv may trap
+      Byte(0x99);  // cdq
+      Byte(0xF7); Byte(0xF9);  // idiv ecx
+      CvtInt(x, rDX);
+      break;
+
+    case opPOW:  // y < 0 or y not int is an error
+      Zero();
+      SseRR(PFX_PD, ssUCOMISD, XMM_ZERO, y);
+      Jcc(ccA, GetSlow());
+      SseRR(PFX_SD, ssCVTTSD2SI, rAX, y);
+      CvtInt(XMM_TMP, rAX);
+      SseRR(PFX_PD, ssUCOMISD, XMM_TMP, y);
+      Jcc(ccNE, GetSlow());
+      Jcc(ccP, GetSlow());
+      EmitCallFunc((void*) (double (*)(double, double)) pow, x, y);
+      break;
+
+    case opAND:  // (x != 0) & (y != 0)
+    case opOR:  // (x != 0) | (y != 0)
+      Zero();
+      SseRR(PFX_PD, ssUCOMISD, x, XMM_ZERO);
+      SetCC(ccNE, rAX);
+      SetCC(ccP, rCX);
+      Byte(0x08); Byte(0xC8);  // or al, cl
+      SseRR(PFX_PD, ssUCOMISD, y, XMM_ZERO);
+      SetCC(ccNE, rDX);
+      SetCC(ccP, rCX);
+      Byte(0x08); Byte(0xCA);  // or dl, cl
+      Byte(ip->Op == opAND ? 0x20 : 0x08); Byte(0xD0);  // and/or al, dl
+      Byte(0x0F); Byte(0xB6); Byte(0xC0);  // movzx eax, al
+      CvtInt(x, rAX);
+      break;
+
+    case opLT:
+    case opLE:
+    case opGT:
+    case opGE:
+    case opEQ:
+    case opNE:
+      EmitSetCmp(ip->Op, x, y);
+      break;
+
+    default:
+      Failed = true;
+      break;
+  }
+}
+//===========================================
+// Compare xmm x with xmm y using rel op op and jump to false_label if
+// the result is false. A NaN compares as in C++.
+
+void Jit::EmitBranch(OpCode op, int x, int y, int false_label)
+{
+  int label;
+
+  switch (op)
+  {
+    case opLT:  // y > x
+      SseRR(PFX_PD, ssUCOMISD, y, x);
+      Jcc(ccBE, false_label);
+      break;
+
+    case opLE:  // y >= x
+      SseRR(PFX_PD, ssUCOMISD, y, x);
+      Jcc(ccB, false_label);
+      break;
+
+    case opGT:
+      SseRR(PFX_PD, ssUCOMISD, x, y);
+      Jcc(ccBE, false_label);
+      break;
+
+    case opGE:
+      SseRR(PFX_PD, ssUCOMISD, x, y);
+      Jcc(ccB, false_label);
+      break;
+
+    case opEQ:
+      SseRR(PFX_PD, ssUCOMISD, x, y);
+      Jcc(ccNE, false_label);
+      Jcc(ccP, false_label);
+      break;
+
+    default:  // opNE
+      SseRR(PFX_PD, ssUCOMISD, x, y);
+      label = NewLabel();
+      Jcc(ccP, label);
+      Jcc(ccE, false_label);
+      Bind(label);
+      break;
+  }
+}
+//===========================================
+// Compare xmm x with xmm y using rel op op and put the result, 0 or 1,
+// in xmm x.
+
+void Jit::EmitSetCmp(OpCode op, int x, int y)
+{
+  switch (op)
+  {
+    case opLT:
+      SseRR(PFX_PD, ssUCOMISD, y, x);
+      SetCC(ccA, rAX);
+      break;
+
+    case opLE:
+      SseRR(PFX_PD, ssUCOMISD, y, x);
+      SetCC(ccAE, rAX);
+      break;
+
+    case opGT:
+      SseRR(PFX_PD, ssUCOMISD, x, y);
+      SetCC(ccA, rAX);
+      break;
+
+    case opGE:
+      SseRR(PFX_PD, ssUCOMISD, x, y);
+      SetCC(ccAE, rAX);
+      break;
+
+    case opEQ:
+      SseRR(PFX_PD, ssUCOMISD, x, y);
+      SetCC(ccE, rAX);
+      SetCC(ccNP, rCX);
+      Byte(0x20); Byte(0xC8);  // and al, cl
+      break;
+
+    default:  // opNE
+      SseRR(PFX_PD, ssUCOMISD, x, y);
+      SetCC(ccNE, rAX);
+      SetCC(ccP, rCX);
+      Byte(0x08); Byte(0xC8);  // or al, cl
+      break;
+  }
+
+  Byte(0x0F); Byte(0xB6); Byte(0xC0);  // movzx eax, al
+  CvtInt(x, rAX);
+}
+//===========================================
+// Jump to false_label if xmm x is 0. A NaN is true, as in C++.
+
+void Jit::EmitTest(int x, int false_label)
+{
+  int label = NewLabel();
+
+  Zero();
+  SseRR(PFX_PD, ssUCOMISD, x, XMM_ZERO);
+  Jcc(ccP, label);
+  Jcc(ccE, false_label);
+  Bind(label);
+}
+//===========================================
+// Flip the sign of xmm x.
+
+void Jit::EmitNeg(int x)
+{
+  Byte(0x66); Rex(true, x, rAX);  // movq rax, xmm
+  Byte(0x0F); Byte(0x7E); RegReg(x, rAX);
+  Byte(0x48); Byte(0x0F); Byte(0xBA); Byte(0xF8); Byte(63);  // btc rax, 63
+  Byte(0x66); Rex(true, x, rAX);  // movq xmm, rax
+  Byte(0x0F); Byte(0x6E); RegReg(x, rAX);
+}
+//===========================================
+// Call the C function func(xmm x [, xmm y]) and put its result in xmm
+// x. The operands below x are saved in the frame across the call.
+
+void Jit::EmitCallFunc(void* func, int x, int y)
+{
+  int i;
+
+  for (i = 0; i < x; i++)
+    SseRM(PFX_SD, ssSTORE, i, FRAME_REG, offsetof(JitFrame, Spill) + 8 * i);
+
+  if (x != 0)
+    SseRR(PFX_PD, ssMOVAPD, 0, x);
+
+  if (y >= 0 && y != 1)
+    SseRR(PFX_PD, ssMOVAPD, 1, y);
+
+  Call(func);
+
+  if (x != 0)
+    SseRR(PFX_PD, ssMOVAPD, x, 0);
+
+  for (i = 0; i < x; i++)
+    SseRM(PFX_SD, ssLOAD, i, FRAME_REG, offsetof(JitFrame, Spill) + 8 * i);
+}
+//===========================================
+// Array element ip, A(i) or A(i, j). The indexes are in xmm x [and
+// xmm x+1], and the element replaces them in xmm x. An index out of
+// range jumps to the slow path, unless its check is hoisted.
+
+void Jit::EmitArr(const Instr* ip, int& depth)
+{
+  int dims = ip->Op == opARR1 ? 1 : 2, x = depth - dims, len, var, offset;
+  bool check_i, check_j = false;
+
+  if (dims == 1)
+  {
+    check_i = !IsHoisted(ip->Arg, offsetof(ArrItem, Size), ExprCode, ip);
+    SseRR(PFX_SD, ssCVTTSD2SI, rAX, x);
+  }
+  else
+  {
+    len = MatchIndex(ExprCode, ip, var, offset);
+    check_i = len == 0 ||
+      !IsHoisted(ip->Arg, offsetof(ArrItem, Rows), ExprCode, ip - len);
+    check_j = !IsHoisted(ip->Arg, offsetof(ArrItem, Cols), ExprCode, ip);
+    SseRR(PFX_SD, ssCVTTSD2SI, rAX, x);
+    SseRR(PFX_SD, ssCVTTSD2SI, rDX, x + 1);
+    depth--;
+  }
+
+  EmitElem(ip->Arg, dims, check_i, check_j, GetSlow());
+  SseIdx(PFX_SD, ssLOAD, x, rDX, rAX);
+}
+//===========================================
+// Offset of the element of array arr whose indexes are in eax [and
+// edx]. Leave the data of arr in rdx and the offset in rax. An index
+// out of range jumps to fail; check_i, check_j = false => no check.
+// An index < 0, or beyond the dims of a 1-dim or 2-dim arr, is out of
+// range as an unsigned int.
+
+void Jit::EmitElem(int arr, int dims, bool check_i, bool check_j, int fail)
+{
+  MovImm(rCX, (long long) &Arrs->GetArrs()[arr]);
+
+  if (dims == 1)
+  {
+    if (check_i)
+    {
+      Byte(0x3B);  // cmp eax, [rcx + Size]
+      RegMem(rAX, rCX, offsetof(ArrItem, Size));
+      Jcc(ccAE, fail);
+    }
+  }
+  else
+  {
+    if (check_i)
+    {
+      Byte(0x3B);  // cmp eax, [rcx + Rows]
+      RegMem(rAX, rCX, offsetof(ArrItem, Rows));
+      Jcc(ccAE, fail);
+    }
+
+    if (check_j)
+    {
+      Byte(0x3B);  // cmp edx, [rcx + Cols]
+      RegMem(rDX, rCX, offsetof(ArrItem, Cols));
+      Jcc(ccAE, fail);
+    }
+
+    Byte(0x0F); Byte(0xAF);  // imul eax, [rcx + Cols]
+    RegMem(rAX, rCX, offsetof(ArrItem, Cols));
+    Byte(0x01); RegReg(rDX, rAX);  // add eax, edx
+  }
+
+  Rex(true, rDX, rCX);
+  Byte(0x8B);  // mov rdx, [rcx + Data]
+  RegMem(rDX, rCX, offsetof(ArrItem, Data));
+}
+//===========================================
+// NEXT of the FOR loop whose item is at [base + disp], counter var var.
+// An int loop whose counter var was not assigned in the block steps
+// here; anything else is done by Parser::StepFor().
+// Jump to top for another pass, else go on.
+
+void Jit::EmitNext(int base, int disp, int var, int top)
+{
+  int slow = NewLabel(), down = NewLabel(), store = NewLabel();
+  int exit = NewLabel();
+
+  Rex(false, 0, base);
+  Byte(0x80);  // cmp byte [IsInt], 0
+  RegMem(7, base, disp + offsetof(ForStkItem, IsInt));
+  Byte(0);
+  Jcc(ccE, slow);
+
+  Rex(true, rAX, base);
+  Byte(0x8B);  // mov rax, [Count]
+  RegMem(rAX, base, disp + offsetof(ForStkItem, Count));
+  Byte(PFX_SD); Rex(true, 0, rAX);  // cvtsi2sd xmm0, rax
+  Byte(0x0F); Byte(ssCVTSI2SD); RegReg(0, rAX);
+  SseRM(PFX_PD, ssUCOMISD, 0, VARS_REG, 8 * var);
+  Jcc(ccNE, slow);  // the block assigned the counter var
+  Jcc(ccP, slow);
+
+  Rex(true, rAX, base);
+  Byte(0x03);  // add rax, [StepCount]
+  RegMem(rAX, base, disp + offsetof(ForStkItem, StepCount));
+  Rex(true, rAX, base);
+  Byte(0x89);  // mov [Count], rax
+  RegMem(rAX, base, disp + offsetof(ForStkItem, Count));
+  Rex(true, 0, base);
+  Byte(0x83);  // cmp qword [StepCount], 0
+  RegMem(7, base, disp + offsetof(ForStkItem, StepCount));
+  Byte(0);
+  Jcc(ccLE, down);
+
+  Rex(true, rAX, base);
+  Byte(0x3B);  // cmp rax, [EndCount]
+  RegMem(rAX, base, disp + offsetof(ForStkItem, EndCount));
+  Jcc(ccG, exit);
+  Jmp(store);
+
+  Bind(down);
+  Rex(true, rAX, base);
+  Byte(0x3B);  // cmp rax, [EndCount]
+  RegMem(rAX, base, disp + offsetof(ForStkItem, EndCount));
+  Jcc(ccL, exit);
+
+  Bind(store);
+  Byte(PFX_SD); Rex(true, 0, rAX);  // cvtsi2sd xmm0, rax
+  Byte(0x0F); Byte(ssCVTSI2SD); RegReg(0, rAX);
+  SseRM(PFX_SD, ssSTORE, 0, VARS_REG, 8 * var);
+  Jmp(top);
+
+  Bind(slow);
+  MovImm(rDI, (long long) Prs);
+  Rex(true, rSI, base);
+  Byte(0x8D);  // lea rsi, [base + disp]
+  RegMem(rSI, base, disp);
+  Call((void*) CallNext);
+  Byte(0x85); Byte(0xC0);  // test eax, eax
+  Jcc(ccNE, top);
+  Bind(exit);
+}
+//===========================================
+// Call callback func(Prs, loc [, frame + disp]); disp < 0 => no 3rd arg.
+
+void Jit::EmitHelper(void* func, int loc, int disp)
+{
+  MovImm(rDI, (long long) Prs);
+  MovImm(rSI, loc);
+
+  if (disp >= 0)
+  {
+    Rex(true, rDX, FRAME_REG);
+    Byte(0x8D);  // lea rdx, [rbp + disp]
+    RegMem(rDX, FRAME_REG, disp);
+  }
+
+  Call(func);
+}
+//===========================================
+// mov rcx, [rbp + Item]: the stack item of the loop being run.
+
+void Jit::EmitLoadItem()
+{
+  Rex(true, rCX, FRAME_REG);
+  Byte(0x8B);
+  RegMem(rCX, FRAME_REG, offsetof(JitFrame, Item));
+}
+//===========================================
+// Return the label of the slow path of the current expr.
+
+int Jit::GetSlow()
+{
+  if (Slow < 0)
+    Slow = NewLabel();
+
+  return Slow;
+}
+//===========================================
+// *** x86-64 ENCODER ***
+//===========================================
+void Jit::Byte(int b)
+{
+  if (Pos >= JIT_CODE_SIZE)
+  {
+    Failed = true;  // code buffer is full
+    return;
+  }
+
+  Code[Pos++] = (unsigned char) b;
+}
+//===========================================
+void Jit::Int32(int n)
+{
+  for (int i = 0; i < 4; i++)
+    Byte((n >> (8 * i)) & 0xFF);
+}
+//===========================================
+void Jit::Int64(long long n)
+{
+  for (int i = 0; i < 8; i++)
+    Byte(int((n >> (8 * i)) & 0xFF));
+}
+//===========================================
+// REX prefix: w = 64-bit operand, reg = ModRM reg field, base = ModRM
+// rm field. Emitted only if needed, or force = true.
+
+void Jit::Rex(bool w, int reg, int base, bool force)
+{
+  int b = 0x40 | (w ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((base & 8) ? 1 : 0);
+
+  if (b != 0x40 || force)
+    Byte(b);
+}
+//===========================================
+// ModRM of a reg, reg operand.
+
+void Jit::RegReg(int reg, int rm)
+{
+  Byte(0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+//===========================================
+// ModRM of a reg, [base + disp32] operand.
+
+void Jit::RegMem(int reg, int base, int disp)
+{
+  Byte(0x80 | ((reg & 7) << 3) | (base & 7));
+
+  if ((base & 7) == rSP)  // needs a SIB byte
+    Byte(0x24);
+
+  Int32(disp);
+}
+//===========================================
+// SSE2 instr with reg, reg operands.
+
+void Jit::SseRR(int prefix, int op, int reg, int rm)
+{
+  Byte(prefix);
+  Rex(false, reg, rm);
+  Byte(0x0F);
+  Byte(op);
+  RegReg(reg, rm);
+}
+//===========================================
+// SSE2 instr with xmm reg, [base + disp] operands.
+
+void Jit::SseRM(int prefix, int op, int reg, int base, int disp)
+{
+  Byte(prefix);
+  Rex(false, reg, base);
+  Byte(0x0F);
+  Byte(op);
+  RegMem(reg, base, disp);
+}
+//===========================================
+// SSE2 instr with xmm reg, [base + index * 8] operands.
+
+void Jit::SseIdx(int prefix, int op, int reg, int base, int index)
+{
+  Byte(prefix);
+  Rex(false, reg, base);
+  Byte(0x0F);
+  Byte(op);
+  Byte(0x04 | ((reg & 7) << 3));  // ModRM: SIB follows
+  Byte(0xC0 | ((index & 7) << 3) | (base & 7));  // SIB: scale 8
+}
+//===========================================
+// mov reg, n. A 32-bit n is zero-extended, so -1 gives eax = -1.
+
+void Jit::MovImm(int reg, long long n)
+{
+  if (n >= -0x80000000LL && n <= 0xFFFFFFFFLL)
+  {
+    Rex(false, 0, reg);
+    Byte(0xB8 + (reg & 7));
+    Int32(int(n));
+    return;
+  }
+
+  Rex(true, 0, reg);
+  Byte(0xB8 + (reg & 7));
+  Int64(n);
+}
+//===========================================
+// setcc reg8, for al, cl, dl, bl.
+
+void Jit::SetCC(int cc, int reg)
+{
+  Byte(0x0F);
+  Byte(0x90 + cc);
+  RegReg(0, reg);
+}
+//===========================================
+// cvtsi2sd xmm x, reg32
+
+void Jit::CvtInt(int x, int reg)
+{
+  Byte(PFX_SD);
+  Rex(false, x, reg);
+  Byte(0x0F);
+  Byte(ssCVTSI2SD);
+  RegReg(x, reg);
+}
+//===========================================
+void Jit::Call(void* func)
+{
+  MovImm(rAX, (long long) func);
+  Byte(0xFF); Byte(0xD0);  // call rax
+}
+//===========================================
+// Clear xmm XMM_ZERO.
+
+void Jit::Zero()
+{
+  SseRR(PFX_PD, ssXORPD, XMM_ZERO, XMM_ZERO);
+}
+//===========================================
+int Jit::NewLabel()
+{
+  if (NumLabels == JIT_MAX_LABELS)
+  {
+    Failed = true;
+    return 0;
+  }
+
+  Labels[NumLabels] = -1;
+  return NumLabels++;
+}
+//===========================================
+void Jit::Bind(int label)
+{
+  Labels[label] = Pos;
+}
+//===========================================
+void Jit::Jmp(int label)
+{
+  Byte(0xE9);
+
+  if (NumFixups == JIT_MAX_FIXUPS)
+    Failed = true;
+  else
+  {
+    Fixups[NumFixups].Pos = Pos;
+    Fixups[NumFixups++].Label = label;
+  }
+
+  Int32(0);
+}
+//===========================================
+void Jit::Jcc(int cc, int label)
+{
+  Byte(0x0F);
+  Byte(0x80 + cc);
+
+  if (NumFixups == JIT_MAX_FIXUPS)
+    Failed = true;
+  else
+  {
+    Fixups[NumFixups].Pos = Pos;
+    Fixups[NumFixups++].Label = label;
+  }
+
+  Int32(0);
+}
+//===========================================
+#endif
+//===========================================
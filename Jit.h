@@ -0,0 +1,213 @@
+//===========================================
+//
+//  Jit.h
+//
+// Author: Theo P. (theo_pap@otenet.gr)
+// Language used: C++
+// Copyright: No copyright. You can do with this software whatever
+// you like.
+// Warranty: No warranty. Use this software at your own risk.
+//===========================================
+
+#ifndef JIT_H
+#define JIT_H
+
+#include "SupportClasses.h"
+#include "Program.h"
+
+//===========================================
+// Native code is generated for x86-64 only, on systems with mmap.
+// Define NO_JIT to run everything in the interpreter.
+
+#if defined(__x86_64__) && !defined(_WIN32) && !defined(NO_JIT)
+#define JIT_SUPPORTED
+#endif
+
+//===========================================
+const int JIT_HOT_COUNT = 64;  // num of passes before a loop is compiled
+const int JIT_CODE_SIZE = 1 << 20;  // size of the code buffer of a run
+const int JIT_NUM_REGS = 14;  // xmm regs holding the VM operand stack
+const int JIT_MAX_LABELS = 8192;  // max num of labels of a loop
+const int JIT_MAX_FIXUPS = 16384;  // max num of jumps of a loop
+const int JIT_NOT_RUN = -2;  // Run(): the loop was not run natively
+const int JIT_NONE = -1;  // JitLoop::Code: not compiled yet
+const int JIT_FAILED = -2;  // JitLoop::Code: cannot be compiled
+const int JIT_MAX_CHECKS = 16;  // max num of checks hoisted out of a loop
+const int JIT_MAX_FOR = 32;  // max nesting of FOR loops in a loop
+const int JIT_MAX_WHILE = 32;  // max nesting of WHILE loops in a loop
+//===========================================
+struct JitLoop  // compile state of a loop
+{
+  int Count;  // num of passes counted so far
+  int Code;  // offset of native code, JIT_NONE or JIT_FAILED
+  int NumFor;  // max nesting of FOR loops inside the loop
+  int NumWhile;  // max nesting of WHILE loops inside the loop
+};
+//===========================================
+// Memory used by the native code. It stays at the same address for the
+// life of the Jit, so the code addresses it directly.
+
+struct JitFrame
+{
+  void* Item;  // FOR or WHILE stack item of the loop being run
+  double Tmp;  // value of an expr computed by the VM
+  double Elem[3];  // indexes and value of an array assignment
+  double Spill[JIT_NUM_REGS];  // operand stack saved across a call
+  ForStkItem For[JIT_MAX_FOR];  // FOR loops nested in the loop
+  double While[JIT_MAX_WHILE];  // expr values of nested WHILE loops
+};
+//===========================================
+struct JitBlock  // loop being compiled
+{
+  int End;  // loc of NEXT or WEND of loop
+  int Step;  // label of the NEXT or WEND code
+  int Exit;  // label of the 1st instr after the loop
+};
+//===========================================
+// An index that is a var, or a var plus or minus an int constant, is
+// checked once, before an innermost FOR loop, if the var is the counter
+// of the loop or is not assigned in it. The loop is compiled twice:
+// without those checks, run when they pass for all the values the var
+// takes in the loop, and with them, run otherwise.
+
+struct JitCheck  // bounds check of an index, hoisted out of a loop
+{
+  int Arr;  // array slot
+  int Bound;  // offset in ArrItem of the bound: Size, Rows or Cols
+  int Var;  // index = var + Offset
+  int Offset;
+};
+//===========================================
+struct JitFixup  // jump whose target is not known yet
+{
+  int Pos;  // offset of the rel32 field in code buffer
+  int Label;  // target label
+};
+//===========================================
+class Parser;
+//===========================================
+// Baseline JIT compiler of hot loops.
+// Every FOR ... NEXT and WHILE ... WEND loop counts its passes, and one
+// that reaches JIT_HOT_COUNT is compiled, body and all nested loops,
+// into x86-64 code; from then on the loop runs natively.
+// The vars stay in the VarTable, at a fixed address for the run, so the
+// native code and the executor always see the same values. The exprs are compiled
+// from their optimized bytecode, with the VM operand stack kept in xmm
+// regs. The native code calls back into the executor:
+// - for PRINT, INPUT, RANDOMIZE and PRECISION,
+// - for an expr with RND, or too deep for the xmm regs,
+// - when an op would raise an error (e.g. division by 0); the whole
+//   expr is then run again by the VM, which reports the error,
+// - for the start of a nested FOR loop and the slow NEXT of a double
+//   loop,
+// - for an array assignment with an illegal index, which is reported.
+// The array elements are read and written natively, at an offset from
+// the data of the array. A loop that contains anything else (GOTO,
+// GOSUB, DO, DIM ...) is never compiled. The code of a run is private
+// to its Parser.
+
+class Jit
+{
+public:
+  Jit(Parser* prs, const Program* prog, VarTable* vars, ArrTable* arrs);
+  ~Jit();
+
+  int Run(int loc, int end, bool back_edge, void* item, int for_room,
+    int while_room);
+
+private:
+  // callbacks of the native code
+  static int CallStmt(Parser* prs, int loc);
+  static int CallEval(Parser* prs, int loc, double* res);
+  static int CallFor(Parser* prs, int loc, ForStkItem* item);
+  static int CallNext(Parser* prs, ForStkItem* item);
+  static int CallSetArr(Parser* prs, int loc, double* elem);
+
+  // compiler
+  bool Compile(int loc, int end, JitLoop& loop, void* item);
+  int CompileBlock(int loc, int stop);
+  int CompileIf(int loc, int stop);
+  int CompileFor(int loc, int stop);
+  bool CompileForBody(int block, int end, int b, int base, int disp,
+    int var);
+  int CompileWhile(int loc, int stop);
+  int CompileCall(int loc, int stop);
+  int CompileArr(int loc, int stop);
+  int FindBlock(int end);
+  int GetVar(int loc);
+  bool IsNative(const Instr* ip);
+
+  // hoisted bounds checks
+  int FindChecks(int block, int end, int var);
+  void AddCheck(int arr, int bound, const Instr* start, const Instr* end,
+    int block, int end_loc);
+  int MatchIndex(const Instr* start, const Instr* end, int& var,
+    int& offset);
+  bool IsAssigned(int var, int block, int end);
+  bool IsHoisted(int arr, int bound, const Instr* start, const Instr* end);
+  void EmitGuard(int base, int disp, int var, int fail);
+  void EmitExpr(int loc, int false_label);
+  void EmitOp(const Instr* ip, int& depth);
+  void EmitBranch(OpCode op, int x, int y, int false_label);
+  void EmitSetCmp(OpCode op, int x, int y);
+  void EmitTest(int x, int false_label);
+  void EmitNeg(int x);
+  void EmitCallFunc(void* func, int x, int y);
+  void EmitNext(int base, int disp, int var, int top);
+  void EmitArr(const Instr* ip, int& depth);
+  void EmitElem(int arr, int dims, bool check_i, bool check_j, int fail);
+  void EmitHelper(void* func, int loc, int disp);
+  void EmitLoadItem();
+  int GetSlow();
+
+  // x86-64 encoder
+  void Byte(int b);
+  void Int32(int n);
+  void Int64(long long n);
+  void Rex(bool w, int reg, int base, bool force = false);
+  void RegReg(int reg, int rm);
+  void RegMem(int reg, int base, int disp);
+  void SseRR(int prefix, int op, int reg, int rm);
+  void SseRM(int prefix, int op, int reg, int base, int disp);
+  void SseIdx(int prefix, int op, int reg, int base, int index);
+  void MovImm(int reg, long long n);
+  void SetCC(int cc, int reg);
+  void CvtInt(int x, int reg);
+  void Call(void* func);
+  void Zero();
+  int NewLabel();
+  void Bind(int label);
+  void Jmp(int label);
+  void Jcc(int cc, int label);
+
+  Parser* Prs;  // executor of the run
+  const Program* Prog;  // program run
+  VarTable* Vars;  // var table of the run
+  ArrTable* Arrs;  // array table of the run
+  JitLoop* Loops;  // compile state of loops, indexed by loc of body
+  JitFrame Frame;  // memory of the native code
+
+  unsigned char* Code;  // code buffer, executable when not compiling
+  int CodeLen;  // num of bytes of finished code in Code
+  int Pos;  // offset of next byte emitted
+  bool Failed;  // true = the loop being compiled is refused
+
+  int* Labels;  // offset of every label, -1 = not bound yet
+  int NumLabels;
+  JitFixup* Fixups;  // jumps to labels
+  int NumFixups;
+
+  JitBlock Blocks[JIT_MAX_FOR + JIT_MAX_WHILE];  // loops being compiled
+  int NumBlocks;
+  int NumFor, NumWhile;  // current nesting of FOR and WHILE loops
+  int MaxFor, MaxWhile;  // max nesting of FOR and WHILE loops
+  int Slow;  // label of the VM path of current expr, -1 = none
+  const Instr* ExprCode;  // code of current expr
+  JitCheck Checks[JIT_MAX_CHECKS];  // checks hoisted out of current loop
+  int NumChecks;
+  bool Hoisted;  // true = the code compiled now skips Checks
+  int Abort;  // label of the exit of an aborted run
+};
+//===========================================
+
+#endif
@@ -11,58 +11,81 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <ctype.h>
 #include "Misc.h"
+#include "Output.h"
 #include "Error.h"
 #include "LblTable.h"
 
 //===========================================
-LblTable::LblTable()
+LblTable::LblTable(Context* ctx)
 {
+  Ctx = ctx;
   for (int i = 0; i < NUM_LBLS; i++)
   {
     Array[i].Name[0] = 0;
-    Array[i].Loc = NULL;
+    Array[i].Loc = -1;
     Array[i].Line = 0;
+    Array[i].Next = -1;
   }
 
+  for (int i = 0; i < LBL_HASH_SIZE; i++)
+    HashTbl[i] = -1;
+
   Counter = 0;
 }
 //===========================================
 // Insert label name into the label table.
 
-void LblTable::Insert(const char* name, char* loc, int line)
+void LblTable::Insert(const char* name, int loc, int line)
 {
-  char* lbl_loc;
+  int lbl_loc;
+  unsigned int slot;
 
   if (IsFull())
   {
-    ErrRpt.Error(ecLBL_FULL);  // table is full
+    Ctx->ErrRpt.Error(ecLBL_FULL);  // table is full
     return;
   }
 
   lbl_loc = FindLoc(name);
 
-  if (lbl_loc)
+  if (lbl_loc >= 0)
   {
-    ErrRpt.Error(ecLBL_DUPL);  // duplicate lbl, don't insert
+    Ctx->ErrRpt.Error(ecLBL_DUPL);  // duplicate lbl, don't insert
     return;
   }
 
+  slot = Hash(name);
   strcpy(Array[Counter].Name, name);
   Array[Counter].Loc = loc;
   Array[Counter].Line = line;
+  Array[Counter].Next = HashTbl[slot];  // chain lbl into hash slot
+  HashTbl[slot] = Counter;
   Counter++;
 }
 //===========================================
 // Find location of label name.
 
-char* LblTable::FindLoc(const char* name) const
+int LblTable::FindLoc(const char* name) const
 {
-  for (int i = 0; i < Counter; i++)
+  for (int i = HashTbl[Hash(name)]; i >= 0; i = Array[i].Next)
     if (!stricmp(Array[i].Name, name))
       return Array[i].Loc;
 
-  return NULL;  // no such label
+  return -1;  // no such label
+}
+//===========================================
+// Return the hash slot of label name. Case is ignored.
+
+unsigned int LblTable::Hash(const char* name) const
+{
+  unsigned int h = 0;
+
+  while (*name)
+    h = h * 31 + toupper(*name++);
+
+  return h & (LBL_HASH_SIZE - 1);
 }
 //===========================================
 // Display the label table.
@@ -72,24 +95,24 @@ void LblTable::Display() const
 {
   if (IsEmpty())
   {
-    printf("Label table is empty.\n\n");
+    Ctx->Out.PutStr("Label table is empty.\n\n");
     return;
   }
 
-  DispCh('=', SCR_LINE_WIDTH);
-  printf("\nLabel Table:\n\n");
+  Ctx->Out.PutCh('=', SCR_LINE_WIDTH);
+  Ctx->Out.PutStr("\nLabel Table:\n\n");
 
-  printf("Name   Line      Loc\n");
-  DispCh('-', SCR_LINE_WIDTH);
-  printf("\n");
+  Ctx->Out.PutStr("Name   Line      Loc\n");
+  Ctx->Out.PutCh('-', SCR_LINE_WIDTH);
+  Ctx->Out.PutCh('\n');
 
   for (int i = 0; i < Counter; i++)
-    printf("%s     %4d      0x%p\n", Array[i].Name, Array[i].Line,
+    Ctx->Out.Printf("%s     %4d      %d\n", Array[i].Name, Array[i].Line,
      Array[i].Loc);
 
-  DispCh('-', SCR_LINE_WIDTH);
-  printf("\n\nLabels = %d\n", Counter);
-  DispCh('=', SCR_LINE_WIDTH);
-  DispCh('\n', 2);
+  Ctx->Out.PutCh('-', SCR_LINE_WIDTH);
+  Ctx->Out.Printf("\n\nLabels = %d\n", Counter);
+  Ctx->Out.PutCh('=', SCR_LINE_WIDTH);
+  Ctx->Out.PutCh('\n', 2);
 }
 //===========================================
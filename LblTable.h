@@ -12,33 +12,43 @@
 #ifndef LBL_TABLE_H
 #define LBL_TABLE_H
 
+#include "Context.h"
+
 //===========================================
 const int NUM_LBLS = 512;  // max num of lbls
 const int LBL_NAME_LEN = 64;  // max lbl name len = TOK_STR_LEN
+const int LBL_HASH_SIZE = 1024;  // num of hash slots, a power of 2
 //===========================================
 struct LblTblItem  // item of label table
 {
   char Name[LBL_NAME_LEN+1];  // lbl name
-  char* Loc;  // loc of lbl in source
+  int Loc;  // loc of lbl in token array
   int Line;  // line num of lbl in source
+  int Next;  // next lbl in same hash slot, -1 = none
 };
 //===========================================
 class LblTable  // label table
 {
 public:
-  LblTable();
+  LblTable(Context* ctx);
 
   bool IsEmpty() const  { return Counter == 0; }
   bool IsFull() const  { return Counter == NUM_LBLS; }
+  int GetNumLbls() const  { return Counter; }
+  const LblTblItem* GetLbls() const  { return Array; }
 
-  void Insert(const char* name, char* loc, int line);
-  char* FindLoc(const char* name) const;
+  void Insert(const char* name, int loc, int line);
+  int FindLoc(const char* name) const;
 
   void Display() const;
 
 private:
+  unsigned int Hash(const char* name) const;
+
   LblTblItem Array[NUM_LBLS];  // actual lbl table
+  int HashTbl[LBL_HASH_SIZE];  // 1st lbl in hash slot, -1 = none
   int Counter;  // num of lbls in table
+  Context* Ctx;  // state of the interpreter run
 };
 //===========================================
 
@@ -10,13 +10,12 @@
 //===========================================
 
 #include <stdio.h>
-#include <conio.h>
+#include <string.h>
+#include <math.h>
+#include <charconv>
 #include "Misc.h"
+#include "Output.h"
 
-//===========================================
-// *** GLOBAL VAR ***
-
-int Line;  // current line num in source
 //===========================================
 // Round-off a double num to the nearest int.
 // e.g.:
@@ -73,86 +72,111 @@ bool IsInt(double num)
   return num == double(int(num));
 }
 //===========================================
-// Display a char count times.
+// Return true if num is an integer that a double holds exactly,
+// i.e. |num| <= 2^53. Such nums can be counted in int64 with the
+// same results as in double.
 
-void DispCh(char ch, int count)
+bool IsExactInt(double num)
 {
-  while (count)
-  {
-    _putch(ch);
-    count--;
-  }
+  const double MAX_EXACT = 9007199254740992.0;  // 2^53
+
+  return num >= -MAX_EXACT && num <= MAX_EXACT &&
+    num == double((long long)num);
 }
 //===========================================
-// Display a logical value as TRUE or FALSE.
+// Display a logical value as TRUE or FALSE on out.
 
-void DispLogValue(double value)
+void DispLogValue(Output& out, double value)
 {
-  value ? printf("TRUE") : printf("FALSE");
+  value ? out.PutStr("TRUE") : out.PutStr("FALSE");
 }
 //===========================================
-// Display a double num with the given precision ndp.
-// ndp = number of decimal places.
-// Must be 0 <= ndp <= 6.
+// Display a double num on out with the given precision ndp.
+// ndp = number of decimal places, any ndp >= 0.
+// num is converted to the shortest decimal str that reads back as
+// num, and that str is rounded half away from zero to ndp places.
+// So 2.8 -> 2.80 and 2.675 -> 2.68, as written in the source.
 
-void DispFloat(double num, int ndp)
+void DispFloat(Output& out, double num, int ndp)
 {
-  int i, ip;  // ip = integer part
-  double fp;  // fp = fractional part
-
-  if (ndp > 6)
-    ndp = 6;  // max precision possible
-
-  if (num == 0.0)
+  // 1 carry digit + up to 309 int digits + . + up to 324 fract digits
+  char str[FLOAT_STR_LEN];
+  char* dp;  // ptr to decimal point, or to end if none
+  char* end;  // ptr past the last digit
+  char *p, *q;
+  int nfd;  // num of fract digits kept
+  bool is_neg;
+
+  if (ndp < 0)
+    ndp = 0;
+
+  if (isnan(num))
   {
-    printf("0");
-
-    if (ndp == 0)
-      return;
-
-    printf(".");
-
-    for (i = 0; i < ndp; i++)
-      printf("0");
-
+    out.PutStr("NAN");
     return;
   }
 
-  if (num < 0.0)
+  is_neg = signbit(num);
+  num = fabs(num);
+
+  if (isinf(num))
   {
-    printf("-");
-    num = -num;
+    out.PutStr(is_neg ? "-INF" : "INF");
+    return;
   }
 
-  for (i = 0; i < ndp; i++)
-    num *= 10;
+  str[0] = '0';  // room for a carry out of the int part
+  end = std::to_chars(str + 1, str + FLOAT_STR_LEN, num,
+    std::chars_format::fixed).ptr;
+  dp = (char*) memchr(str + 1, '.', end - (str + 1));
 
-  num = double(int(num + 0.5));
+  if (dp == NULL)
+    dp = end;
 
-  for (i = 0; i < ndp; i++)
-    num /= 10;
+  nfd = int(end - dp) - 1;
 
-  ip = int(num);
-  fp = num - double(ip);
-  printf("%d", ip);
+  if (nfd > ndp)  // too many fract digits, so round off
+  {
+    if (dp[ndp+1] >= '5')
+      for (p = dp + ndp; ; p--)
+      {
+        if (*p == '.')
+          continue;
+
+        if (*p != '9')
+        {
+          (*p)++;
+          break;
+        }
+
+        *p = '0';  // carry to the next digit on the left
+      }
+
+    nfd = ndp;
+  }
+  else if (nfd < 0)
+    nfd = 0;
 
-  if (ndp == 0)
-    return;
+  end = nfd ? dp + 1 + nfd : dp;
+  p = str[0] == '0' ? str + 1 : str;
 
-  printf(".");
+  if (is_neg)  // no sign for a num rounded to 0
+    for (q = p; q < end; q++)
+      if (*q != '0' && *q != '.')
+      {
+        out.PutCh('-');
+        break;
+      }
 
-  if (fp == 0.0)
-  {
-    for (i = 0; i < ndp; i++)
-      printf("0");
+  out.PutStr(p, int(end - p));
 
+  if (ndp == 0)
     return;
-  }
 
-  for (i = 0; i < ndp; i++)
-    fp *= 10;
+  if (nfd == 0)
+    out.PutCh('.');
 
-  printf("%d", int(fp));
+  out.PutCh('0', ndp - nfd);
 }
 //===========================================
 
@@ -12,22 +12,32 @@
 #ifndef MISC_H
 #define MISC_H
 
+//===========================================
+// *** PORTABILITY ***
+
+#ifndef _WIN32
+#include <strings.h>
+#define stricmp strcasecmp
+#define _strnicmp strncasecmp
+#endif
+
 //===========================================
 // *** GLOBAL CONST ***
 
 // Width of separator line displayed on screen
 const int SCR_LINE_WIDTH = 50;
-//===========================================
-// *** GLOBAL VAR ***
 
-extern int Line;  // current line num in source
+// Size of str that holds any double in fixed notation
+const int FLOAT_STR_LEN = 640;
+//===========================================
+class Output;
 //===========================================
 bool IsInt(double num);
+bool IsExactInt(double num);
 int RoundOff(double num);
 int Trunc(double num);
-void DispCh(char ch, int count = 1);
-void DispLogValue(double value);
-void DispFloat(double num, int ndp);
+void DispLogValue(Output& out, double value);
+void DispFloat(Output& out, double num, int ndp);
 //===========================================
 
 #endif
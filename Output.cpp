@@ -0,0 +1,228 @@
+//===========================================
+//
+//  Output.cpp
+//
+// Author: Theo P. (theo_pap@otenet.gr)
+// Language used: C++
+// Copyright: No copyright. You can do with this software whatever
+// you like.
+// Warranty: No warranty. Use this software at your own risk.
+//===========================================
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#ifdef _WIN32
+#include <io.h>
+#define write _write
+#define isatty _isatty
+#else
+#include <unistd.h>
+#endif
+#include "Output.h"
+
+//===========================================
+// Output to a terminal is line-buffered, so the user sees every line
+// as soon as it is complete. Any other output is fully buffered.
+
+Output::Output(int fd)
+{
+  Len = 0;
+  Fd = fd;
+  LineBuf = isatty(fd) != 0;
+  Capture = false;
+  Text = NULL;
+  TextLen = TextSize = 0;
+}
+//===========================================
+// Flush the remaining output.
+
+Output::~Output()
+{
+  Flush();
+  delete [] Text;
+  Text = NULL;
+}
+//===========================================
+// Write to file descriptor fd from now on.
+
+void Output::SetFd(int fd)
+{
+  Flush();
+  Fd = fd;
+  LineBuf = isatty(fd) != 0;
+  Capture = false;
+}
+//===========================================
+// Keep the output in memory from now on.
+
+void Output::SetCapture()
+{
+  Flush();
+  Capture = true;
+  LineBuf = false;
+}
+//===========================================
+// Return the captured output and its len in len.
+// The caller owns the returned array and must delete [] it.
+// The array is NUL-terminated, and is NULL if nothing was captured.
+
+char* Output::ReleaseText(int& len)
+{
+  char* text;
+
+  Flush();
+  text = Text;
+  len = TextLen;
+  Text = NULL;
+  TextLen = TextSize = 0;
+  return text;
+}
+//===========================================
+// Write len chars directly to the file descriptor,
+// or append them to Text in capture mode.
+
+void Output::Write(const char* p, int len)
+{
+  char* q;
+  int n;
+
+  if (Capture)
+  {
+    if (TextLen + len >= TextSize)  // Text is full, so grow it
+    {
+      n = TextSize ? 2 * TextSize : OUT_BUF_SIZE;
+
+      while (TextLen + len >= n)
+        n *= 2;
+
+      q = new char [n];
+
+      if (q == NULL)  // out of memory, so drop the output
+        return;
+
+      if (TextLen)
+        memcpy(q, Text, TextLen);
+
+      delete [] Text;
+      Text = q;
+      TextSize = n;
+    }
+
+    memcpy(Text + TextLen, p, len);
+    TextLen += len;
+    Text[TextLen] = '\0';
+    return;
+  }
+
+  while (len > 0)
+  {
+    n = write(Fd, p, len);
+
+    if (n < 0 && errno == EINTR)  // interrupted by a signal, so retry
+      continue;
+
+    if (n <= 0)  // write error, so drop the output
+      return;
+
+    p += n;
+    len -= n;
+  }
+}
+//===========================================
+// Write the buffer contents to the file descriptor.
+
+void Output::Flush()
+{
+  if (Len)
+    Write(Buf, Len);
+
+  Len = 0;
+}
+//===========================================
+// Output a char count times.
+
+void Output::PutCh(char ch, int count)
+{
+  while (count)
+  {
+    PutCh(ch);
+    count--;
+  }
+}
+//===========================================
+// Output a NUL-terminated str.
+
+void Output::PutStr(const char* s)
+{
+  PutStr(s, strlen(s));
+}
+//===========================================
+// Output len chars of str s.
+// A str that does not fit in the buffer is written directly.
+
+void Output::PutStr(const char* s, int len)
+{
+  if (Len + len > OUT_BUF_SIZE)
+  {
+    Flush();
+
+    if (len > OUT_BUF_SIZE)
+    {
+      Write(s, len);
+      return;
+    }
+  }
+
+  memcpy(Buf + Len, s, len);
+  Len += len;
+
+  if (LineBuf && memchr(s, '\n', len) != NULL)
+    Flush();
+}
+//===========================================
+// Output an int in decimal.
+
+void Output::PutInt(long long num)
+{
+  char str[24];  // digits are stored backwards
+  int i = 0;
+  unsigned long long n = num < 0 ? 0ULL - num : num;
+
+  do
+  {
+    str[i++] = char('0' + n % 10);
+    n /= 10;
+  }
+  while (n);
+
+  if (num < 0)
+    PutCh('-');
+
+  while (i)
+    PutCh(str[--i]);
+}
+//===========================================
+// Output a printf-style formatted str.
+// Used for messages, not for the output of PRINT.
+
+void Output::Printf(const char* fmt, ...)
+{
+  char str[OUT_FMT_LEN];
+  va_list args;
+  int len;
+
+  va_start(args, fmt);
+  len = vsnprintf(str, OUT_FMT_LEN, fmt, args);
+  va_end(args);
+
+  if (len < 0)
+    return;
+
+  if (len >= OUT_FMT_LEN)
+    len = OUT_FMT_LEN - 1;
+
+  PutStr(str, len);
+}
+//===========================================
@@ -0,0 +1,74 @@
+//===========================================
+//
+//  Output.h
+//
+// Author: Theo P. (theo_pap@otenet.gr)
+// Language used: C++
+// Copyright: No copyright. You can do with this software whatever
+// you like.
+// Warranty: No warranty. Use this software at your own risk.
+//===========================================
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+//===========================================
+const int OUT_BUF_SIZE = 65536;  // size of output buffer
+const int OUT_FMT_LEN = 1024;  // max len of a formatted str
+//===========================================
+// Buffered writer to a file descriptor.
+// All the program output goes through an Output object, so it is
+// written with a few large system calls instead of one libc call per
+// char or item. The buffer is flushed when it is full, on Flush(),
+// and at every EOL in line-buffered mode.
+// In capture mode the output is kept in memory instead, and the caller
+// takes it with ReleaseText().
+
+class Output
+{
+public:
+  Output(int fd = 1);
+  ~Output();
+
+  void SetFd(int fd);
+  void SetLineBuf(bool on)  { LineBuf = on; }
+  bool IsLineBuf() const  { return LineBuf; }
+  void SetCapture();
+  char* ReleaseText(int& len);
+
+  void PutCh(char ch);
+  void PutCh(char ch, int count);
+  void PutStr(const char* s);
+  void PutStr(const char* s, int len);
+  void PutInt(long long num);
+  void Printf(const char* fmt, ...);
+
+  void Flush();
+
+private:
+  void Write(const char* p, int len);
+
+  char Buf[OUT_BUF_SIZE];  // output buffer
+  int Len;  // num of chars in buffer
+  int Fd;  // file descriptor written to
+  bool LineBuf;  // true = flush at every EOL
+
+  bool Capture;  // true = keep the output in Text
+  char* Text;  // captured output
+  int TextLen;  // num of chars in Text
+  int TextSize;  // allocated size of Text
+};
+//===========================================
+inline void Output::PutCh(char ch)
+{
+  if (Len == OUT_BUF_SIZE)
+    Flush();
+
+  Buf[Len++] = ch;
+
+  if (ch == '\n' && LineBuf)
+    Flush();
+}
+//===========================================
+
+#endif
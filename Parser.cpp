@@ -7,21 +7,6 @@
 // Copyright: No copyright. You can do with this software whatever
 // you like.
 // Warranty: No warranty. Use this software at your own risk.
-//
-// Precedence Table
-// ------------------------------------------------
-// op                     level  func
-// ------------------------------------------------
-// num  var  func       8   EvalFactor()
-// ( )                        7   EvalPar()
-// un+ un-                6   EvalUnPlusMinus()
-// NOT                     5   EvalNot()
-// * / %                   4   EvalMultDivMod()
-// + -                      3   EvalAddSub()
-// < <= > >= = <>  2   EvalComp()
-// AND                     1   EvalAnd()
-// OR                       0   EvalOr()
-// ------------------------------------------------
 //===========================================
 
 #include <stdlib.h>
@@ -29,55 +14,63 @@
 #include <math.h>
 #include "Error.h"
 #include "Misc.h"
+#include "Output.h"
 #include "Parser.h"
 
 //===========================================
-Parser::Parser()
+Parser::Parser(const Program& prog) : Rdr(&Ctx, &prog),
+  GosubStk(&Ctx, ecGOSUB_FULL, ecGOSUB_EMPTY, ecGOSUB_EMPTY, INVALID_GOSUB),
+  ForStk(&Ctx, ecFOR_FULL, ecFOR_EMPTY, ecFOR_EMPTY2, INVALID_FOR),
+  WhileStk(&Ctx, ecWHILE_FULL, ecWHILE_EMPTY, ecWHILE_EMPTY2, INVALID_WHILE),
+  DoStk(&Ctx, ecDO_FULL, ecDO_EMPTY, ecDO_EMPTY, INVALID_DO), VarTbl(&Ctx),
+  ArrTbl(&Ctx), Prf(&Ctx), Jt(this, &prog, &VarTbl, &ArrTbl)
 {
+  Prog = &prog;
+  NumPool = NULL;
   Precision = 0;  // by default, all numbers displayed as integers
   DebMode = false;  // by default, no debug info displayed
+  ProfMode = false;
+  JitMode = true;  // by default, hot loops run as native code
+  JitOn = false;
 }
 //===========================================
-// Initialize the parser. Load the source file fname.
+// Turn profile mode on/off. Must be set before Execute().
 
-void Parser::Init(const char* fname)
+void Parser::SetProfile(bool on)
 {
-  Scn.Init(fname);
+  ProfMode = on;
 }
 //===========================================
-// Display the source file.
+// Display the profile report of the last run and save it to file
+// fname, in CSV format.
 
-void Parser::DispSource()
+void Parser::DispProfile(const char* fname)
 {
-  Scn.DispSource();
-}
-//===========================================
-// Display all the tokens.
+  Output rpt(2);  // stderr
 
-void Parser::DispTokens()
-{
-  Scn.DispTokens();
+  Prf.Report(fname);
+  rpt.Printf("Max stack depth: GOSUB = %d, FOR = %d, WHILE = %d, ",
+    GosubStk.GetHighWater(), ForStk.GetHighWater(),
+    WhileStk.GetHighWater());
+  rpt.Printf("DO = %d\n\n", DoStk.GetHighWater());
 }
 //===========================================
-// Display label table.
+// Set the max num of items of each of the GOSUB, FOR, WHILE and DO
+// stacks. Must be set before Execute().
 
-void Parser::DispLblTbl()
+void Parser::SetStackLimit(int limit)
 {
-  Scn.DispLblTbl();
+  GosubStk.SetLimit(limit);
+  ForStk.SetLimit(limit);
+  WhileStk.SetLimit(limit);
+  DoStk.SetLimit(limit);
 }
 //===========================================
 // Find token str corresponding to token tok.
 
 const char* Parser::FindTokStr(TokCode tok)
 {
-  return Scn.FindTokStr(tok);
-}
-//===========================================
-// Find token corresponding to token string str.
-
-TokCode Parser::FindToken(const char* str)
-{
-  return Scn.FindToken(str);
+  return Prog->FindTokStr(tok);
 }
 //===========================================
 // Return true if token tok is a relational op, i.e. one of:
@@ -90,6 +83,7 @@ bool Parser::IsRelOp(TokCode tok)
 //===========================================
 // Compare numbers opnd1 and opnd2 using relational operator op.
 
+template <bool Trace>
 bool Parser::Compare(TokCode op, double opnd1, double opnd2)
 {
   bool res;
@@ -102,916 +96,776 @@ bool Parser::Compare(TokCode op, double opnd1, double opnd2)
     case tcGE: res = opnd1 >= opnd2; break;  // >=
     case tcEQ: res = opnd1 == opnd2; break;  // =
     case tcNE: res = opnd1 != opnd2; break;  // <>
+    default: res = false; break;  // not a relational op
   }
 
-  if (DebMode)
-  {
-    DispFloat(opnd1, Precision);
-    printf(" ");
-    printf(FindTokStr(op));
-    printf(" ");
-    DispFloat(opnd2, Precision);
-    printf(" = ");
-    DispLogValue(res);
-    printf("\n");
-  }
+  if (Trace)
+    DispCompOp(op, opnd1, opnd2, res);
 
   return res;
 }
 //===========================================
-// Skip tokens until tok is reached.
+// Skip a block: go to the token at loc, i.e. the end of the block as
+// found by the block table at load time.
 
-void Parser::SkipUntilToken(TokCode tok)
+void Parser::SkipTo(int loc)
 {
-  TokCode t;
-
-  do
-  {
-    t = Scn.ReadToken();
-  } while (t != tok && t != tcEND && t != tcEOF);
-}
-//===========================================
-// Skip tokens until either tok1 or tok2 is reached.
-
-void Parser::SkipUntilToken2(TokCode tok1, TokCode tok2)
-{
-  TokCode t;
-
-  do
-  {
-    t = Scn.ReadToken();
-  } while (t != tok1 && t != tok2 && t != tcEND && t != tcEOF);
-}
-//===========================================
-// Skip tokens until either tok1, tok2 or tok3 is reached.
-
-void Parser::SkipUntilToken3(TokCode tok1, TokCode tok2,
-  TokCode tok3)
-{
-  TokCode t;
-
-  do
-  {
-    t = Scn.ReadToken();
-  } while (t != tok1 && t != tok2 && t != tok3 && t != tcEND &&
-       t != tcEOF);
+  Rdr.SetPos(loc);
+  Rdr.ReadToken();
 }
 //===========================================
 // *** EXPR CALCULATOR ***
 //===========================================
 // Entry point to expr calculator.
 //
-// Evaluate an expression.
+// Evaluate the expression beginning at the current token.
 // An expression can contain arithmetic, logical and comparison ops.
+// All the exprs were compiled into bytecode at load time, so here we
+// only run the code and then go to the 1st token after the expr.
 
+template <bool Trace>
 double Parser::EvalExpr()
 {
+  const ExprTblItem& e = Prog->GetExpr(Rdr.GetCur());
   double res;
 
-  EvalOr();  // start from bottom, i.e. from level 0
-  res = Stk.Pop();  // get the result from stack
-  return res;
-}
-//===========================================
-// level 0
-// OR
-// res = opnd1 OR opnd2
-
-void Parser::EvalOr()
-{
-  TokCode op;
-  double opnd1, opnd2, res;
-
-  EvalAnd();
-
-  while ((op = Scn.GetToken()) == tcOR)
+  if (e.Code < 0)  // no compiled expr at this loc
   {
-    Scn.ReadToken();
-    EvalAnd();
-    opnd2 = Stk.Pop();
-    opnd1 = Stk.Pop();
-    res = opnd1 || opnd2;
-    Stk.Push(res);
-
-    if (DebMode)
-    {
-      DispLogValue(opnd1);
-      printf(" OR ");
-      DispLogValue(opnd2);
-      printf(" = ");
-      DispLogValue(res);
-      printf("\n");
-    }
+    Ctx.ErrRpt.Error(ecEXPR_MISSING);
+    Rdr.ReadToken();  // skip the token, so the caller moves on
+    return 0.0;
   }
-}
-//===========================================
-// level 1
-// AND
-// res = opnd1 AND opnd2
-
-void Parser::EvalAnd()
-{
-  TokCode op;
-  double opnd1, opnd2, res;
 
-  EvalComp();
-
-  while ((op = Scn.GetToken()) == tcAND)
-  {
-    Scn.ReadToken();
-    EvalComp();
-    opnd2 = Stk.Pop();
-    opnd1 = Stk.Pop();
-    res = opnd1 && opnd2;
-    Stk.Push(res);
-
-    if (DebMode)
-    {
-      DispLogValue(opnd1);
-      printf(" AND ");
-      DispLogValue(opnd2);
-      printf(" = ");
-      DispLogValue(res);
-      printf("\n");
-    }
-  }
+  // the trace displays every op as written, so it runs the unoptimized
+  // code
+  res = RunCode<Trace>(Prog->GetCode() + (Trace ? e.Code : e.Opt));
+  Rdr.SetPos(e.End);
+  Rdr.ReadToken();
+  return res;
 }
 //===========================================
-// level 2
-// Comparison
-// res = opnd1 op opnd2
-// op = rel op, one of:  < <= > >= = <>.
+// Bytecode VM.
+// Run the expr code beginning at instr ip and return the expr value.
+// The compiler has checked that the expr fits in the operand stack,
+// so there are no bounds checks here.
 
-void Parser::EvalComp()
+template <bool Trace>
+double Parser::RunCode(const Instr* ip)
 {
-  TokCode op;
+  double stk[MAX_STACK];  // operand stack
+  double* sp = stk;  // 1st free item of operand stack
   double opnd1, opnd2, res;
 
-  EvalAddSub();
-  op = Scn.GetToken();
-
-  if (!IsRelOp(op))  // not a rel op, so do nothing
-    return;
-
-  Scn.ReadToken();
-  EvalAddSub();
-  opnd2 = Stk.Pop();
-  opnd1 = Stk.Pop();
-  res = Compare(op, opnd1, opnd2);
-  Stk.Push(res);
-}
-//===========================================
-// level 3
-// Add/Subtract
-// res = opnd1 op opnd2
-// op =  + -
-
-void Parser::EvalAddSub()
-{
-  TokCode op;
-  double opnd1, opnd2, res;
-	
-  EvalMultDivMod();
-	
-  while ((op = Scn.GetToken()) == tcPLUS || op == tcMINUS)
+  for (;; ip++)
   {
-    Scn.ReadToken();
-    EvalMultDivMod();
-    opnd2 = Stk.Pop();
-    opnd1 = Stk.Pop();
-		
-    switch (op)
+    switch (ip->Op)
     {
-      case tcPLUS:
-        res = opnd1 + opnd2;
+      case opNUM:
+        *sp++ = NumPool[ip->Arg].Value;
         break;
 
-      case tcMINUS:
-        res = opnd1 - opnd2;
+      case opVAR:
+        *sp++ = VarTbl.Get(ip->Arg);
         break;
-    }
 
-    Stk.Push(res);
+      // opnd1 OR opnd2, opnd1 AND opnd2
+      case opOR:
+      case opAND:
+        opnd2 = *--sp;
+        opnd1 = sp[-1];
+        res = (ip->Op == opOR) ? (opnd1 || opnd2) : (opnd1 && opnd2);
+        sp[-1] = res;
 
-    if (DebMode)
-    {
-      DispFloat(opnd1, Precision);
-      printf(" %s ", FindTokStr(op));
-      DispFloat(opnd2, Precision);
-      printf(" = ");
-      DispFloat(res, Precision);
-      printf("\n");
-    }
-  }
-}
-//===========================================
-// level 4
-// Multiply/Divide/Modulus
-// res = opnd1 op opnd2
-// op =  * / %
-// NOTE: The operands of % must be integer.
-
-void Parser::EvalMultDivMod()
-{
-  TokCode op;
-  double opnd1, opnd2, res;
-
-  EvalNot();
-
-  while ((op = Scn.GetToken()) == tcSTAR || op == tcSLASH ||
-    op == tcPERC)
-  {
-    Scn.ReadToken();
-    EvalNot();
-    opnd2 = Stk.Pop();
-    opnd1 = Stk.Pop();
-		
-    switch (op)
-    {
-      case tcSTAR:
-        res = opnd1 * opnd2;
+        if (Trace)
+          DispLogOp(TokCode(ip->Arg), opnd1, opnd2, res);
         break;
 
-      case tcSLASH:
-        if (opnd2 == 0.0)
+      // NOT opnd
+      case opNOT:
+        opnd1 = sp[-1];
+        res = !opnd1;
+        sp[-1] = res;
+
+        if (Trace)
         {
-          ErrRpt.Error(ecDIV_ZERO);  // division by 0 is illegal
-          res = 0.0;
+          Ctx.Out.PutStr("NOT ");
+          DispLogValue(Ctx.Out, opnd1);
+          Ctx.Out.PutStr(" = ");
+          DispLogValue(Ctx.Out, res);
+          Ctx.Out.PutCh('\n');
         }
-        else
-          res = opnd1 / opnd2;
         break;
 
-      case tcPERC:
-        if (!IsInt(opnd1))  // opnd1 must be integer
+      // opnd1 op opnd2, op = rel op
+      case opLT:
+      case opLE:
+      case opGT:
+      case opGE:
+      case opEQ:
+      case opNE:
+        opnd2 = *--sp;
+        opnd1 = sp[-1];
+
+        switch (ip->Op)
         {
-           ErrRpt.Error(ecMOD_OPND_NOT_INT);
-           opnd1 = RoundOff(opnd1);
+          case opLT: res = opnd1 < opnd2; break;
+          case opLE: res = opnd1 <= opnd2; break;
+          case opGT: res = opnd1 > opnd2; break;
+          case opGE: res = opnd1 >= opnd2; break;
+          case opEQ: res = opnd1 == opnd2; break;
+          default: res = opnd1 != opnd2; break;
         }
-        if (!IsInt(opnd2))  // opnd2 must be integer
+
+        sp[-1] = res;
+
+        if (Trace)
+          DispCompOp(TokCode(ip->Arg), opnd1, opnd2, res != 0.0);
+        break;
+
+      // opnd1 op opnd2, op = + - * / %
+      case opADD:
+      case opSUB:
+      case opMUL:
+      case opDIV:
+      case opMOD:
+        opnd2 = *--sp;
+        opnd1 = sp[-1];
+
+        switch (ip->Op)
         {
-           ErrRpt.Error(ecMOD_OPND_NOT_INT);
-           opnd2 = RoundOff(opnd2);
+          case opADD:
+            res = opnd1 + opnd2;
+            break;
+
+          case opSUB:
+            res = opnd1 - opnd2;
+            break;
+
+          case opMUL:
+            res = opnd1 * opnd2;
+            break;
+
+          case opDIV:
+            if (opnd2 == 0.0)
+            {
+              Ctx.ErrRpt.Error(ecDIV_ZERO);  // division by 0 is illegal
+              res = 0.0;
+            }
+            else
+              res = opnd1 / opnd2;
+            break;
+
+          default:  // opMOD
+            if (!IsInt(opnd1))  // opnd1 must be integer
+            {
+              Ctx.ErrRpt.Error(ecMOD_OPND_NOT_INT);
+              opnd1 = RoundOff(opnd1);
+            }
+            if (!IsInt(opnd2))  // opnd2 must be integer
+            {
+              Ctx.ErrRpt.Error(ecMOD_OPND_NOT_INT);
+              opnd2 = RoundOff(opnd2);
+            }
+            if (int(opnd2) == 0)
+            {
+              Ctx.ErrRpt.Error(ecDIV_ZERO);
+              res = 0.0;
+            }
+            else
+              res = double(int(opnd1) % int(opnd2));
+            break;
         }
-        res = double(int(opnd1) % int(opnd2));
-        break;
-    }
 
-    Stk.Push(res);
+        sp[-1] = res;
 
-    if (DebMode)
-    {
-      DispFloat(opnd1, Precision);
-      printf(" %s ", FindTokStr(op));
-      DispFloat(opnd2, Precision);
-      printf(" = ");
-      DispFloat(res, Precision);
-      printf("\n");
-    }
-  }
-}
-//===========================================
-// level 5
-// NOT
-// res = NOT opnd
+        if (Trace)
+          DispArithOp(TokCode(ip->Arg), opnd1, opnd2, res);
+        break;
 
-void Parser::EvalNot()
-{
-  TokCode op;
-  double opnd, res;
+      // op opnd, op = unary + -
+      case opPLUS:
+      case opNEG:
+        opnd1 = sp[-1];
+        res = (ip->Op == opPLUS) ? opnd1 : -opnd1;
+        sp[-1] = res;
 
-  if ((op = Scn.GetToken()) == tcNOT)
-    Scn.ReadToken();
+        if (Trace)
+        {
+          Ctx.Out.Printf("%s(", FindTokStr(TokCode(ip->Arg)));
+          DispFloat(Ctx.Out, opnd1, Precision);
+          Ctx.Out.PutStr(") = ");
+          DispFloat(Ctx.Out, res, Precision);
+          Ctx.Out.PutCh('\n');
+        }
+        break;
 
-  EvalUnPlusMinus();
+      case opLPAR:
+        if (Trace)
+          Ctx.Out.PutStr("(\n");
+        break;
 
-  if (op == tcNOT)
-  {
-    opnd = Stk.Pop();
-    res = !opnd;
-    Stk.Push(res);
+      case opRPAR:
+        if (Trace)
+          Ctx.Out.PutStr(")\n");
+        break;
 
-    if (DebMode)
-    {
-      printf("NOT ");
-      DispLogValue(opnd);
-      printf(" = ");
-      DispLogValue(res);
-      printf("\n");
-    }
-  }
-}
-//===========================================
-// level 6
-// Unary + -
-// res = op opnd
-// op =  + -
+      // ABS(x)
+      case opABS:
+        opnd1 = sp[-1];
+        res = (opnd1 < 0.0) ? -opnd1 : opnd1;
+        sp[-1] = res;
 
-void Parser::EvalUnPlusMinus()
-{
-  TokCode op;
-  double opnd, res;
+        if (Trace)
+          DispFunc(tcABS, opnd1, res);
+        break;
 
-  if ((op = Scn.GetToken()) == tcPLUS || op == tcMINUS)
-    Scn.ReadToken();
+      // SGN(x)
+      case opSGN:
+        opnd1 = sp[-1];
 
-  EvalPar();
+        if (opnd1 < 0.0)
+          res = -1.0;
+        else if (opnd1 > 0.0)
+          res = 1.0;
+        else
+          res = 0.0;
 
-  if (op == tcPLUS || op == tcMINUS)
-  {
-    opnd = Stk.Pop();
-    res = (op == tcPLUS) ? opnd : -opnd;
-    Stk.Push(res);  
+        sp[-1] = res;
 
-    if (DebMode)
-    {
-      printf("%s(", FindTokStr(op));
-      DispFloat(opnd, Precision);
-      printf(") = ");
-      DispFloat(res, Precision);
-      printf("\n");
-    }
-  }
-}
-//===========================================
-// level 7
-// Parentheses
-// ( )
+        if (Trace)
+          DispFunc(tcSGN, opnd1, res);
+        break;
 
-void Parser::EvalPar()
-{
-  if (Scn.GetToken() != tcLPAR)  // no parenthesis, so do nothing
-  {
-    EvalFactor();
-    return;
-  }
+      // CINT(x)
+      // Round-off a double to the nearest int. CINT = Convert to INT.
+      case opCINT:
+        opnd1 = sp[-1];
+        res = double(RoundOff(opnd1));
+        sp[-1] = res;
 
-  if (DebMode)
-    printf("(\n");
+        if (Trace)
+          DispFunc(tcCINT, opnd1, res);
+        break;
 
-  Scn.ReadToken();
-  EvalOr();
+      // FIX(x)
+      // Truncate a double to the smallest int.
+      case opFIX:
+        opnd1 = sp[-1];
+        res = double(Trunc(opnd1));
+        sp[-1] = res;
 
-  if (Scn.GetToken() != tcRPAR)
-   ErrRpt.Error(ecRPAR_MISSING); 
-  else
-    if (DebMode)
-      printf(")\n");
+        if (Trace)
+          DispFunc(tcFIX, opnd1, res);
+        break;
 
-  Scn.ReadToken();
-}
-//===========================================
-// level 8
-// Factor
-// num  var  func()
+      // SQR(x)
+      // Must be x >= 0.
+      case opSQR:
+        opnd1 = sp[-1];
 
-void Parser::EvalFactor()
-{
-  double res;
-	
-  switch (Scn.GetToken())
-  {
-    case tcNUM:
-      res = atof(Scn.GetTokStr());
-      Stk.Push(res);
-      Scn.ReadToken();
-      break;
+        if (opnd1 < 0.0)
+        {
+          Ctx.ErrRpt.Error(ecSQR_ARG_NEG);
+          sp[-1] = 0.0;
+          break;
+        }
 
-    case tcVAR:
-      res = VarTbl.Get(Scn.GetTokStr()[0]);
-      Stk.Push(res);
-      Scn.ReadToken();
-      break;
+        res = sqrt(opnd1);
+        sp[-1] = res;
 
-    case tcABS: res = EvalAbs(); Stk.Push(res); break;
-    case tcSGN: res = EvalSgn(); Stk.Push(res); break;
-    case tcCINT: res = EvalCInt(); Stk.Push(res); break;
-    case tcFIX: res = EvalFix(); Stk.Push(res); break;
-    case tcSQR: res = EvalSqr(); Stk.Push(res); break;
-    case tcPOW: res = EvalPow(); Stk.Push(res); break;
-    case tcEXP: res = EvalExp(); Stk.Push(res); break;
-    case tcLOG: res = EvalLog(); Stk.Push(res); break;
-    case tcRND: res = EvalRnd(); Stk.Push(res); break;
+        if (Trace)
+          DispFunc(tcSQR, opnd1, res);
+        break;
 
-    default:
-      ErrRpt.Error(ecUNEXP_TOKEN, Scn.GetTokStr());
-      res = 0.0;
-      Stk.Push(res);
-      Scn.ReadToken();
-      break;
-  }
-}
-//===========================================
-// *** BUILT-IN FUNCS ***
-//===========================================
-// ABS function
-// y = ABS(x)
+      // POW(b, n) = b^n. n must be integer >= 0.
+      case opPOW:
+        opnd2 = *--sp;  // n
+        opnd1 = sp[-1];  // b
 
-double Parser::EvalAbs()
-{
-  double x, y;
+        if (opnd2 < 0.0)
+        {
+          Ctx.ErrRpt.Error(ecEXP_NEG);
+          sp[-1] = 0.0;
+          break;
+        }
 
-  Scn.ReadToken();  // read (
+        if (!IsInt(opnd2))
+        {
+          Ctx.ErrRpt.Error(ecEXP_NOT_INT);
+          opnd2 = RoundOff(opnd2);
+        }
 
-  if (Scn.GetToken() != tcLPAR)
-  {
-    ErrRpt.Error(ecLPAR_MISSING);
-    return 0.0;
-  }
+        res = pow(opnd1, opnd2);
+        sp[-1] = res;
 
-  Scn.ReadToken();  // read x
-  x = EvalExpr();
+        if (Trace)
+        {
+          Ctx.Out.PutStr("POW(");
+          DispFloat(Ctx.Out, opnd1, Precision);
+          Ctx.Out.PutStr(", ");
+          DispFloat(Ctx.Out, opnd2, 0);  // n is integer
+          Ctx.Out.PutStr(") = ");
+          DispFloat(Ctx.Out, res, Precision);
+          Ctx.Out.PutCh('\n');
+        }
+        break;
 
-  if (Scn.GetToken() != tcRPAR)
-  {
-    ErrRpt.Error(ecRPAR_MISSING);
-    return 0.0;
-  }
+      // EXP(x) = e^x
+      case opEXP:
+        opnd1 = sp[-1];
+        res = exp(opnd1);
+        sp[-1] = res;
 
-  Scn.ReadToken();
-  y = (x < 0.0) ? -x : x;
+        if (Trace)
+          DispFunc(tcEXP, opnd1, res);
+        break;
 
-  if (DebMode)
-  {
-    printf("ABS(");
-    DispFloat(x, Precision);
-    printf(") = ");
-    DispFloat(y, Precision);
-    printf("\n");
-  }
+      // LOG(x) = ln(x) = natural logarithm of x. Must be x > 0.
+      case opLOG:
+        opnd1 = sp[-1];
 
-  return y;
-}
-//===========================================
-// SGN function
-// y = SGN(x)
+        if (opnd1 <= 0.0)
+        {
+          Ctx.ErrRpt.Error(ecLOG_ARG_NEG);
+          sp[-1] = 0.0;
+          break;
+        }
 
-double Parser::EvalSgn()
-{
-  double x, y;
+        res = log(opnd1);
+        sp[-1] = res;
 
-  Scn.ReadToken();  // read (
+        if (Trace)
+          DispFunc(tcLOG, opnd1, res);
+        break;
 
-  if (Scn.GetToken() != tcLPAR)
-  {
-    ErrRpt.Error(ecLPAR_MISSING);
-    return 0.0;
-  }
+      // RND(a, b)
+      // Return a pseudo-random r in the range: a <= r <= b.
+      // Must be: a, b = unsigned int, a < b.
+      case opRND:
+        opnd2 = *--sp;  // b
+        opnd1 = sp[-1];  // a
+        sp[-1] = 0.0;
 
-  Scn.ReadToken();  // read x
-  x = EvalExpr();
+        if (opnd1 < 0.0 || opnd2 < 0.0)
+        {
+          Ctx.ErrRpt.Error(ecRND_ARG_NEG);
+          break;
+        }
 
-  if (Scn.GetToken() != tcRPAR)
-  {
-    ErrRpt.Error(ecRPAR_MISSING);
-    return 0.0;
-  }
+        if (!IsInt(opnd1))
+        {
+          Ctx.ErrRpt.Error(ecRND_ARG_INT);
+          opnd1 = RoundOff(opnd1);
+        }
 
-  Scn.ReadToken();
+        if (!IsInt(opnd2))
+        {
+          Ctx.ErrRpt.Error(ecRND_ARG_INT);
+          opnd2 = RoundOff(opnd2);
+        }
 
-  if (x < 0.0)
-    y = -1.0;
-  else if (x > 0.0)
-    y = 1.0;
-  else
-    y = 0.0;
+        if (opnd1 >= opnd2)
+        {
+          Ctx.ErrRpt.Error(ecRND_WRONG_ARG);
+          break;
+        }
 
-  if (DebMode)
-  {
-    printf("SGN(");
-    DispFloat(x, Precision);
-    printf(") = ");
-    DispFloat(y, Precision);
-    printf("\n");
-  }
+        res = double(int(double(Ctx.Rand()) / RND_MAX * (opnd2 - opnd1) +
+          opnd1 + 0.5));
+        sp[-1] = res;
 
-  return y;
-}
-//===========================================
-// CINT function
-// Roun-off a double to the nearest int. CINT = Convert to INT.
-// y = CINT(x)
+        if (Trace)
+        {
+          Ctx.Out.PutStr("RND(");
+          DispFloat(Ctx.Out, opnd1, 0);
+          Ctx.Out.PutStr(", ");
+          DispFloat(Ctx.Out, opnd2, 0);
+          Ctx.Out.PutStr(") = ");
+          DispFloat(Ctx.Out, res, 0);
+          Ctx.Out.PutCh('\n');
+        }
+        break;
 
-double Parser::EvalCInt()
-{
-  double x, y;
+      // A(i)
+      case opARR1:
+        opnd1 = sp[-1];
+        res = ArrTbl.Get(ip->Arg, opnd1);
+        sp[-1] = res;
 
-  Scn.ReadToken();  // read (
+        if (Trace)
+          DispArr(ip->Arg, 1, opnd1, 0.0, res);
+        break;
 
-  if (Scn.GetToken() != tcLPAR)
-  {
-    ErrRpt.Error(ecLPAR_MISSING);
-    return 0.0;
-  }
+      // A(i, j)
+      case opARR2:
+        opnd2 = *--sp;
+        opnd1 = sp[-1];
+        res = ArrTbl.Get(ip->Arg, opnd1, opnd2);
+        sp[-1] = res;
 
-  Scn.ReadToken();  // read x
-  x = EvalExpr();
+        if (Trace)
+          DispArr(ip->Arg, 2, opnd1, opnd2, res);
+        break;
 
-  if (Scn.GetToken() != tcRPAR)
-  {
-    ErrRpt.Error(ecRPAR_MISSING);
-    return 0.0;
-  }
+      // array name as an arg of SUM, DOT, MIN, MAX
+      case opREF:
+        *sp++ = double(ip->Arg);
+        break;
 
-  Scn.ReadToken();
-  y = double(RoundOff(x));
+      // SUM(A)
+      case opSUM:
+        opnd1 = sp[-1];
+        res = ArrTbl.Sum(int(opnd1));
+        sp[-1] = res;
 
-  if (DebMode)
-  {
-    printf("CINT(");
-    DispFloat(x, Precision);
-    printf(") = ");
-    DispFloat(y, Precision);
-    printf("\n");
-  }
+        if (Trace)
+          DispVec(tcSUM, int(opnd1), -1, res);
+        break;
 
-  return y;
-}
-//===========================================
-// FIX function
-// Truncate a double to the smallest int.
-// y = FIX(x)
+      // DOT(A, B)
+      case opDOT:
+        opnd2 = *--sp;
+        opnd1 = sp[-1];
+        res = ArrTbl.Dot(int(opnd1), int(opnd2));
+        sp[-1] = res;
 
-double Parser::EvalFix()
-{
-  double x, y;
+        if (Trace)
+          DispVec(tcDOT, int(opnd1), int(opnd2), res);
+        break;
 
-  Scn.ReadToken();  // read (
+      // MIN(A)
+      case opMIN:
+        opnd1 = sp[-1];
+        res = ArrTbl.Min(int(opnd1));
+        sp[-1] = res;
 
-  if (Scn.GetToken() != tcLPAR)
-  {
-    ErrRpt.Error(ecLPAR_MISSING);
-    return 0.0;
-  }
+        if (Trace)
+          DispVec(tcMIN, int(opnd1), -1, res);
+        break;
 
-  Scn.ReadToken();  // read x
-  x = EvalExpr();
+      // MAX(A)
+      case opMAX:
+        opnd1 = sp[-1];
+        res = ArrTbl.Max(int(opnd1));
+        sp[-1] = res;
 
-  if (Scn.GetToken() != tcRPAR)
-  {
-    ErrRpt.Error(ecRPAR_MISSING);
-    return 0.0;
-  }
+        if (Trace)
+          DispVec(tcMAX, int(opnd1), -1, res);
+        break;
 
-  Scn.ReadToken();
-  y = double(Trunc(x));
+      // push a copy of the top of stack
+      case opDUP:
+        sp[0] = sp[-1];
+        sp++;
+        break;
 
-  if (DebMode)
-  {
-    printf("FIX(");
-    DispFloat(x, Precision);
-    printf(") = ");
-    DispFloat(y, Precision);
-    printf("\n");
+      case opEND:
+        return sp[-1];
+    }
   }
-
-  return y;
 }
 //===========================================
-// SQR function
-// Must be x >= 0.
-// y = SQR(x)
+// *** DEBUG INFO ***
+//===========================================
+// Display a logical op: opnd1 op opnd2 = res
 
-double Parser::EvalSqr()
+void Parser::DispLogOp(TokCode op, double opnd1, double opnd2,
+  double res)
 {
-  double x, y;
-
-  Scn.ReadToken();  // read (
-
-  if (Scn.GetToken() != tcLPAR)
-  {
-    ErrRpt.Error(ecLPAR_MISSING);
-    return 0.0;
-  }
-
-  Scn.ReadToken();  // read x
-  x = EvalExpr();
-
-  if (x < 0.0)
-  {
-    ErrRpt.Error(ecSQR_ARG_NEG);
-    return 0.0;
-  }
-
-  if (Scn.GetToken() != tcRPAR)
-  {
-    ErrRpt.Error(ecRPAR_MISSING);
-    return 0.0;
-  }
-
-  Scn.ReadToken();
-  y = sqrt(x);
-
-  if (DebMode)
-  {
-    printf("SQR(");
-    DispFloat(x, Precision);
-    printf(") = ");
-    DispFloat(y, Precision);
-    printf("\n");
-  }
-
-  return y;
+  DispLogValue(Ctx.Out, opnd1);
+  Ctx.Out.Printf(" %s ", FindTokStr(op));
+  DispLogValue(Ctx.Out, opnd2);
+  Ctx.Out.PutStr(" = ");
+  DispLogValue(Ctx.Out, res);
+  Ctx.Out.PutCh('\n');
 }
 //===========================================
-// POW() function
-// POW(b, n) = b^n. n must be integer >= 0.
-// y = POW(b, n)
+// Display a comparison: opnd1 op opnd2 = res
 
-double Parser::EvalPow()
+void Parser::DispCompOp(TokCode op, double opnd1, double opnd2,
+  bool res)
 {
-  double b, n, y;
-
-  Scn.ReadToken();  // read (
-
-  if (Scn.GetToken() != tcLPAR)
-  {
-    ErrRpt.Error(ecLPAR_MISSING);
-    return 0.0;
-  }
-
-  Scn.ReadToken();  // read b
-  b = EvalExpr();
-
-  if (Scn.GetToken() != tcCOMMA)
-  {
-    ErrRpt.Error(ecCOMMA_MISSING);
-    return 0.0;
-  }
-
-  Scn.ReadToken();  // read n
-  n = EvalExpr();
-
-  if (n < 0.0)
-  {
-    ErrRpt.Error(ecEXP_NEG);
-    return 0.0;
-  }
-
-  if (!IsInt(n))
-  {
-    ErrRpt.Error(ecEXP_NOT_INT);
-    n = RoundOff(n);
-  }
-
-  if (Scn.GetToken() != tcRPAR)
-  {
-    ErrRpt.Error(ecRPAR_MISSING);
-    return 0.0;
-  }
-
-  Scn.ReadToken();
-  y = pow(b, n);
-
-  if (DebMode)
-  {
-    printf("POW(");
-    DispFloat(b, Precision);
-    printf(", ");
-    DispFloat(n, 0);  // n is integer
-    printf(") = ");
-    DispFloat(y, Precision);
-    printf("\n");
-  }
-
-  return y;
+  DispFloat(Ctx.Out, opnd1, Precision);
+  Ctx.Out.Printf(" %s ", FindTokStr(op));
+  DispFloat(Ctx.Out, opnd2, Precision);
+  Ctx.Out.PutStr(" = ");
+  DispLogValue(Ctx.Out, res);
+  Ctx.Out.PutCh('\n');
 }
 //===========================================
-// EXP() function
-// EXP(x) = e^x
-// y = EXP(x)
+// Display an arithmetic op: opnd1 op opnd2 = res
 
-double Parser::EvalExp()
+void Parser::DispArithOp(TokCode op, double opnd1, double opnd2,
+  double res)
 {
-  double x, y;
-
-  Scn.ReadToken();  // read (
-
-  if (Scn.GetToken() != tcLPAR)
-  {
-    ErrRpt.Error(ecLPAR_MISSING);
-    return 0.0;
-  }
-
-  Scn.ReadToken();  // read x
-  x = EvalExpr();
-
-  if (Scn.GetToken() != tcRPAR)
-  {
-    ErrRpt.Error(ecRPAR_MISSING);
-    return 0.0;
-  }
-
-  Scn.ReadToken();
-  y = exp(x);
-
-  if (DebMode)
-  {
-    printf("EXP(");
-    DispFloat(x, Precision);
-    printf(") = ");
-    DispFloat(y, Precision);
-    printf("\n");
-  }
-
-  return y;
+  DispFloat(Ctx.Out, opnd1, Precision);
+  Ctx.Out.Printf(" %s ", FindTokStr(op));
+  DispFloat(Ctx.Out, opnd2, Precision);
+  Ctx.Out.PutStr(" = ");
+  DispFloat(Ctx.Out, res, Precision);
+  Ctx.Out.PutCh('\n');
 }
 //===========================================
-// LOG() function
-// LOG(x) = ln(x) = natural logarithm of x. Must be x > 0.
-// y = LOG(x)
+// Display a built-in func call: func(x) = y
 
-double Parser::EvalLog()
+void Parser::DispFunc(TokCode func, double x, double y)
 {
-  double x, y;
-
-  Scn.ReadToken();  // read (
-
-  if (Scn.GetToken() != tcLPAR)
-  {
-    ErrRpt.Error(ecLPAR_MISSING);
-    return 0.0;
-  }
-
-  Scn.ReadToken();  // read x
-  x = EvalExpr();
-
-  if (x <= 0.0)
-  {
-    ErrRpt.Error(ecLOG_ARG_NEG);
-    return 0.0;
-  }
-
-  if (Scn.GetToken() != tcRPAR)
-  {
-    ErrRpt.Error(ecRPAR_MISSING);
-    return 0.0;
-  }
+  Ctx.Out.Printf("%s(", FindTokStr(func));
+  DispFloat(Ctx.Out, x, Precision);
+  Ctx.Out.PutStr(") = ");
+  DispFloat(Ctx.Out, y, Precision);
+  Ctx.Out.PutCh('\n');
+}
+//===========================================
+// Display an array element: arr(i [, j]) = value
 
-  Scn.ReadToken();
-  y = log(x);
+void Parser::DispArr(int arr, int dims, double i, double j, double value)
+{
+  Ctx.Out.Printf("%s(", Prog->GetVarName(arr));
+  DispFloat(Ctx.Out, i, Precision);
 
-  if (DebMode)
+  if (dims == 2)
   {
-    printf("LOG(");
-    DispFloat(x, Precision);
-    printf(") = ");
-    DispFloat(y, Precision);
-    printf("\n");
+    Ctx.Out.PutStr(", ");
+    DispFloat(Ctx.Out, j, Precision);
   }
 
-  return y;
+  Ctx.Out.PutStr(") = ");
+  DispFloat(Ctx.Out, value, Precision);
+  Ctx.Out.PutCh('\n');
 }
 //===========================================
-// RND function
-// Return a pseudo-random r in the range: a <= r <= b.
-// Must be: a, b = unsigned int, a < b.
-// y = RND(a, b)
+// Display a whole-array func call: func(arr1 [, arr2]) = value
+// arr2 = -1 for a func of one array.
 
-double Parser::EvalRnd()
+void Parser::DispVec(TokCode func, int arr1, int arr2, double value)
 {
-  double a, b, y;
-
-  Scn.ReadToken();  // read (
-
-  if (Scn.GetToken() != tcLPAR)
-  {
-    ErrRpt.Error(ecLPAR_MISSING);
-    return 0.0;
-  }
+  Ctx.Out.Printf("%s(%s", FindTokStr(func), Prog->GetVarName(arr1));
 
-  Scn.ReadToken();  // read a
-  a = EvalExpr();
+  if (arr2 >= 0)
+    Ctx.Out.Printf(", %s", Prog->GetVarName(arr2));
 
-  if (a < 0.0)
-  {
-    ErrRpt.Error(ecRND_ARG_NEG);
-    return 0.0;
-  }
+  Ctx.Out.PutStr(") = ");
+  DispFloat(Ctx.Out, value, Precision);
+  Ctx.Out.PutCh('\n');
+}
+//===========================================
+// *** COMMAND EXECUTOR ***
+//===========================================
+// Entry point to command executor.
+// Return false if errors happened.
+// In profile mode the run is measured by the profiler.
+// The executor and the expr calculator exist in two versions: with
+// debug info (Trace = true) and without it (Trace = false). Run the
+// version selected by DebMode until the program ends; DEB_MODE
+// returns here to switch versions. So the regular version contains no
+// debug code at all.
+
+bool Parser::Execute()
+{
+  bool done = false;
 
-  if (!IsInt(a))
-  {
-    ErrRpt.Error(ecRND_ARG_INT);
-    a = RoundOff(a);
-  }
+  if (!Prog->IsLoaded())
+    return false;
 
-  if (Scn.GetToken() != tcCOMMA)
-  {
-    ErrRpt.Error(ecCOMMA_MISSING);
-    return 0.0;
-  }
+  NumPool = Prog->GetNumPool();
+  VarTbl.Init(Prog->GetNumVars());
+  ArrTbl.Init(Prog->GetNumVars());
+  Rdr.Rewind();
+  Rdr.ReadToken();
 
-  Scn.ReadToken();  // read b
-  b = EvalExpr();
+  if (ProfMode)
+    Prf.Start(Prog->GetNumLines());
 
-  if (b < 0.0)
+  while (!done)
   {
-    ErrRpt.Error(ecRND_ARG_NEG);
-    return 0.0;
-  }
+    // native code skips the debug info and the profile counts
+    JitOn = JitMode && !DebMode && !ProfMode;
 
-  if (!IsInt(b))
-  {
-    ErrRpt.Error(ecRND_ARG_INT);
-    b = RoundOff(b);
+    if (ProfMode)
+      done = DebMode ? Run<true, true>() : Run<false, true>();
+    else
+      done = DebMode ? Run<true, false>() : Run<false, false>();
   }
 
-  if (a >= b)
-  {
-    ErrRpt.Error(ecRND_WRONG_ARG);
-    return 0.0;
-  }
+  if (ProfMode)
+    Prf.Stop();
 
-  if (Scn.GetToken() != tcRPAR)
-  {
-    ErrRpt.Error(ecRPAR_MISSING);
-    return 0.0;
-  }
+  ArrTbl.Free();  // the arrays live for the run only
 
-  Scn.ReadToken();
-  y = double(int(double(rand()) / RAND_MAX * (b - a) + a + 0.5));
+  if (Ctx.ErrRpt.IsAborted())
+    return false;
 
-  if (DebMode)
-  {
-    printf("RND(");
-    DispFloat(a, 0);
-    printf(", ");
-    DispFloat(b, 0);
-    printf(") = ");
-    DispFloat(y, 0);
-    printf("\n");
-  }
+  if (Rdr.GetToken() != tcEND)
+    Ctx.ErrRpt.Error(ecEND_MISSING);  // no END at the end of source
 
-  return y;
+  Ctx.Out.Flush();
+  return Ctx.ErrRpt.GetCount() == 0;
 }
 //===========================================
-// *** COMMAND EXECUTOR ***
-//===========================================
-// Entry point to command executor.
-
-// Execute a command.
-
-void Parser::Execute()
+// Execute commands until the end of program, or until DEB_MODE
+// changes the debug mode. Return true at the end of program, or when
+// the run is aborted by errors.
+// Prof = true => count the commands executed per line.
+// Commands are dispatched by their 1st token, either through a table
+// of label addresses (computed goto) or through a switch.
+
+template <bool Trace, bool Prof>
+bool Parser::Run()
 {
-  bool done = false;
-
-  Scn.ReadToken();
-
-  while (!done)  // execution loop
-  {
-    switch (Scn.GetToken())
-    {
-      case tcVAR: ExecAssign(); break;
-      case tcIF: ExecIf(); break;
-      case tcELSE: ExecElse(); break;
-      case tcENDIF: ExecEndIf(); break;
-      case tcGOTO: ExecGoto(); break;
-      case tcGOSUB: ExecGosub(); break;
-      case tcRETURN: ExecReturn(); break;
-      case tcFOR: ExecFor(); break;
-      case tcNEXT: ExecNext(); break;
-      case tcWHILE: ExecWhile(); break;
-      case tcWEND: ExecWend(); break;
-      case tcDO: ExecDo(); break;
-      case tcUNTIL: ExecUntil(); break;
-      case tcBREAK: ExecBreak(); break;
-      case tcCONTINUE: ExecContinue(); break;
-      case tcINPUT: ExecInput(); break;
-      case tcPRINT: ExecPrint(); break;
-      case tcRANDOMIZE: ExecRandomize(); break;
-      case tcPRECISION: ExecPrecision(); break;
-      case tcDEB_MODE: ExecDebMode(); break;
-      case tcEND: done = true; break;
-      case tcEOF: done = true; break;
-      default: Scn.ReadToken(); break;
-    }
+#ifdef COMPUTED_GOTO
+  // command handler of each token code, in TokCode order
+  static void* const cmd_tbl[] =
+  {
+    // logical ops
+    &&cmd_OTHER, &&cmd_OTHER, &&cmd_OTHER,
+    // commands
+    &&cmd_IF, &&cmd_OTHER, &&cmd_ELSE, &&cmd_ENDIF, &&cmd_FOR,
+    &&cmd_OTHER, &&cmd_OTHER, &&cmd_NEXT, &&cmd_WHILE, &&cmd_WEND,
+    &&cmd_DO, &&cmd_UNTIL, &&cmd_BREAK, &&cmd_CONTINUE, &&cmd_GOTO,
+    &&cmd_GOSUB, &&cmd_RETURN, &&cmd_END, &&cmd_INPUT, &&cmd_PRINT,
+    &&cmd_RANDOMIZE, &&cmd_DIM, &&cmd_MAT,
+    // built-in funcs
+    &&cmd_OTHER, &&cmd_OTHER, &&cmd_OTHER, &&cmd_OTHER, &&cmd_OTHER,
+    &&cmd_OTHER, &&cmd_OTHER, &&cmd_OTHER, &&cmd_OTHER,
+    // whole-array built-in funcs
+    &&cmd_OTHER, &&cmd_OTHER, &&cmd_OTHER, &&cmd_OTHER,
+    // immediate commands
+    &&cmd_PRECISION, &&cmd_DEB_MODE,
+    // values of DEB_MODE
+    &&cmd_OTHER, &&cmd_OTHER,
+    // arithmetic ops
+    &&cmd_OTHER, &&cmd_OTHER, &&cmd_OTHER, &&cmd_OTHER, &&cmd_OTHER,
+    // parentheses ops
+    &&cmd_OTHER, &&cmd_OTHER,
+    // relational ops
+    &&cmd_OTHER, &&cmd_OTHER, &&cmd_OTHER, &&cmd_OTHER, &&cmd_OTHER,
+    &&cmd_OTHER,
+    // misc
+    &&cmd_OTHER, &&cmd_OTHER,
+    // tokens with user-defined content
+    &&cmd_VAR, &&cmd_ARR, &&cmd_OTHER, &&cmd_OTHER,
+    // special
+    &&cmd_OTHER, &&cmd_EOF, &&cmd_OTHER
+  };
+
+  static_assert(sizeof(cmd_tbl) / sizeof(cmd_tbl[0]) == tcINVALID + 1,
+    "cmd_tbl must have an item for every token code");
+
+// CMD(tok) = label of handler of command tok
+#define CMD(tok)  cmd_##tok: if (Prof) Prf.Count(Ctx.Line);
+#define NEXT_CMD  \
+  { if (Ctx.ErrRpt.IsAborted()) return true; goto *cmd_tbl[Rdr.GetToken()]; }
+
+  NEXT_CMD;  // each handler jumps straight to the next one
+  {
+#else
+#define CMD(tok)  case tc##tok: if (Prof) Prf.Count(Ctx.Line);
+#define NEXT_CMD  continue
+
+  while (!Ctx.ErrRpt.IsAborted())  // execution loop
+  switch (Rdr.GetToken())
+  {
+#endif
+    CMD(VAR) ExecAssign<Trace>(); NEXT_CMD;
+    CMD(ARR) ExecAssign<Trace>(); NEXT_CMD;
+    CMD(IF) ExecIf<Trace>(); NEXT_CMD;
+    CMD(ELSE) ExecElse(); NEXT_CMD;
+    CMD(ENDIF) ExecEndIf(); NEXT_CMD;
+    CMD(GOTO) ExecGoto(); NEXT_CMD;
+    CMD(GOSUB) ExecGosub(); NEXT_CMD;
+    CMD(RETURN) ExecReturn(); NEXT_CMD;
+    CMD(FOR) ExecFor<Trace>(); NEXT_CMD;
+    CMD(NEXT) ExecNext(); NEXT_CMD;
+    CMD(WHILE) ExecWhile<Trace>(); NEXT_CMD;
+    CMD(WEND) ExecWend<Trace>(); NEXT_CMD;
+    CMD(DO) ExecDo(); NEXT_CMD;
+    CMD(UNTIL) ExecUntil<Trace>(); NEXT_CMD;
+    CMD(BREAK) ExecBreak(); NEXT_CMD;
+    CMD(CONTINUE) ExecContinue(); NEXT_CMD;
+    CMD(INPUT) ExecInput(); NEXT_CMD;
+    CMD(PRINT) ExecPrint<Trace>(); NEXT_CMD;
+    CMD(RANDOMIZE) ExecRandomize<Trace>(); NEXT_CMD;
+    CMD(PRECISION) ExecPrecision<Trace>(); NEXT_CMD;
+    CMD(DIM) ExecDim<Trace>(); NEXT_CMD;
+    CMD(MAT) ExecMat<Trace>(); NEXT_CMD;
+
+    CMD(DEB_MODE)
+      ExecDebMode();
+
+      if (DebMode != Trace)  // switch to the other version
+        return false;
+      NEXT_CMD;
+
+    CMD(END) return true;
+    CMD(EOF) return true;
+
+#ifdef COMPUTED_GOTO
+    cmd_OTHER:
+#else
+    default:
+#endif
+      Rdr.ReadToken();
+      NEXT_CMD;
   }
 
-  if (Scn.GetToken() != tcEND)
-    ErrRpt.Error(ecEND_MISSING);  // no END at the end of source
+#undef CMD
+#undef NEXT_CMD
+
+  return true;  // aborted
 }
 //===========================================
 // Assignment command
-// Assign an expr to a var.
+// Assign an expr to a var or to an array element.
 // var = expr
+// arr(i [, j]) = expr
 
+template <bool Trace>
 void Parser::ExecAssign()
 {
-  char var;  // var name
+  int var;  // var or array slot
+  int dims = 0;  // num of indexes, 0 for a var
+  double index[2] = { 0.0, 0.0 };  // values of indexes
   double value;  // value of expr
 
-  var = toupper(Scn.GetTokStr()[0]);
-  Scn.ReadToken();  // read =
+  var = Rdr.GetVarIndex();
+
+  if (Rdr.GetToken() == tcARR)
+  {
+    Rdr.ReadToken();  // read (
+    Rdr.ReadToken();  // read 1st index
+    index[dims++] = EvalExpr<Trace>();
+
+    if (Rdr.GetToken() == tcCOMMA)
+    {
+      Rdr.ReadToken();  // read 2nd index
+      index[dims++] = EvalExpr<Trace>();
+    }
+
+    if (Rdr.GetToken() != tcRPAR)
+    {
+      Ctx.ErrRpt.Error(ecRPAR_MISSING);
+      return;
+    }
+  }
+
+  Rdr.ReadToken();  // read =
 
-  if (Scn.GetToken() != tcEQ)
+  if (Rdr.GetToken() != tcEQ)
   {
-    ErrRpt.Error(ecEQ_MISSING);
+    Ctx.ErrRpt.Error(ecEQ_MISSING);
     return;
   }
 
-  Scn.ReadToken();  // read expr
-  value = EvalExpr();
-  VarTbl.Set(var, value);  // assign value to var
+  Rdr.ReadToken();  // read expr
+  value = EvalExpr<Trace>();
+
+  if (dims == 0)
+    VarTbl.Set(var, value);  // assign value to var
+  else if (dims == 1)
+    ArrTbl.Set(var, index[0], value);
+  else
+    ArrTbl.Set(var, index[0], index[1], value);
 }
 //===========================================
 // IF command
@@ -1026,25 +880,33 @@ void Parser::ExecAssign()
 //   block2
 // ENDIF
 
+template <bool Trace>
 void Parser::ExecIf()
 {
   double expr;  // value of expr
+  int loc = Rdr.GetJump();  // loc of matching ELSE or ENDIF
 
-  Scn.ReadToken();  // read expr
-  expr = EvalExpr();
+  Rdr.ReadToken();  // read expr
+  expr = EvalExpr<Trace>();
 
-  if (Scn.GetToken() != tcTHEN)
+  if (Rdr.GetToken() != tcTHEN)
   {
-    ErrRpt.Error(ecTHEN_MISSING);
+    Ctx.ErrRpt.Error(ecTHEN_MISSING);
     return;
   }
 
-  Scn.ReadToken();
-
   if (!expr)  // expr is false, so skip block1
-    SkipUntilToken2(tcELSE, tcENDIF);
+  {
+    SkipTo(loc);
 
-  Scn.ReadToken();
+    if (Rdr.GetToken() == tcELSE || Rdr.GetToken() == tcENDIF)
+      Rdr.ReadToken();
+
+    return;
+  }
+
+  Rdr.ReadToken();
+  Rdr.ReadToken();
 }
 //===========================================
 // ELSE command
@@ -1056,8 +918,10 @@ void Parser::ExecIf()
 
 void Parser::ExecElse()
 {
-  SkipUntilToken(tcENDIF);  // skip block2
-  Scn.ReadToken();
+  SkipTo(Rdr.GetJump());  // skip block2
+
+  if (Rdr.GetToken() == tcENDIF)
+    Rdr.ReadToken();
 }
 //===========================================
 // ENDIF command
@@ -1075,7 +939,7 @@ void Parser::ExecElse()
 
 void Parser::ExecEndIf()
 {
-  Scn.ReadToken();  // get out of last block, either block1 or block2
+  Rdr.ReadToken();  // get out of last block, either block1 or block2
 }
 //===========================================
 // GOTO command
@@ -1084,26 +948,26 @@ void Parser::ExecEndIf()
 
 void Parser::ExecGoto()
 {
-  char* loc;
+  int loc;
 
-  Scn.ReadToken();  // read label
+  Rdr.ReadToken();  // read label
 
-  if (Scn.GetToken() != tcNUM)  // not a valid label
+  if (Rdr.GetToken() != tcNUM)  // not a valid label
   {
-    ErrRpt.Error(ecLBL_INVALID);
+    Ctx.ErrRpt.Error(ecLBL_INVALID);
     return;
   }
 
-  loc = Scn.FindLblLoc(Scn.GetTokStr());
+  loc = Rdr.GetJump();  // label was resolved at load time
 
-  if (loc == NULL)  // no such label
+  if (loc < 0)  // no such label
   {
-    ErrRpt.Error(ecLBL_UNDEF);
+    Ctx.ErrRpt.Error(ecLBL_UNDEF);
     return;
   }
 
-  Scn.SetProg(loc);  // jump to loc
-  Scn.ReadToken();
+  Rdr.SetPos(loc);  // jump to loc
+  Rdr.ReadToken();
 }
 //===========================================
 // GOSUB command
@@ -1112,28 +976,28 @@ void Parser::ExecGoto()
 
 void Parser::ExecGosub()
 {
-  char* loc;
+  int loc;
 
-  Scn.ReadToken();  // read label
+  Rdr.ReadToken();  // read label
 
-  if (Scn.GetToken() != tcNUM)  // not a valid label
+  if (Rdr.GetToken() != tcNUM)  // not a valid label
   {
-    ErrRpt.Error(ecLBL_INVALID);
+    Ctx.ErrRpt.Error(ecLBL_INVALID);
     return;
   }
 
-  loc = Scn.FindLblLoc(Scn.GetTokStr());
+  loc = Rdr.GetJump();  // label was resolved at load time
 
-  if (loc == NULL)  // no such label
+  if (loc < 0)  // no such label
   {
-    ErrRpt.Error(ecLBL_UNDEF);
+    Ctx.ErrRpt.Error(ecLBL_UNDEF);
     return;
   }
 
   // push the current loc on GOSUB stack = return address
-  GosubStk.Push(Scn.GetProg());
-  Scn.SetProg(loc);  // jump to loc
-  Scn.ReadToken();
+  GosubStk.Push(Rdr.GetPos());
+  Rdr.SetPos(loc);  // jump to loc
+  Rdr.ReadToken();
 }
 //===========================================
 // RETURN command
@@ -1143,9 +1007,19 @@ void Parser::ExecGosub()
 
 void Parser::ExecReturn()
 {
+  int loc;
+
   // pop the return loc from the GOSUB stack
-  Scn.SetProg(GosubStk.Pop());
-  Scn.ReadToken();  // jump to loc
+  loc = GosubStk.Pop();
+
+  if (loc < 0)  // GOSUB stack was empty, so skip RETURN
+  {
+    Rdr.ReadToken();
+    return;
+  }
+
+  Rdr.SetPos(loc);
+  Rdr.ReadToken();  // jump to loc
 }
 //===========================================
 // FOR command
@@ -1153,52 +1027,54 @@ void Parser::ExecReturn()
 //   block
 // NEXT
 
+template <bool Trace>
 void Parser::ExecFor()
 {
-  char var;  // counter var name
+  int var;  // counter var slot
   double start_value, end_value, step_value;
-  bool skip_loop;
+  bool skip_loop, pushed;
   ForStkItem i;
+  int loc = Rdr.GetJump();  // loc of matching NEXT
 
-  Scn.ReadToken();  // read var name
+  Rdr.ReadToken();  // read var name
 
-  if (Scn.GetToken() != tcVAR)
+  if (Rdr.GetToken() != tcVAR)
   {
-    ErrRpt.Error(ecNOT_VAR);
+    Ctx.ErrRpt.Error(ecNOT_VAR);
     return;
   }
 
-  var = toupper(Scn.GetTokStr()[0]);
-  Scn.ReadToken();  // read =
+  var = Rdr.GetVarIndex();
+  Rdr.ReadToken();  // read =
 
-  if (Scn.GetToken() != tcEQ)
+  if (Rdr.GetToken() != tcEQ)
   {
-    ErrRpt.Error(ecEQ_MISSING);
+    Ctx.ErrRpt.Error(ecEQ_MISSING);
     return;
   }
 
-  Scn.ReadToken();  // read start_value
-  start_value = EvalExpr();
+  Rdr.ReadToken();  // read start_value
+  start_value = EvalExpr<Trace>();
 
-  if (Scn.GetToken() != tcTO)
+  if (Rdr.GetToken() != tcTO)
   {
-    ErrRpt.Error(ecTO_MISSING);
+    Ctx.ErrRpt.Error(ecTO_MISSING);
     return;
   }
 
-  Scn.ReadToken();  // read end_value
-  end_value = EvalExpr();
+  Rdr.ReadToken();  // read end_value
+  end_value = EvalExpr<Trace>();
 
-  if (Scn.GetToken() != tcSTEP)  // no STEP clause
+  if (Rdr.GetToken() != tcSTEP)  // no STEP clause
     step_value = 1.0;  // so use the default value 1
   else  // STEP clause present
   {
-    Scn.ReadToken();  // read step_value
-    step_value = EvalExpr();
+    Rdr.ReadToken();  // read step_value
+    step_value = EvalExpr<Trace>();
 
     if (step_value == 0.0)
     {
-      ErrRpt.Error(ecSTEP_ZERO);  // 0 step is illegal
+      Ctx.ErrRpt.Error(ecSTEP_ZERO);  // 0 step is illegal
       step_value = 1.0;
     }
   }
@@ -1210,25 +1086,43 @@ void Parser::ExecFor()
 
   if (skip_loop)  // skip the loop
   {
-    SkipUntilToken(tcNEXT);
+    SkipTo(loc);
 
-    if (Scn.GetToken() != tcNEXT)
-      ErrRpt.Error(ecNEXT_MISSING);
+    if (Rdr.GetToken() != tcNEXT)
+      Ctx.ErrRpt.Error(ecNEXT_MISSING);
     else
-      Scn.ReadToken();
+      Rdr.ReadToken();
 
     return;
   }
 
   // stay in loop
   // save current value of counter var in VarTbl
-  VarTbl.Set(var, start_value);
-  i.Var = var;  // var name
+  i.Var = var;
+  VarTbl.Set(i.Var, start_value);
+  // an int loop also keeps end + step below 2^53, so every value of
+  // the counter is exact in a double
+  i.IsInt = IsExactInt(start_value) && IsExactInt(end_value) &&
+    IsExactInt(step_value) &&
+    fabs(end_value) + fabs(step_value) < 9007199254740992.0;
   i.EndValue = end_value;
   i.StepValue = step_value;
-  i.Loc = Scn.GetProg();  // save the FOR command loc
+
+  if (i.IsInt)  // else the values may not fit in a long long
+  {
+    i.Count = (long long)start_value;
+    i.EndCount = (long long)end_value;
+    i.StepCount = (long long)step_value;
+    i.Left = (i.EndCount - i.Count) / i.StepCount;
+  }
+
+  i.Loc = Rdr.GetPos();  // save the FOR command loc
+  pushed = !ForStk.IsFull();
   ForStk.Push(i);  // save info on FOR stack
-  Scn.ReadToken();  // read the 1st token of block
+  Rdr.ReadToken();  // read the 1st token of block
+
+  if (JitOn && pushed)
+    RunNative(i.Loc, loc, false, &ForStk.Peek());
 }
 //===========================================
 // NEXT command
@@ -1238,42 +1132,85 @@ void Parser::ExecFor()
 
 void Parser::ExecNext()
 {
-  char var;  // counter var name
-  double var_value, end_value, step_value;
-  bool skip_loop;
-  ForStkItem i;
+  int loc = Rdr.GetCur();  // loc of NEXT
 
   if (ForStk.IsEmpty())
   {
-    ErrRpt.Error(ecNEXT_WITHOUT_FOR);  // too many NEXTs
+    Ctx.ErrRpt.Error(ecNEXT_WITHOUT_FOR);  // too many NEXTs
     return;
   }
 
-  i = ForStk.Peek();
-  var = i.Var;
-  var_value = VarTbl.Get(var);  // get current value of counter var
-  end_value = i.EndValue;
-  step_value =  i.StepValue;
-  var_value += step_value;  // increment counter var by step
-  VarTbl.Set(var, var_value);  // save counter var in VarTbl
-
-  if (step_value > 0.0)  // counting up
-    skip_loop = var_value > end_value;
-  else  // counting down
-    skip_loop = var_value < end_value;
+  ForStkItem& i = ForStk.Peek();
 
-  if (skip_loop)  // skip the loop
+  if (!StepFor(i))  // exit loop
   {
-    var_value -= step_value;  // cancel incrementing of counter var
-    VarTbl.Set(var, var_value);  // save counter var value in VarTbl
+    // the counter var keeps its last value in loop
     ForStk.Pop();  // remove the top item from stack
-    Scn.ReadToken();  // skip NEXT
+    Rdr.ReadToken();  // skip NEXT
     return;
   }
 
   // stay in loop
-  Scn.SetProg(i.Loc);  // jump back to FOR command
-  Scn.ReadToken();
+  Rdr.SetPos(i.Loc);  // jump back to FOR command
+  Rdr.ReadToken();
+
+  if (JitOn)
+    RunNative(i.Loc, loc, true, &i);
+}
+//===========================================
+// Step the counter var of FOR loop i.
+// Return true to stay in the loop, false to exit it.
+
+bool Parser::StepFor(ForStkItem& i)
+{
+  double var_value;
+  bool skip_loop;
+
+  var_value = VarTbl.Get(i.Var);  // get current value of counter var
+
+  // the block may have assigned the counter var
+  if (i.IsInt && var_value != double(i.Count))
+  {
+    if (IsExactInt(var_value))
+    {
+      i.Count = (long long)var_value;
+      i.Left = (i.EndCount - i.Count) / i.StepCount;
+    }
+    else
+      i.IsInt = false;  // continue as a double loop
+  }
+
+  if (i.IsInt)  // int loop
+  {
+    if (--i.Left < 0)  // no pass left
+      return false;
+
+    i.Count += i.StepCount;  // increment counter by step
+    VarTbl.Set(i.Var, double(i.Count));
+    return true;
+  }
+
+  var_value += i.StepValue;  // increment counter var by step
+
+  if (i.StepValue > 0.0)  // counting up
+    skip_loop = var_value > i.EndValue;
+  else  // counting down
+    skip_loop = var_value < i.EndValue;
+
+  if (skip_loop)
+    return false;
+
+  VarTbl.Set(i.Var, var_value);  // save counter var in VarTbl
+  return true;
+}
+//===========================================
+// Set Left of int FOR loop i from Count, which the native code steps
+// without Left, before StepFor() steps the loop.
+
+void Parser::SyncFor(ForStkItem& i)
+{
+  if (i.IsInt)
+    i.Left = (i.EndCount - i.Count) / i.StepCount;
 }
 //===========================================
 // WHILE command
@@ -1281,49 +1218,51 @@ void Parser::ExecNext()
 //   block
 // WEND
 
+template <bool Trace>
 void Parser::ExecWhile()
 {
-  char var;  // control var name
+  int var;  // control var slot
   double var_value, expr;
   TokCode op;  // rel op
   bool res;  // result of comparison
   WhileStkItem i;
+  int loc = Rdr.GetJump();  // loc of matching WEND
 
-  Scn.ReadToken();  // read var name
+  Rdr.ReadToken();  // read var name
 
-  if (Scn.GetToken() != tcVAR)
+  if (Rdr.GetToken() != tcVAR)
   {
-    ErrRpt.Error(ecNOT_VAR); // not a valid var
+    Ctx.ErrRpt.Error(ecNOT_VAR); // not a valid var
     return;
   }
 
-  var = toupper(Scn.GetTokStr()[0]);  // get var name
+  var = Rdr.GetVarIndex();  // get var slot
 
   // get the current value of var from the VarTbl
   var_value = VarTbl.Get(var);
 
-  op = Scn.ReadToken();  // read op
+  op = Rdr.ReadToken();  // read op
 
   if (!IsRelOp(op))  // not a rel op
   {
-    ErrRpt.Error(ecREL_OP_MISSING);
+    Ctx.ErrRpt.Error(ecREL_OP_MISSING);
     return;
   }
 
-  Scn.ReadToken();  // read expr
-  expr = EvalExpr();
+  Rdr.ReadToken();  // read expr
+  expr = EvalExpr<Trace>();
 
   // compare var_value with expr using op
-  res = Compare(op, var_value, expr);
+  res = Compare<Trace>(op, var_value, expr);
 
   if (!res)  // res is false, so skip loop
   {
-    SkipUntilToken(tcWEND);
+    SkipTo(loc);
 
-    if (Scn.GetToken() == tcWEND)
-      Scn.ReadToken();
+    if (Rdr.GetToken() == tcWEND)
+      Rdr.ReadToken();
     else
-      ErrRpt.Error(ecWEND_MISSING);
+      Ctx.ErrRpt.Error(ecWEND_MISSING);
 
     return;
   }
@@ -1331,16 +1270,19 @@ void Parser::ExecWhile()
   // res is true, so stay in loop
   if (WhileStk.IsFull())
   {
-    ErrRpt.Error(ecTOO_MANY_WHILE_NEST);  // too many WHILEs
+    Ctx.ErrRpt.Error(ecTOO_MANY_WHILE_NEST);  // too many WHILEs
     return;
   }
 
-  i.Var = var;  // save control var name
+  i.Var = var;  // save control var slot
   i.Op = op;  // save op
   i.Expr = expr;  // save value of expr
-  i.Loc = Scn.GetProg();  // save WHILE command loc
+  i.Loc = Rdr.GetPos();  // save WHILE command loc
   WhileStk.Push(i);  // save info on stack
-  Scn.ReadToken();  // read the 1st token of block
+  Rdr.ReadToken();  // read the 1st token of block
+
+  if (JitOn)
+    RunNative(i.Loc, loc, false, &WhileStk.Peek());
 }
 //===========================================
 // WEND command
@@ -1348,17 +1290,19 @@ void Parser::ExecWhile()
 //   block
 // WEND
 
+template <bool Trace>
 void Parser::ExecWend()
 {
-  char var;  // control var name
+  int var;  // control var slot
   double var_value, expr;
   TokCode op;  // rel op
   bool res;  // result of comparison
   WhileStkItem i;
+  int loc = Rdr.GetCur();  // loc of WEND
 
   if (WhileStk.IsEmpty())
   {
-    ErrRpt.Error(ecWEND_WITHOUT_WHILE);  // too many WENDs/
+    Ctx.ErrRpt.Error(ecWEND_WITHOUT_WHILE);  // too many WENDs/
     return;
   }
 
@@ -1371,18 +1315,21 @@ void Parser::ExecWend()
   var_value = VarTbl.Get(var);
 
   // compare var_value with expr using op
-  res = Compare(op, var_value, expr);
+  res = Compare<Trace>(op, var_value, expr);
 
   if (!res)  // res is false, so exit loop
   {
     WhileStk.Pop();  // remove the top item from stack
-    Scn.ReadToken();  // skip WEND
+    Rdr.ReadToken();  // skip WEND
     return;
   }
 
   // res is true, so stay in loop
-  Scn.SetProg(i.Loc);  // jump back to WHILE command loc
-  Scn.ReadToken();
+  Rdr.SetPos(i.Loc);  // jump back to WHILE command loc
+  Rdr.ReadToken();
+
+  if (JitOn)
+    RunNative(i.Loc, loc, true, &WhileStk.Peek());
 }
 //===========================================
 // DO command
@@ -1394,9 +1341,9 @@ void Parser::ExecDo()
 {
   DoStkItem i;
 
-  i.Loc = Scn.GetProg();  // save the DO command loc
+  i.Loc = Rdr.GetPos();  // save the DO command loc
   DoStk.Push(i);
-  Scn.ReadToken();
+  Rdr.ReadToken();
 }
 //===========================================
 // UNTIL command
@@ -1404,51 +1351,52 @@ void Parser::ExecDo()
 //   block
 // UNTIL var op expr
 
+template <bool Trace>
 void Parser::ExecUntil()
 {
-  char var;  // control var name
+  int var;  // control var slot
   double var_value, expr;
   TokCode op;  // rel op
   bool res;  // result of comparison
   DoStkItem i;
 
-  Scn.ReadToken();  // read var name
+  Rdr.ReadToken();  // read var name
 
-  if (Scn.GetToken() != tcVAR)
+  if (Rdr.GetToken() != tcVAR)
   {
-    ErrRpt.Error(ecNOT_VAR);  // not a valid var
+    Ctx.ErrRpt.Error(ecNOT_VAR);  // not a valid var
     return;
   }
 
-  var = toupper(Scn.GetTokStr()[0]);  // get var name
+  var = Rdr.GetVarIndex();  // get var slot
 
   // get current value of control var from VarTbl
   var_value = VarTbl.Get(var);
-  op = Scn.ReadToken();  // read op
+  op = Rdr.ReadToken();  // read op
 
   if (!IsRelOp(op))
   {
-    ErrRpt.Error(ecREL_OP_MISSING);  // not a rel op
+    Ctx.ErrRpt.Error(ecREL_OP_MISSING);  // not a rel op
     return;
   }
 
-  Scn.ReadToken();  // read expr
-  expr = EvalExpr();  // get expr value
+  Rdr.ReadToken();  // read expr
+  expr = EvalExpr<Trace>();  // get expr value
 
   // compare var_value with expr using op
-  res = Compare(op, var_value, expr);
+  res = Compare<Trace>(op, var_value, expr);
 
   if (res)  // res is true, so exit loop
   {
     DoStk.Pop();  // remove the top item from stack
-    Scn.ReadToken();
+    Rdr.ReadToken();
     return;
   }
 
   // res is false, so stay in loop
   if (DoStk.IsFull())
   {
-    ErrRpt.Error(ecTOO_MANY_DO_NEST);  // too many DOs
+    Ctx.ErrRpt.Error(ecTOO_MANY_DO_NEST);  // too many DOs
     return;
   }
 
@@ -1459,8 +1407,8 @@ void Parser::ExecUntil()
   DoStk.Push(i);  // update top stack item
   // save cirrent value of control var in VarTbl
   VarTbl.Set(var, var_value);
-  Scn.SetProg(i.Loc);  // jump back to DO command loc
-  Scn.ReadToken();
+  Rdr.SetPos(i.Loc);  // jump back to DO command loc
+  Rdr.ReadToken();
 }
 //===========================================
 // BREAK command
@@ -1470,8 +1418,35 @@ void Parser::ExecUntil()
 
 void Parser::ExecBreak()
 {
-  SkipUntilToken3(tcNEXT, tcWEND, tcUNTIL);
-  Scn.ReadToken();
+  SkipTo(Rdr.GetJump());  // go to the end of the innermost loop
+
+  // leave the loop: remove it from its stack and skip its end
+  switch (Rdr.GetToken())
+  {
+    case tcNEXT:
+      if (!ForStk.IsEmpty())
+        ForStk.Pop();
+      Rdr.ReadToken();
+      break;
+
+    case tcWEND:
+      if (!WhileStk.IsEmpty())
+        WhileStk.Pop();
+      Rdr.ReadToken();
+      break;
+
+    case tcUNTIL:
+      if (!DoStk.IsEmpty())
+        DoStk.Pop();
+
+      // skip the UNTIL condition
+      while (Rdr.GetToken() != tcEOL && Rdr.GetToken() != tcEOF)
+        Rdr.ReadToken();
+      break;
+
+    default:
+      break;
+  }
 }
 //===========================================
 // CONTINUE command
@@ -1481,7 +1456,7 @@ void Parser::ExecBreak()
 
 void Parser::ExecContinue()
 {
-  SkipUntilToken3(tcNEXT, tcWEND, tcUNTIL);
+  SkipTo(Rdr.GetJump());  // go to the end of the innermost loop
 }
 //===========================================
 // INPUT command
@@ -1490,37 +1465,42 @@ void Parser::ExecContinue()
 
 void Parser::ExecInput()
 {
-  char var;  // var name
+  int var;  // var slot
   float value;  // var value
 
-  Scn.ReadToken();  // read prompt or var name
+  Rdr.ReadToken();  // read prompt or var name
 
-  if (Scn.GetToken() == tcSTR)  // we have a user-defined prompt
+  if (Rdr.GetToken() == tcSTR)  // we have a user-defined prompt
   {
-    printf("%s ", Scn.GetTokStr());  // display prompt
-    Scn.ReadToken();  // read ,
+    Ctx.Out.PutStr(Rdr.GetTokStr());  // display prompt
+    Ctx.Out.PutCh(' ');
+    Rdr.ReadToken();  // read ,
 
-    if (Scn.GetToken() != tcCOMMA)
+    if (Rdr.GetToken() != tcCOMMA)
     {
-      ErrRpt.Error(ecCOMMA_MISSING);
+      Ctx.ErrRpt.Error(ecCOMMA_MISSING);
       return;
     }
 
-    Scn.ReadToken();  // read var name
+    Rdr.ReadToken();  // read var name
   }
   else  // no user-defined prompt present
-    printf("? ");  // display the default prompt ?
+    Ctx.Out.PutStr("? ");  // display the default prompt ?
 
-  if (Scn.GetToken() != tcVAR)  // no var name
+  if (Rdr.GetToken() != tcVAR)  // no var name
   {
-    ErrRpt.Error(ecVAR_MISSING);
+    Ctx.ErrRpt.Error(ecVAR_MISSING);
     return;
   }
 
-  var = toupper(Scn.GetTokStr()[0]);  // get var name
-  scanf("%f", &value);
+  var = Rdr.GetVarIndex();  // get var slot
+  Ctx.Out.Flush();  // the prompt must be visible before reading
+
+  if (fscanf(Ctx.In, "%f", &value) != 1)
+    value = 0.0f;  // no number to read
+
   VarTbl.Set(var, double(value));  // save var value in VarTbl
-  Scn.ReadToken();
+  Rdr.ReadToken();
 }
 //===========================================
 // PRINT command
@@ -1531,41 +1511,47 @@ void Parser::ExecInput()
 // PRINT str [, ...]
 // PRINT expr [, ...]
 
+template <bool Trace>
 void Parser::ExecPrint()
 {
   double value;  // expr value
   bool done = false;
 
-  Scn.ReadToken();
+  Rdr.ReadToken();
 
   while (!done)
   {
-    switch (Scn.GetToken())
+    switch (Rdr.GetToken())
     {
       case tcEOL:  // terminate loop
-        printf("\n");
-        Scn.ReadToken();
+        Ctx.Out.PutCh('\n');
+        Rdr.ReadToken();
+        done = true;
+        break;
+
+      case tcEOF:  // terminate loop, END is missing
+        Ctx.Out.PutCh('\n');
         done = true;
         break;
 
       case tcCOMMA:  // print a space
-        printf(" ");
-        Scn.ReadToken();
+        Ctx.Out.PutCh(' ');
+        Rdr.ReadToken();
         break;
 
       case tcSEMI:  // print a tab
-        printf("\t");
-        Scn.ReadToken();
+        Ctx.Out.PutCh('\t');
+        Rdr.ReadToken();
         break;
 
       case tcSTR:  // str literal
-        printf(Scn.GetTokStr());  // print it
-        Scn.ReadToken();
+        Ctx.Out.PutStr(Rdr.GetTokStr());  // print it
+        Rdr.ReadToken();
         break;
 
       default:  // expr
-        value = EvalExpr();  // get value of expr
-        DispFloat(value, Precision);  // print it
+        value = EvalExpr<Trace>();  // get value of expr
+        DispFloat(Ctx.Out, value, Precision);  // print it
         break;
     }
   }
@@ -1576,67 +1562,201 @@ void Parser::ExecPrint()
 // Seed must be unsigned int.
 // RANDOMIZE seed
 
+template <bool Trace>
 void Parser::ExecRandomize()
 {
   double seed;
 
-  Scn.ReadToken();  // read seed
-  seed = EvalExpr();  // get value of seed
+  Rdr.ReadToken();  // read seed
+  seed = EvalExpr<Trace>();  // get value of seed
 
   if (seed < 0.0)  // must be >= 0
   {
-    ErrRpt.Error(ecRAND_ARG_NEG);
+    Ctx.ErrRpt.Error(ecRAND_ARG_NEG);
     return;
   }
 
   if (!IsInt(seed))  // must be integer
   {
-    ErrRpt.Error(ecRAND_ARG_INT);
+    Ctx.ErrRpt.Error(ecRAND_ARG_INT);
     seed = RoundOff(seed);
   }
 
-  srand((unsigned int)seed);
+  Ctx.SetRandSeed((unsigned int)seed);
 
-  if (DebMode)
+  if (Trace)
   {
-    printf("Seed = ");
-    DispFloat(seed, 0);
-    printf("\n");
+    Ctx.Out.PutStr("Seed = ");
+    DispFloat(Ctx.Out, seed, 0);
+    Ctx.Out.PutCh('\n');
   }
 }
 //===========================================
 // PRECISION command
 // Set the precison of displayed numbers.
-// Must be 0 <= prec <= 6.
+// Must be prec >= 0.
 // PRECISION prec
 
+template <bool Trace>
 void Parser::ExecPrecision()
 {
   double prec;  // precision value = num of dec places to display
 
-  Scn.ReadToken();  // read prec
-  prec = EvalExpr();  // get prec value
+  Rdr.ReadToken();  // read prec
+  prec = EvalExpr<Trace>();  // get prec value
 
   if (prec < 0.0)  // must be >= 0
   {
-    ErrRpt.Error(ecPREC_ARG_NEG);
+    Ctx.ErrRpt.Error(ecPREC_ARG_NEG);
     prec = 0.0;
   }
 
   if (!IsInt(prec))  // must be integer
   {
-    ErrRpt.Error(ecPREC_ARG_INT);
+    Ctx.ErrRpt.Error(ecPREC_ARG_INT);
     prec = RoundOff(prec);
   }
 
   Precision = int(prec);
 
-  if (DebMode)
+  if (Trace)
+  {
+    Ctx.Out.PutStr("Precision = ");
+    DispFloat(Ctx.Out, prec, 0);
+    Ctx.Out.PutCh('\n');
+  }
+}
+//===========================================
+// DIM command
+// Make arrays of n+1 or (n+1)*(m+1) elements, all 0. An array that is
+// made again loses its elements.
+// DIM arr(n [, m]) [, ...]
+
+template <bool Trace>
+void Parser::ExecDim()
+{
+  int arr;  // array slot
+  int dims;  // num of sizes
+  double size[2];  // values of sizes
+
+  do
+  {
+    if (Rdr.ReadToken() != tcARR)  // read array name
+    {
+      Ctx.ErrRpt.Error(ecARR_MISSING);
+      return;
+    }
+
+    arr = Rdr.GetVarIndex();
+    size[1] = 0.0;
+    dims = 1;
+    Rdr.ReadToken();  // read (
+    Rdr.ReadToken();  // read 1st size
+    size[0] = EvalExpr<Trace>();
+
+    if (Rdr.GetToken() == tcCOMMA)
+    {
+      Rdr.ReadToken();  // read 2nd size
+      size[1] = EvalExpr<Trace>();
+      dims = 2;
+    }
+
+    if (Rdr.GetToken() != tcRPAR)
+    {
+      Ctx.ErrRpt.Error(ecRPAR_MISSING);
+      return;
+    }
+
+    ArrTbl.Dim(arr, dims, size[0], size[1]);
+    Rdr.ReadToken();  // read , or end of line
+  } while (Rdr.GetToken() == tcCOMMA);
+}
+//===========================================
+// MAT command
+// Set every element of array dst from the elements of the arrays at
+// the same place, by the SIMD kernels of ArrTable. The arrays must be
+// dimensioned alike.
+// MAT dst = arr + arr
+// MAT dst = arr * expr
+// MAT dst = SQR | EXP | LOG (arr)
+
+template <bool Trace>
+void Parser::ExecMat()
+{
+  int dst, arr, arr2;  // array slots
+  TokCode tok;
+
+  if (Rdr.ReadToken() != tcVAR)  // read dst
+  {
+    Ctx.ErrRpt.Error(ecARR_MISSING);
+    return;
+  }
+
+  dst = Rdr.GetVarIndex();
+
+  if (Rdr.ReadToken() != tcEQ)
+  {
+    Ctx.ErrRpt.Error(ecEQ_MISSING);
+    return;
+  }
+
+  tok = Rdr.ReadToken();
+
+  if (tok == tcSQR || tok == tcEXP || tok == tcLOG)
+  {
+    if (Rdr.ReadToken() != tcLPAR)
+    {
+      Ctx.ErrRpt.Error(ecLPAR_MISSING);
+      return;
+    }
+
+    if (Rdr.ReadToken() != tcVAR)
+    {
+      Ctx.ErrRpt.Error(ecARR_MISSING);
+      return;
+    }
+
+    arr = Rdr.GetVarIndex();
+
+    if (Rdr.ReadToken() != tcRPAR)
+    {
+      Ctx.ErrRpt.Error(ecRPAR_MISSING);
+      return;
+    }
+
+    Rdr.ReadToken();
+    ArrTbl.Apply(dst, arr, tok);
+    return;
+  }
+
+  if (tok != tcVAR)
+  {
+    Ctx.ErrRpt.Error(ecARR_MISSING);
+    return;
+  }
+
+  arr = Rdr.GetVarIndex();
+  tok = Rdr.ReadToken();
+
+  if (tok == tcPLUS)
+  {
+    if (Rdr.ReadToken() != tcVAR)
+    {
+      Ctx.ErrRpt.Error(ecARR_MISSING);
+      return;
+    }
+
+    arr2 = Rdr.GetVarIndex();
+    Rdr.ReadToken();
+    ArrTbl.Add(dst, arr, arr2);
+  }
+  else if (tok == tcSTAR)
   {
-    printf("Precision = ");
-    DispFloat(prec, 0);
-    printf("\n");
+    Rdr.ReadToken();
+    ArrTbl.Scale(dst, arr, EvalExpr<Trace>());
   }
+  else
+    Ctx.ErrRpt.Error(ecUNEXP_TOKEN, FindTokStr(tok));
 }
 //===========================================
 // DEB_MODE command
@@ -1647,23 +1767,127 @@ void Parser::ExecDebMode()
 {
   TokCode tok;
 
-  tok = Scn.ReadToken();  // read the on/off value
+  tok = Rdr.ReadToken();  // read the on/off value
 
   if (tok != tcON && tok != tcOFF)
   {
-    ErrRpt.Error(ecON_OFF_MISSING); 
+    Ctx.ErrRpt.Error(ecON_OFF_MISSING); 
     return;
   }
 
-  DebMode = (Scn.GetToken() == tcON);
-  Scn.ReadToken();
+  DebMode = (Rdr.GetToken() == tcON);
+  Rdr.ReadToken();
 
   if (DebMode)
   {
-    printf("Debug Mode = ");
-    DebMode ? printf("ON") : printf("OFF");
-    printf("\n");
+    Ctx.Out.PutStr("Debug Mode = ");
+    DebMode ? Ctx.Out.PutStr("ON") : Ctx.Out.PutStr("OFF");
+    Ctx.Out.PutCh('\n');
+  }
+}
+//===========================================
+
+// *** NATIVE CODE ***
+//===========================================
+// Run the loop whose body begins at token loc natively, if it is hot.
+// end = loc of its NEXT or WEND, item = its stack item.
+// back_edge = true => called at the end of a pass of the loop.
+// When the native code leaves the loop, the loop is removed from its
+// stack and the executor goes on after the loop.
+
+void Parser::RunNative(int loc, int end, bool back_edge, void* item)
+{
+  int res;
+
+  JitOn = false;  // the commands run by the native code stay in the executor
+  res = Jt.Run(loc, end, back_edge, item, ForStk.GetRoom(),
+    WhileStk.GetRoom());
+  JitOn = true;
+
+  if (res < 0)  // not run, or aborted
+    return;
+
+  if (Prog->GetTokens()[end].Token == tcNEXT)
+    ForStk.Pop();
+  else
+    WhileStk.Pop();
+
+  Rdr.SetPos(res);
+  Rdr.ReadToken();
+}
+//===========================================
+// Run the command at token loc for the native code.
+// Return false if the run was aborted.
+
+bool Parser::JitStmt(int loc)
+{
+  Rdr.SetPos(loc);
+  Rdr.ReadToken();
+
+  switch (Rdr.GetToken())
+  {
+    case tcINPUT: ExecInput(); break;
+    case tcPRINT: ExecPrint<false>(); break;
+    case tcRANDOMIZE: ExecRandomize<false>(); break;
+    case tcPRECISION: ExecPrecision<false>(); break;
+    case tcMAT: ExecMat<false>(); break;
+    default: break;
   }
+
+  return !Ctx.ErrRpt.IsAborted();
+}
+//===========================================
+// Compute the expr at token loc in res for the native code.
+// Return false if the run was aborted.
+
+bool Parser::JitEval(int loc, double& res)
+{
+  Rdr.SetPos(loc);
+  Rdr.ReadToken();
+  res = EvalExpr<false>();
+  return !Ctx.ErrRpt.IsAborted();
+}
+//===========================================
+// Assign an array element for the native code, when its indexes are
+// not legal: the array assignment at token loc reports the error.
+// elem = values of the indexes and of the expr.
+// Return false if the run was aborted.
+
+bool Parser::JitSetArr(int loc, const double* elem)
+{
+  const TokItem* toks = Prog->GetTokens();
+  int arr = toks[loc].Index;
+
+  Rdr.SetPos(loc);
+  Rdr.ReadToken();  // sets the line of errors
+
+  if (toks[Prog->GetExpr(loc+2).End].Token == tcCOMMA)
+    ArrTbl.Set(arr, elem[0], elem[1], elem[2]);
+  else
+    ArrTbl.Set(arr, elem[0], elem[2]);
+
+  return !Ctx.ErrRpt.IsAborted();
 }
 //===========================================
+// Start the FOR loop at token loc for the native code, and save its
+// stack item in item.
+// Return 1 to run the loop, 0 to skip it, -1 if the run was aborted.
+
+int Parser::JitFor(int loc, ForStkItem& item)
+{
+  int depth = ForStk.GetDepth();
+
+  Rdr.SetPos(loc);
+  Rdr.ReadToken();
+  ExecFor<false>();
 
+  if (Ctx.ErrRpt.IsAborted())
+    return -1;
+
+  if (ForStk.GetDepth() == depth)  // loop skipped
+    return 0;
+
+  item = ForStk.Pop();
+  return 1;
+}
+//===========================================
@@ -7,113 +7,127 @@
 // Copyright: No copyright. You can do with this software whatever
 // you like.
 // Warranty: No warranty. Use this software at your own risk.
-//
-// Precedence Table
-// ------------------------------------------------
-// op                     level  func
-// ------------------------------------------------
-// num  var  func       8   EvalFactor()
-// ( )                        7   EvalPar()
-// un+ un-                6   EvalUnPlusMinus()
-// NOT                     5   EvalNot()
-// * / %                   4   EvalMultDivMod()
-// + -                      3   EvalAddSub()
-// < <= > >= = <>  2   EvalComp()
-// AND                     1   EvalAnd()
-// OR                       0   EvalOr()
-// ------------------------------------------------
 //===========================================
 
 #ifndef PARSER_H
 #define PARSER_H
 
 #include "SupportClasses.h"
-#include "Scanner.h"
+#include "Program.h"
+#include "Profiler.h"
+#include "Jit.h"
+
+//===========================================
+// The command executor dispatches with computed goto (labels as
+// values) where the compiler supports it, and with a switch
+// elsewhere. Define NO_COMPUTED_GOTO to force the switch.
+
+#if defined(__GNUC__) && !defined(NO_COMPUTED_GOTO)
+#define COMPUTED_GOTO
+#endif
 
 //===========================================
+// Executor of a Program.
+// A Parser holds only the state of a run: the token cursor, the vars
+// and the stacks. The Program is shared read-only, so a new run of a
+// loaded program costs a Parser and nothing more.
+
 class Parser
 {
 public:
-  Parser();
+  Parser(const Program& prog);
 
-  void Init(const char* fname);
+  bool Execute();  // entry point to command executor
 
-  void Execute();  // entry point to command executor
+  void SetProfile(bool on);
+  void SetJit(bool on)  { JitMode = on; }
+  void SetStackLimit(int limit);
+  void DispProfile(const char* fname);
+  long long GetNumCmds() const  { return Prf.GetTotalCount(); }  // profiled
 
-  void DispSource();
-  void DispTokens();
-  void DispLblTbl();
+  Context& GetContext()  { return Ctx; }
 
 private:
   const char* FindTokStr(TokCode tok);
-  TokCode FindToken(const char* str);
 
   bool IsRelOp(TokCode tok);
+  template <bool Trace>
   bool Compare(TokCode op, double opnd1, double opnd2);
-  void SkipUntilToken(TokCode tok);
-  void SkipUntilToken2(TokCode tok1, TokCode tok2);
-  void SkipUntilToken3(TokCode tok1, TokCode tok2, TokCode tok3);
+  void SkipTo(int loc);
 
   // expr calculator
-  double EvalExpr();          // entry point
-  void EvalOr();                // level 0
-  void EvalAnd();              // level 1
-  void EvalComp();           // level 2
-  void EvalAddSub();        // level 3
-  void EvalMultDivMod();   // level 4
-  void EvalNot();              // level 5
-  void EvalUnPlusMinus();  // level 6
-  void EvalPar();               // level 7
-  void EvalFactor();           // level 8
-
-  // built-in funcs
-  double EvalAbs();
-  double EvalSgn();
-  double EvalCInt();
-  double EvalFix();
-  double EvalSqr();
-  double EvalPow();
-  double EvalExp();
-  double EvalLog();
-  double EvalRnd();
+  // Trace = true => display debug info
+  template <bool Trace> double EvalExpr();  // entry point
+  template <bool Trace> double RunCode(const Instr* ip);  // bytecode VM
+
+  // debug info
+  void DispLogOp(TokCode op, double opnd1, double opnd2, double res);
+  void DispCompOp(TokCode op, double opnd1, double opnd2, bool res);
+  void DispArithOp(TokCode op, double opnd1, double opnd2, double res);
+  void DispFunc(TokCode func, double x, double y);
+  void DispArr(int arr, int dims, double i, double j, double value);
+  void DispVec(TokCode func, int arr1, int arr2, double value);
 
   // command executor
-  void ExecAssign();
-  void ExecIf();
+  template <bool Trace, bool Prof> bool Run();
+  template <bool Trace> void ExecAssign();
+  template <bool Trace> void ExecIf();
   void ExecElse();
   void ExecEndIf();
   void ExecGoto();
   void ExecGosub();
   void ExecReturn();
-  void ExecFor();
+  template <bool Trace> void ExecFor();
   void ExecNext();
-  void ExecWhile();
-  void ExecWend();
+  bool StepFor(ForStkItem& i);
+  template <bool Trace> void ExecWhile();
+  template <bool Trace> void ExecWend();
   void ExecDo();
-  void ExecUntil();
+  template <bool Trace> void ExecUntil();
   void ExecBreak();
   void ExecContinue();
   void ExecInput();
-  void ExecPrint();
-  void ExecRandomize();
-  void ExecPrecision();
+  template <bool Trace> void ExecPrint();
+  template <bool Trace> void ExecRandomize();
+  template <bool Trace> void ExecPrecision();
+  template <bool Trace> void ExecDim();
+  template <bool Trace> void ExecMat();
   void ExecDebMode();
 
+  // native code, see Jit.h
+  friend class Jit;
+  void RunNative(int loc, int end, bool back_edge, void* item);
+  bool JitStmt(int loc);
+  bool JitEval(int loc, double& res);
+  int JitFor(int loc, ForStkItem& item);
+  void SyncFor(ForStkItem& i);
+  bool JitSetArr(int loc, const double* elem);
+
 ///////////////////////////////////////////////////
 
+  const Program* Prog;  // program run, shared read-only
+  Context Ctx;  // state of the run, shared by all the members below
+  TokReader Rdr;  // cursor in the token array of Prog
   GosubStack GosubStk;
   ForStack ForStk;
   WhileStack WhileStk;
   DoStack DoStk;
-  Stack Stk;
   VarTable VarTbl;
-  Scanner Scn;
+  ArrTable ArrTbl;
+  const NumLit* NumPool;  // number literals used by the VM
 
   int Precision;  // num of decimal places to display
 
   // true => we are in debug mode (debug info displayed)
   // false => we are in regular mode (debug info not displayed)
   bool DebMode;  // debug mode on/off toggle switch
+
+  bool ProfMode;  // true => profile the run
+  Profiler Prf;  // per-line profile of the run
+
+  bool JitMode;  // true => hot loops are compiled to native code
+  bool JitOn;  // true => native code may run now
+  Jit Jt;  // native code of the run
 };
 //===========================================
 
@@ -0,0 +1,258 @@
+//===========================================
+//
+//  Profiler.cpp
+//
+// Author: Theo P. (theo_pap@otenet.gr)
+// Language used: C++
+// Copyright: No copyright. You can do with this software whatever
+// you like.
+// Warranty: No warranty. Use this software at your own risk.
+//===========================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <chrono>
+#ifndef _WIN32
+#include <sys/time.h>
+#endif
+#include "Error.h"
+#include "Misc.h"
+#include "Output.h"
+#include "Profiler.h"
+
+//===========================================
+Profiler* Profiler::Active = NULL;
+volatile sig_atomic_t Profiler::CurLine = 0;
+
+static std::chrono::steady_clock::time_point WallStart;
+static clock_t CpuStart;
+//===========================================
+Profiler::Profiler(Context* ctx)
+{
+  Ctx = ctx;
+  NumLines = 0;
+  Counts = WallSamples = CpuSamples = NULL;
+  WallSecs = CpuSecs = 0.0;
+}
+//===========================================
+Profiler::~Profiler()
+{
+  if (Active == this)
+    Stop();
+
+  delete [] Counts;
+  delete [] WallSamples;
+  delete [] CpuSamples;
+}
+//===========================================
+// Timer signal handler. Add a sample to the line being executed.
+
+void Profiler::OnSignal(int sig)
+{
+  Profiler* p = Active;
+
+  if (p == NULL)
+    return;
+
+#ifndef _WIN32
+  if (sig == SIGPROF)
+    p->CpuSamples[CurLine]++;
+  else
+    p->WallSamples[CurLine]++;
+#endif
+}
+//===========================================
+// Start profiling a program of num_lines source lines.
+
+void Profiler::Start(int num_lines)
+{
+  int i;
+
+  delete [] Counts;
+  delete [] WallSamples;
+  delete [] CpuSamples;
+
+  NumLines = num_lines;
+  Counts = new long long [NumLines+1];
+  WallSamples = new long long [NumLines+1];
+  CpuSamples = new long long [NumLines+1];
+
+  if (Counts == NULL || WallSamples == NULL || CpuSamples == NULL)
+    Ctx->ErrRpt.FatalError(ecMEM_ALLOC);
+
+  for (i = 0; i <= NumLines; i++)
+    Counts[i] = WallSamples[i] = CpuSamples[i] = 0;
+
+  CurLine = 0;  // samples before the 1st command go to line 0
+  Active = this;
+  WallStart = std::chrono::steady_clock::now();
+  CpuStart = clock();
+
+#ifndef _WIN32
+  struct sigaction sa;
+  struct itimerval tv;
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = OnSignal;
+  sa.sa_flags = SA_RESTART;  // don't break INPUT and output
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGPROF, &sa, NULL);
+  sigaction(SIGALRM, &sa, NULL);
+
+  tv.it_interval.tv_sec = 0;
+  tv.it_interval.tv_usec = PROF_SAMPLE_USEC;
+  tv.it_value = tv.it_interval;
+  setitimer(ITIMER_PROF, &tv, NULL);  // CPU time
+  setitimer(ITIMER_REAL, &tv, NULL);  // wall time
+#endif
+}
+//===========================================
+// Stop profiling.
+
+void Profiler::Stop()
+{
+#ifndef _WIN32
+  struct itimerval tv;
+
+  memset(&tv, 0, sizeof(tv));
+  setitimer(ITIMER_PROF, &tv, NULL);
+  setitimer(ITIMER_REAL, &tv, NULL);
+  signal(SIGPROF, SIG_DFL);
+  signal(SIGALRM, SIG_DFL);
+#endif
+
+  Active = NULL;
+  WallSecs = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - WallStart).count();
+  CpuSecs = double(clock() - CpuStart) / CLOCKS_PER_SEC;
+}
+//===========================================
+// Return the num of commands executed in the last run.
+
+long long Profiler::GetTotalCount() const
+{
+  long long total = 0;
+  int i;
+
+  if (Counts != NULL)
+    for (i = 0; i <= NumLines; i++)
+      total += Counts[i];
+
+  return total;
+}
+//===========================================
+// Sort order of report lines: most CPU time first, then most wall
+// time, then most commands, then line num.
+
+static const long long* SortCpu;
+static const long long* SortWall;
+static const long long* SortCounts;
+
+static int CompLines(const void* a, const void* b)
+{
+  int l1 = *(const int*) a, l2 = *(const int*) b;
+
+  if (SortCpu[l1] != SortCpu[l2])
+    return SortCpu[l1] > SortCpu[l2] ? -1 : 1;
+
+  if (SortWall[l1] != SortWall[l2])
+    return SortWall[l1] > SortWall[l2] ? -1 : 1;
+
+  if (SortCounts[l1] != SortCounts[l2])
+    return SortCounts[l1] > SortCounts[l2] ? -1 : 1;
+
+  return l1 - l2;
+}
+//===========================================
+// Display the profile report on stderr, sorted by time, and save the
+// profile to file fname, in line order.
+// File format: CSV, one row per line that was executed or sampled:
+//   line,count,wall_ms,cpu_ms
+// Line 0 holds the totals of the run: commands, measured wall and CPU
+// time.
+
+void Profiler::Report(const char* fname)
+{
+  Output rpt(2);  // stderr
+  long long total_count = 0, total_wall = 0, total_cpu = 0;
+  double wall_ms, cpu_ms;  // time per sample
+  int* lines;
+  int i, n = 0;
+  FILE* fp;
+
+  if (Counts == NULL)
+    return;
+
+  lines = new int [NumLines+1];
+
+  if (lines == NULL)
+    Ctx->ErrRpt.FatalError(ecMEM_ALLOC);
+
+  for (i = 0; i <= NumLines; i++)
+  {
+    total_count += Counts[i];
+    total_wall += WallSamples[i];
+    total_cpu += CpuSamples[i];
+
+    if (i > 0 && (Counts[i] || WallSamples[i] || CpuSamples[i]))
+      lines[n++] = i;
+  }
+
+  // the timers may fire less often than asked, so the measured total
+  // times are shared out in proportion to the samples
+  wall_ms = total_wall ? WallSecs * 1000.0 / total_wall : 0.0;
+  cpu_ms = total_cpu ? CpuSecs * 1000.0 / total_cpu : 0.0;
+
+  SortCpu = CpuSamples;
+  SortWall = WallSamples;
+  SortCounts = Counts;
+  qsort(lines, n, sizeof(int), CompLines);
+
+  rpt.PutCh('=', SCR_LINE_WIDTH);
+  rpt.PutStr("\nProfile:\n\n");
+  rpt.PutStr("Line        Count    Wall ms  Wall %     CPU ms   CPU %\n");
+  rpt.PutCh('-', 55);
+  rpt.PutCh('\n');
+
+  for (i = 0; i < n; i++)
+  {
+    int l = lines[i];
+
+    rpt.Printf("%4d  %11lld  %9.1f  %5.1f%%  %9.1f  %5.1f%%\n", l,
+      Counts[l], wall_ms * WallSamples[l],
+      total_wall ? 100.0 * WallSamples[l] / total_wall : 0.0,
+      cpu_ms * CpuSamples[l],
+      total_cpu ? 100.0 * CpuSamples[l] / total_cpu : 0.0);
+  }
+
+  rpt.Printf("\nCommands = %lld, Wall = %.3f s, CPU = %.3f s\n",
+    total_count, WallSecs, CpuSecs);
+  rpt.PutCh('=', SCR_LINE_WIDTH);
+  rpt.PutStr("\n\n");
+  delete [] lines;
+
+  if (fname == NULL)
+    return;
+
+  fp = fopen(fname, "w");
+
+  if (fp == NULL)
+  {
+    rpt.Printf("Cannot write profile file %s.\n", fname);
+    return;
+  }
+
+  fprintf(fp, "line,count,wall_ms,cpu_ms\n");
+  fprintf(fp, "0,%lld,%.3f,%.3f\n", total_count, WallSecs * 1000.0,
+    CpuSecs * 1000.0);
+
+  for (i = 1; i <= NumLines; i++)
+    if (Counts[i] || WallSamples[i] || CpuSamples[i])
+      fprintf(fp, "%d,%lld,%.3f,%.3f\n", i, Counts[i],
+        wall_ms * WallSamples[i], cpu_ms * CpuSamples[i]);
+
+  fclose(fp);
+}
+//===========================================
@@ -0,0 +1,62 @@
+//===========================================
+//
+//  Profiler.h
+//
+// Author: Theo P. (theo_pap@otenet.gr)
+// Language used: C++
+// Copyright: No copyright. You can do with this software whatever
+// you like.
+// Warranty: No warranty. Use this software at your own risk.
+//===========================================
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <signal.h>
+#include "Context.h"
+
+//===========================================
+const int PROF_SAMPLE_USEC = 1000;  // sampling interval in usecs
+//===========================================
+// Per-source-line profiler.
+// The executor counts every command it executes in the line of the
+// command. Time is measured by sampling: two interval timers, one of
+// wall time and one of CPU time, interrupt the run every
+// PROF_SAMPLE_USEC and add a sample to the line being executed.
+// Timers are process-wide, so only one profiler may run at a time.
+// Where interval timers are not available (Windows) only the counts
+// and the total times are recorded.
+
+class Profiler
+{
+public:
+  Profiler(Context* ctx);
+  ~Profiler();
+
+  void Start(int num_lines);
+  void Stop();
+
+  // count a command executed in line
+  void Count(int line)  { Counts[line]++; CurLine = line; }
+
+  long long GetTotalCount() const;
+  void Report(const char* fname);
+
+private:
+  static void OnSignal(int sig);
+
+  Context* Ctx;  // state of the interpreter run
+  int NumLines;  // num of source lines; arrays are indexed by line
+  long long* Counts;  // num of commands executed per line
+  long long* WallSamples;  // num of wall time samples per line
+  long long* CpuSamples;  // num of CPU time samples per line
+
+  double WallSecs;  // total wall time of run
+  double CpuSecs;  // total CPU time of run
+
+  static Profiler* Active;  // profiler that gets the samples
+  static volatile sig_atomic_t CurLine;  // line being executed
+};
+//===========================================
+
+#endif
@@ -0,0 +1,450 @@
+//===========================================
+//
+//  Program.cpp
+//
+// Author: Theo P. (theo_pap@otenet.gr)
+// Language used: C++
+// Copyright: No copyright. You can do with this software whatever
+// you like.
+// Warranty: No warranty. Use this software at your own risk.
+//===========================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "Error.h"
+#include "Program.h"
+
+//===========================================
+// Sections of a compiled cache file, in file order.
+
+enum CacheSection
+{
+  csTOKS,  // token array
+  csEXPRS,  // expr table
+  csNUMS,  // NumPool
+  csCODE,  // code buffer
+  csLBLS,  // label table
+  csPOOL,  // StrPool
+  csVARS,  // var name table
+  csEND  // end of file
+};
+//===========================================
+// Round n up to a multiple of 8.
+
+static size_t Align8(size_t n)
+{
+  return (n + 7) & ~size_t(7);
+}
+//===========================================
+// Compute the num of bytes len and the file offset off of every section
+// of the cache described by header hdr. off[csEND] is the file size.
+
+static void GetCacheLayout(const CacheHeader& hdr, size_t len[csEND],
+  size_t off[csEND+1])
+{
+  int s;
+
+  len[csTOKS] = size_t(hdr.NumToks) * sizeof(TokItem);
+  len[csEXPRS] = size_t(hdr.NumToks) * sizeof(ExprTblItem);
+  len[csNUMS] = size_t(hdr.NumLits) * sizeof(NumLit);
+  len[csCODE] = size_t(hdr.CodeLen) * sizeof(Instr);
+  len[csLBLS] = size_t(hdr.NumLbls) * sizeof(LblTblItem);
+  len[csPOOL] = size_t(hdr.PoolLen);
+  len[csVARS] = size_t(hdr.NumVars) * sizeof(VarName);
+
+  off[csTOKS] = Align8(sizeof(CacheHeader));
+
+  for (s = csTOKS; s < csVARS; s++)
+    off[s+1] = off[s] + Align8(len[s]);
+
+  off[csEND] = off[csVARS] + len[csVARS];
+}
+//===========================================
+// Add the len bytes at p to hash h (64-bit FNV-1a).
+// Start a new hash with h = HASH_INIT.
+
+const unsigned long long HASH_INIT = 14695981039346656037ULL;
+
+static unsigned long long Hash(unsigned long long h, const void* p,
+  size_t len)
+{
+  const unsigned char* s = (const unsigned char*) p;
+
+  while (len--)
+  {
+    h ^= *s++;
+    h *= 1099511628211ULL;
+  }
+
+  return h;
+}
+//===========================================
+// Hash the body of a cache file, i.e. what follows the header: the
+// sections data, of len bytes each, at offsets off, and the zeros
+// that PutSection() writes between them.
+
+static unsigned long long HashBody(const void* const data[csEND],
+  const size_t len[csEND], const size_t off[csEND+1])
+{
+  static const char zeros[8] = { 0 };
+  unsigned long long h = HASH_INIT;
+  int s;
+
+  for (s = csTOKS; s < csEND; s++)
+  {
+    h = Hash(h, data[s], len[s]);
+    h = Hash(h, zeros, off[s+1] - off[s] - len[s]);  // < 8 bytes
+  }
+
+  return h;
+}
+//===========================================
+// Write len bytes at p to fp at file offset off. pos is the current
+// offset of fp; the gap up to off is filled with zeros.
+// Return false on write error.
+
+static bool PutSection(FILE* fp, size_t& pos, size_t off, const void* p,
+  size_t len)
+{
+  for (; pos < off; pos++)
+    if (fputc(0, fp) == EOF)
+      return false;
+
+  if (len && fwrite(p, len, 1, fp) != 1)
+    return false;
+
+  pos += len;
+  return true;
+}
+//===========================================
+#ifdef _WIN32
+//===========================================
+// Read the file fname into memory. Return NULL on failure.
+
+static char* MapFile(const char* fname, size_t& size)
+{
+  FILE* fp = fopen(fname, "rb");
+  char* p;
+  long n;
+
+  if (fp == NULL)
+    return NULL;
+
+  fseek(fp, 0, SEEK_END);
+  n = ftell(fp);
+  rewind(fp);
+  p = n > 0 ? new char [n] : NULL;
+
+  if (p != NULL && fread(p, 1, n, fp) != size_t(n))
+  {
+    delete [] p;
+    p = NULL;
+  }
+
+  fclose(fp);
+  size = n;
+  return p;
+}
+//===========================================
+static void UnmapFile(char* p, size_t size)
+{
+  delete [] p;
+}
+//===========================================
+#else
+//===========================================
+// Map the file fname read-only into memory. Return NULL on failure.
+
+static char* MapFile(const char* fname, size_t& size)
+{
+  struct stat statbuf;
+  void* p;
+  int fd;
+
+  fd = open(fname, O_RDONLY);
+
+  if (fd < 0)
+    return NULL;
+
+  if (fstat(fd, &statbuf) < 0 || statbuf.st_size == 0)
+  {
+    close(fd);
+    return NULL;
+  }
+
+  size = statbuf.st_size;
+  p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);  // the mapping stays valid
+  return p == MAP_FAILED ? NULL : (char*) p;
+}
+//===========================================
+static void UnmapFile(char* p, size_t size)
+{
+  munmap(p, size);
+}
+//===========================================
+#endif
+//===========================================
+Program::Program() : Scn(&Ctx), Cmp(&Ctx)
+{
+  Loaded = false;
+  Cache = NULL;
+  CacheSize = 0;
+}
+//===========================================
+// The Scanner and the Compiler do not free arrays attached from the
+// cache, so it can be unmapped first.
+
+Program::~Program()
+{
+  if (Cache != NULL)
+    UnmapFile(Cache, CacheSize);
+
+  Cache = NULL;
+}
+//===========================================
+// Load the source file fname, tokenize it and compile all its exprs.
+// Errors are reported, but only a file that cannot be loaded or has
+// too many errors is refused. Return false in that case.
+// cache = true => use the compiled cache of fname if it is valid, else
+// compile and, if there were no errors, write the cache.
+
+bool Program::Load(const char* fname, bool cache)
+{
+  Loaded = false;
+
+  if (!Scn.Open(fname))
+  {
+    Ctx.Out.Flush();
+    return false;
+  }
+
+  if (cache && LoadCache(fname))  // nothing to lex or compile
+  {
+    Loaded = true;
+    return true;
+  }
+
+  if (Scn.Scan())
+    Cmp.Compile(Scn);
+
+  Ctx.Out.Flush();  // errors before the output of the runs
+
+  if (Ctx.ErrRpt.IsAborted())
+    return false;
+
+  if (cache && Ctx.ErrRpt.GetCount() == 0)
+    SaveCache(fname);
+
+  Loaded = true;
+  return true;
+}
+//===========================================
+// Fill the part of header hdr that identifies the interpreter build
+// and the source. The counts are set to 0.
+
+void Program::MakeCacheHeader(CacheHeader& hdr)
+{
+  memset(&hdr, 0, sizeof(CacheHeader));
+  memcpy(hdr.Magic, CACHE_MAGIC, sizeof(hdr.Magic));
+  hdr.Version = CACHE_VERSION;
+  hdr.NumTokCodes = tcINVALID + 1;
+  hdr.NumOpCodes = opEND + 1;
+  hdr.TokSize = sizeof(TokItem);
+  hdr.NumSize = sizeof(NumLit);
+  hdr.InstrSize = sizeof(Instr);
+  hdr.LblSize = sizeof(LblTblItem);
+  hdr.VarSize = sizeof(VarName);
+  hdr.SrcHash = Hash(HASH_INIT, Scn.GetSource(), Scn.GetSourceLen());
+  hdr.SrcLen = Scn.GetSourceLen();
+}
+//===========================================
+// Map the compiled cache of source file fname and attach its arrays
+// to the Scanner and the Compiler.
+// Return false if there is no cache, or it does not match the source
+// or the interpreter, or its body is corrupted; nothing is changed then.
+
+bool Program::LoadCache(const char* fname)
+{
+  CacheHeader hdr;
+  const CacheHeader* h;
+  const LblTblItem* lbls;
+  const TokItem* toks;
+  const void* data[csEND];
+  size_t len[csEND], off[csEND+1];
+  char name[FILENAME_MAX];
+  int i;
+
+  if (snprintf(name, FILENAME_MAX, "%s.cache", fname) >= FILENAME_MAX)
+    return false;  // name too long
+
+  Cache = MapFile(name, CacheSize);
+
+  if (Cache == NULL)
+    return false;
+
+  MakeCacheHeader(hdr);
+  h = (const CacheHeader*) Cache;
+
+  // the identification part must be equal, the counts must fit
+  if (CacheSize < sizeof(CacheHeader) ||
+    memcmp(h, &hdr, offsetof(CacheHeader, NumToks)) != 0 ||
+    h->NumToks < 1 || h->NumLits < 0 || h->CodeLen < 0 ||
+    h->NumLbls < 0 || h->NumLbls > NUM_LBLS || h->PoolLen < 0 ||
+    h->NumVars < 0)
+  {
+    UnmapFile(Cache, CacheSize);
+    Cache = NULL;
+    return false;
+  }
+
+  GetCacheLayout(*h, len, off);
+  toks = (const TokItem*) (Cache + off[csTOKS]);
+
+  for (i = csTOKS; i < csEND; i++)
+    data[i] = Cache + off[i];
+
+  // the body is attached as it is, so it must be the one written
+  if (off[csEND] > CacheSize || HashBody(data, len, off) != h->BodyHash ||
+    toks[h->NumToks-1].Token != tcEOF)
+  {
+    UnmapFile(Cache, CacheSize);
+    Cache = NULL;
+    return false;
+  }
+
+  // the arrays are used in place; nothing writes to them after load
+  Scn.Attach((TokItem*) toks, h->NumToks,
+    (NumLit*) (Cache + off[csNUMS]), h->NumLits,
+    (VarName*) (Cache + off[csVARS]), h->NumVars,
+    Cache + off[csPOOL], h->PoolLen);
+  Cmp.Attach((Instr*) (Cache + off[csCODE]), h->CodeLen,
+    (ExprTblItem*) (Cache + off[csEXPRS]));
+
+  lbls = (const LblTblItem*) (Cache + off[csLBLS]);
+
+  for (i = 0; i < h->NumLbls; i++)
+    Scn.GetLblTbl().Insert(lbls[i].Name, lbls[i].Loc, lbls[i].Line);
+
+  return true;
+}
+//===========================================
+// Write the compiled program to the cache of source file fname.
+// The cache is written to a temp file that is then renamed, so a
+// concurrent run never sees a partial cache. A cache that cannot be
+// written is skipped; the program runs all the same.
+
+void Program::SaveCache(const char* fname)
+{
+  CacheHeader hdr;
+  const void* data[csEND];
+  size_t len[csEND], off[csEND+1], pos = 0;
+  char name[FILENAME_MAX], tmp_name[FILENAME_MAX + CACHE_PID_LEN];
+  LblTable& lbl_tbl = Scn.GetLblTbl();
+  FILE* fp;
+  bool ok;
+  int i;
+
+  MakeCacheHeader(hdr);
+  hdr.NumToks = Scn.GetNumToks();
+  hdr.NumLits = Scn.GetNumLits();
+  hdr.CodeLen = Cmp.GetCodeLen();
+  hdr.NumLbls = lbl_tbl.GetNumLbls();
+  hdr.PoolLen = Scn.GetPoolLen();
+  hdr.NumVars = Scn.GetNumVars();
+  GetCacheLayout(hdr, len, off);
+
+  data[csTOKS] = Scn.GetTokens();
+  data[csEXPRS] = Cmp.GetExprTbl();
+  data[csNUMS] = Scn.GetNumPool();
+  data[csCODE] = Cmp.GetCode();
+  data[csLBLS] = lbl_tbl.GetLbls();
+  data[csPOOL] = Scn.GetStrPool();
+  data[csVARS] = Scn.GetVarNames();
+  hdr.BodyHash = HashBody(data, len, off);
+
+  if (snprintf(name, FILENAME_MAX, "%s.cache", fname) >= FILENAME_MAX ||
+    snprintf(tmp_name, sizeof(tmp_name), "%s.%d", name, int(getpid())) >=
+    int(sizeof(tmp_name)))
+    return;  // name too long
+
+  fp = fopen(tmp_name, "wb");
+
+  if (fp == NULL)
+    return;
+
+  ok = PutSection(fp, pos, 0, &hdr, sizeof(CacheHeader));
+
+  for (i = csTOKS; i < csEND && ok; i++)
+    ok = PutSection(fp, pos, off[i], data[i], len[i]);
+
+  if (fclose(fp) != 0)
+    ok = false;
+
+  if (!ok || rename(tmp_name, name) != 0)
+    remove(tmp_name);
+}
+//===========================================
+// Display the source file.
+
+void Program::DispSource()
+{
+  Scn.DispSource();
+  Ctx.Out.Flush();
+}
+//===========================================
+// Display all the tokens.
+
+void Program::DispTokens()
+{
+  Scn.DispTokens();
+  Ctx.Out.Flush();
+}
+//===========================================
+// Display label table.
+
+void Program::DispLblTbl()
+{
+  Scn.DispLblTbl();
+  Ctx.Out.Flush();
+}
+//===========================================
+// Display the compiled exprs.
+
+void Program::DispCode()
+{
+  Cmp.DispCode(Scn);
+  Ctx.Out.Flush();
+}
+//===========================================
+//===========================================
+TokReader::TokReader(Context* ctx, const Program* prog)
+{
+  Ctx = ctx;
+  Prog = prog;
+  Tokens = NULL;
+  Token = tcINVALID;
+  Pos = Cur = 0;
+}
+//===========================================
+// Go to the start of the program.
+// Must be called after the program is loaded, before the 1st read.
+
+void TokReader::Rewind()
+{
+  Tokens = Prog->GetTokens();
+  Token = tcINVALID;
+  Pos = Cur = 0;
+}
+//===========================================
@@ -0,0 +1,161 @@
+//===========================================
+//
+//  Program.h
+//
+// Author: Theo P. (theo_pap@otenet.gr)
+// Language used: C++
+// Copyright: No copyright. You can do with this software whatever
+// you like.
+// Warranty: No warranty. Use this software at your own risk.
+//===========================================
+
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#include "Context.h"
+#include "Scanner.h"
+#include "Compiler.h"
+
+//===========================================
+// *** COMPILED CACHE ***
+// Load(fname, true) keeps the compiled program in file fname.cache.
+// A later Load of the same source maps the cache into memory and uses
+// its arrays as they are, so the source is neither lexed nor compiled.
+// The cache is used only if its header has the same CACHE_VERSION,
+// num of token codes and opcodes and record sizes as the interpreter,
+// the same source hash, and a body hash that matches its arrays, so a
+// corrupted cache is compiled again. Nothing else identifies the build:
+// bump CACHE_VERSION when the meaning of a token, opcode or jump
+// changes; a new TokCode or OpCode is detected by itself.
+
+const int CACHE_VERSION = 5;  // version of the cache format, 5 = REM words
+const char CACHE_MAGIC[8] = "BASICBC";  // 1st bytes of a cache file
+const int CACHE_PID_LEN = 12;  // max len of ".pid" of a temp cache name
+//===========================================
+struct CacheHeader  // header of a compiled cache file
+{
+  char Magic[8];  // CACHE_MAGIC
+  int Version;  // CACHE_VERSION
+  int NumTokCodes;  // tcINVALID + 1
+  int NumOpCodes;  // opEND + 1
+  int TokSize;  // sizeof(TokItem)
+  int NumSize;  // sizeof(NumLit)
+  int InstrSize;  // sizeof(Instr)
+  int LblSize;  // sizeof(LblTblItem)
+  int VarSize;  // sizeof(VarName), so SrcHash is 8-byte aligned
+  unsigned long long SrcHash;  // hash of the source
+  long long SrcLen;  // num of chars in the source
+
+  // the arrays follow the header, each at an 8-byte aligned offset,
+  // in the order of the counts below
+  int NumToks;  // token array, then expr table, NumToks items each
+  int NumLits;  // NumPool
+  int CodeLen;  // code buffer
+  int NumLbls;  // label table
+  int PoolLen;  // StrPool
+  int NumVars;  // var name table, so the header size is a multiple of 8
+  unsigned long long BodyHash;  // hash of the file after the header
+};
+//===========================================
+// Compiled program image.
+// Load() reads, tokenizes and compiles a source file. After that the
+// program is read-only: the token array, the pools, the jump targets
+// and the bytecode are never changed by a run, so one Program can be
+// shared by any num of Parsers, also on different threads.
+// The Context of a Program holds the output and the errors of the
+// load only.
+
+class Program
+{
+public:
+  Program();
+  ~Program();
+
+  bool Load(const char* fname, bool cache = false);
+  bool IsLoaded() const  { return Loaded; }
+  int GetNumErrors() const  { return Ctx.ErrRpt.GetCount(); }
+
+  const TokItem* GetTokens() const  { return Scn.GetTokens(); }
+  int GetNumToks() const  { return Scn.GetNumToks(); }
+  const char* GetTokStr(int loc) const  { return Scn.GetTokStr(loc); }
+  const NumLit* GetNumPool() const  { return Scn.GetNumPool(); }
+  int GetNumVars() const  { return Scn.GetNumVars(); }
+  const char* GetVarName(int var) const  { return Scn.GetVarName(var); }
+  int GetNumLines() const  { return Scn.GetNumLines(); }
+  const char* FindTokStr(TokCode tok) const  { return Scn.FindTokStr(tok); }
+
+  // compiled expr beginning at token loc
+  const ExprTblItem& GetExpr(int loc) const  { return Cmp.GetExpr(loc); }
+  const Instr* GetCode() const  { return Cmp.GetCode(); }
+
+  void DispSource();
+  void DispTokens();
+  void DispLblTbl();
+  void DispCode();
+
+  Context& GetContext()  { return Ctx; }
+
+private:
+  void MakeCacheHeader(CacheHeader& hdr);
+  bool LoadCache(const char* fname);
+  void SaveCache(const char* fname);
+
+  Context Ctx;  // output and errors of the load
+  Scanner Scn;  // token array, pools and label table
+  Compiler Cmp;  // bytecode of the exprs
+  bool Loaded;  // true = loaded and compiled, ready to run
+
+  char* Cache;  // compiled cache in memory, NULL = none
+  size_t CacheSize;  // size of Cache
+};
+//===========================================
+//===========================================
+// Cursor of a run over the token array of a Program.
+// The Program is read-only, so every run reads the tokens through
+// its own TokReader.
+
+class TokReader
+{
+public:
+  TokReader(Context* ctx, const Program* prog);
+
+  void Rewind();
+
+  TokCode GetToken()  { return Token; }
+  const char* GetTokStr()  { return Prog->GetTokStr(Cur); }
+  int GetPos()  { return Pos; }
+  int GetCur()  { return Cur; }
+  int GetJump()  { return Tokens[Cur].Jump; }
+  int GetVarIndex()  { return Tokens[Cur].Index; }  // of VAR, ARR token
+  void SetPos(int loc)  { Pos = loc; }
+
+  TokCode ReadToken();
+
+private:
+  Context* Ctx;  // state of the interpreter run
+  const Program* Prog;  // program read
+  const TokItem* Tokens;  // token array of Prog
+  TokCode Token;  // current token code
+  int Pos;  // loc of next token to read in token array
+  int Cur;  // loc of current token in token array
+};
+//===========================================
+// Read the next token from the token array.
+// At the end of the array, tcEOF is returned over and over.
+
+inline TokCode TokReader::ReadToken()
+{
+  const TokItem& t = Tokens[Pos];
+
+  Cur = Pos;
+
+  if (t.Token != tcEOF)
+    Pos++;
+
+  Ctx->Line = t.Line;
+  Token = t.Token;
+  return Token;
+}
+//===========================================
+
+#endif
@@ -0,0 +1,369 @@
+//===========================================
+//
+//  Runtime.cpp
+//
+// Author: Theo P. (theo_pap@otenet.gr)
+// Language used: C++
+// Copyright: No copyright. You can do with this software whatever
+// you like.
+// Warranty: No warranty. Use this software at your own risk.
+//===========================================
+
+#include <stdio.h>
+#include <math.h>
+#include "Error.h"
+#include "Misc.h"
+#include "Runtime.h"
+
+//===========================================
+Runtime::Runtime() : Arrs(&Ctx),
+  ForStk(&Ctx, ecFOR_FULL, ecFOR_EMPTY, ecFOR_EMPTY2, INVALID_FOR),
+  WhileStk(&Ctx, ecWHILE_FULL, ecWHILE_EMPTY, ecWHILE_EMPTY2, INVALID_WHILE),
+  DoStk(&Ctx, ecDO_FULL, ecDO_EMPTY, ecDO_EMPTY, INVALID_DO),
+  GosubStk(&Ctx, ecGOSUB_FULL, ecGOSUB_EMPTY, ecGOSUB_EMPTY, INVALID_GOSUB)
+{
+  Precision = 0;  // by default, all numbers displayed as integers
+}
+//===========================================
+// End of the run, at END or at the end of source (end_found = false).
+// Finish as Parser::Execute() and the interpreter's main() do.
+// Return the exit code of the program.
+
+int Runtime::Finish(bool end_found)
+{
+  bool ok = false;
+
+  if (!IsAborted())
+  {
+    if (!end_found)
+      Ctx.ErrRpt.Error(ecEND_MISSING);  // no END at the end of source
+
+    Ctx.Out.Flush();
+    ok = Ctx.ErrRpt.GetCount() == 0;
+  }
+
+  Ctx.Out.PutCh('\n');
+  Ctx.Out.Flush();
+  return ok ? 0 : 1;
+}
+//===========================================
+// Report an error that the executor would report again and again, as
+// it stays on the same command, until the run is aborted.
+
+void Runtime::RepeatError(ErrCode ec)
+{
+  do
+    Ctx.ErrRpt.Error(ec);
+  while (!IsAborted());
+}
+//===========================================
+// *** OPS ***
+//===========================================
+double Runtime::DivZero()
+{
+  Ctx.ErrRpt.Error(ecDIV_ZERO);  // division by 0 is illegal
+  return 0.0;
+}
+//===========================================
+// x % y. x and y must be integers.
+
+double Runtime::Mod(double x, double y)
+{
+  if (!IsInt(x))
+  {
+    Ctx.ErrRpt.Error(ecMOD_OPND_NOT_INT);
+    x = RoundOff(x);
+  }
+
+  if (!IsInt(y))
+  {
+    Ctx.ErrRpt.Error(ecMOD_OPND_NOT_INT);
+    y = RoundOff(y);
+  }
+
+  if (int(y) == 0)
+    return DivZero();
+
+  return double(int(x) % int(y));
+}
+//===========================================
+// SQR(x). Must be x >= 0.
+
+double Runtime::Sqr(double x)
+{
+  if (x < 0.0)
+  {
+    Ctx.ErrRpt.Error(ecSQR_ARG_NEG);
+    return 0.0;
+  }
+
+  return sqrt(x);
+}
+//===========================================
+// LOG(x). Must be x > 0.
+
+double Runtime::Log(double x)
+{
+  if (x <= 0.0)
+  {
+    Ctx.ErrRpt.Error(ecLOG_ARG_NEG);
+    return 0.0;
+  }
+
+  return log(x);
+}
+//===========================================
+// POW(x, n). n must be integer >= 0.
+
+double Runtime::Pow(double x, double n)
+{
+  if (n < 0.0)
+  {
+    Ctx.ErrRpt.Error(ecEXP_NEG);
+    return 0.0;
+  }
+
+  if (!IsInt(n))
+  {
+    Ctx.ErrRpt.Error(ecEXP_NOT_INT);
+    n = RoundOff(n);
+  }
+
+  return pow(x, n);
+}
+//===========================================
+// RND(a, b). Must be: a, b = unsigned int, a < b.
+
+double Runtime::Rnd(double a, double b)
+{
+  if (a < 0.0 || b < 0.0)
+  {
+    Ctx.ErrRpt.Error(ecRND_ARG_NEG);
+    return 0.0;
+  }
+
+  if (!IsInt(a))
+  {
+    Ctx.ErrRpt.Error(ecRND_ARG_INT);
+    a = RoundOff(a);
+  }
+
+  if (!IsInt(b))
+  {
+    Ctx.ErrRpt.Error(ecRND_ARG_INT);
+    b = RoundOff(b);
+  }
+
+  if (a >= b)
+  {
+    Ctx.ErrRpt.Error(ecRND_WRONG_ARG);
+    return 0.0;
+  }
+
+  return double(int(double(Ctx.Rand()) / RND_MAX * (b - a) + a + 0.5));
+}
+//===========================================
+// *** COMMANDS ***
+//===========================================
+// INPUT [ prompt, ] var
+// prompt = NULL => default prompt. Return the value read.
+
+double Runtime::Input(const char* prompt)
+{
+  float value;
+
+  if (prompt != NULL)
+  {
+    Ctx.Out.PutStr(prompt);
+    Ctx.Out.PutCh(' ');
+  }
+  else
+    Ctx.Out.PutStr("? ");
+
+  Ctx.Out.Flush();  // the prompt must be visible before reading
+
+  if (fscanf(Ctx.In, "%f", &value) != 1)
+    value = 0.0f;
+
+  return double(value);
+}
+//===========================================
+// RANDOMIZE seed
+
+void Runtime::Randomize(double seed)
+{
+  if (seed < 0.0)
+  {
+    Ctx.ErrRpt.Error(ecRAND_ARG_NEG);
+    return;
+  }
+
+  if (!IsInt(seed))
+  {
+    Ctx.ErrRpt.Error(ecRAND_ARG_INT);
+    seed = RoundOff(seed);
+  }
+
+  Ctx.SetRandSeed((unsigned int)seed);
+}
+//===========================================
+// PRECISION prec
+
+void Runtime::SetPrecision(double prec)
+{
+  if (prec < 0.0)
+  {
+    Ctx.ErrRpt.Error(ecPREC_ARG_NEG);
+    prec = 0.0;
+  }
+
+  if (!IsInt(prec))
+  {
+    Ctx.ErrRpt.Error(ecPREC_ARG_INT);
+    prec = RoundOff(prec);
+  }
+
+  Precision = int(prec);
+}
+//===========================================
+// *** LOOPS AND SUBROUTINES ***
+//===========================================
+// FOR var = start TO end [ STEP step ]
+// var = index of counter var, loc = loc of 1st token of block.
+
+bool Runtime::For(double* vars, int var, double start, double end,
+  double step, int loc)
+{
+  ForStkItem i;
+
+  if (step == 0.0)
+  {
+    Ctx.ErrRpt.Error(ecSTEP_ZERO);  // 0 step is illegal
+    step = 1.0;
+  }
+
+  if (step > 0.0 ? start > end : start < end)
+    return false;
+
+  vars[var] = start;
+  i.Var = var;
+  i.IsInt = false;  // the int64 fields are for native code only
+  i.EndValue = end;
+  i.StepValue = step;
+  i.Loc = loc;
+  ForStk.Push(i);  // if full, the loop runs without an item
+  return true;
+}
+//===========================================
+// WHILE var op expr
+// res = result of the comparison, var = slot of var,
+// loc = loc of 1st token of block.
+
+bool Runtime::While(bool res, int var, TokCode op, double expr, int loc)
+{
+  WhileStkItem i;
+
+  if (!res)
+    return false;
+
+  if (WhileStk.IsFull())
+  {
+    Ctx.ErrRpt.Error(ecTOO_MANY_WHILE_NEST);  // too many WHILEs
+    return true;
+  }
+
+  i.Var = var;
+  i.Op = op;
+  i.Expr = expr;
+  i.Loc = loc;
+  WhileStk.Push(i);
+  return true;
+}
+//===========================================
+// DO
+// loc = loc of 1st token of block.
+
+void Runtime::Do(int loc)
+{
+  DoStkItem i;
+
+  i.Var = 0;
+  i.Op = tcINVALID;
+  i.Expr = 0.0;
+  i.Loc = loc;
+  DoStk.Push(i);
+}
+//===========================================
+// UNTIL var op expr
+// res = result of the comparison, var = slot of var.
+
+int Runtime::Until(bool res, int var, TokCode op, double expr)
+{
+  if (res)  // exit loop
+  {
+    DoStk.Pop();
+    return -1;
+  }
+
+  if (DoStk.IsFull())
+  {
+    Ctx.ErrRpt.Error(ecTOO_MANY_DO_NEST);  // too many DOs
+    return -1;
+  }
+
+  if (DoStk.IsEmpty())
+  {
+    Ctx.ErrRpt.Error(ecDO_EMPTY);
+    return -1;
+  }
+
+  DoStkItem& i = DoStk.Peek();
+
+  i.Var = var;
+  i.Op = op;
+  i.Expr = expr;
+  return i.Loc;
+}
+//===========================================
+// GOSUB label
+// loc = return loc.
+
+void Runtime::Gosub(int loc)
+{
+  GosubStk.Push(loc);
+}
+//===========================================
+// RETURN
+
+int Runtime::Return()
+{
+  return GosubStk.Pop();  // -1 if empty
+}
+//===========================================
+// BREAK
+// end = token at the end of the innermost loop.
+
+void Runtime::Break(TokCode end)
+{
+  switch (end)
+  {
+    case tcNEXT:
+      if (!ForStk.IsEmpty())
+        ForStk.Pop();
+      break;
+
+    case tcWEND:
+      if (!WhileStk.IsEmpty())
+        WhileStk.Pop();
+      break;
+
+    case tcUNTIL:
+      if (!DoStk.IsEmpty())
+        DoStk.Pop();
+      break;
+
+    default:
+      break;
+  }
+}
+//===========================================
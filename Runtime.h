@@ -0,0 +1,178 @@
+//===========================================
+//
+//  Runtime.h
+//
+// Author: Theo P. (theo_pap@otenet.gr)
+// Language used: C++
+// Copyright: No copyright. You can do with this software whatever
+// you like.
+// Warranty: No warranty. Use this software at your own risk.
+//===========================================
+
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include <math.h>
+#include "Context.h"
+#include "Misc.h"
+#include "SupportClasses.h"
+
+//===========================================
+// Support library of the C++ programs emitted by --emit-cpp.
+// The emitted program keeps the vars in a local array, one double per
+// var slot, and calls a Runtime for everything else: the output, the
+// errors, RND, the precision, the arrays and the FOR, WHILE, DO and
+// GOSUB stacks.
+// Every op and command does what the executor does, errors included,
+// so a compiled program prints exactly what the interpreter prints.
+// A loc is the loc in the token array of the BASIC program; the
+// emitted program has a label for every loc it can jump back to.
+// A compiled program needs Runtime.cpp, Context.cpp, Output.cpp,
+// Error.cpp, Misc.cpp, SupportClasses.cpp and Simd.cpp only.
+
+class Runtime
+{
+public:
+  Runtime();
+
+  void SetLine(int line)  { Ctx.Line = line; }
+  bool IsAborted() const  { return Ctx.ErrRpt.IsAborted(); }
+  int Finish(bool end_found);
+
+  // ops that can raise errors
+  double Div(double x, double y)  { return y != 0.0 ? x / y : DivZero(); }
+  double Mod(double x, double y);
+  double Sqr(double x);
+  double Log(double x);
+  double Pow(double x, double n);
+  double Rnd(double a, double b);
+
+  // ops without errors
+  static double Abs(double x)  { return x < 0.0 ? -x : x; }
+  static double Sgn(double x)  { return x < 0.0 ? -1.0 : x > 0.0 ? 1.0 : 0.0; }
+  static double CInt(double x)  { return double(RoundOff(x)); }
+  static double Fix(double x)  { return double(Trunc(x)); }
+
+  // commands
+  void PrintStr(const char* s)  { Ctx.Out.PutStr(s); }
+  void PrintCh(char ch)  { Ctx.Out.PutCh(ch); }
+  void PrintNum(double x)  { DispFloat(Ctx.Out, x, Precision); }
+  double Input(const char* prompt);
+  void Randomize(double seed);
+  void SetPrecision(double prec);
+
+  // arrays; arr = var slot of the array name
+  void InitArrays(int num_arrs)  { Arrs.Init(num_arrs); }
+  void Dim(int arr, double n)  { Arrs.Dim(arr, 1, n, 0.0); }
+  void Dim(int arr, double n, double m)  { Arrs.Dim(arr, 2, n, m); }
+  double Arr(int arr, double i)  { return Arrs.Get(arr, i); }
+  double Arr(int arr, double i, double j)  { return Arrs.Get(arr, i, j); }
+  void SetArr(int arr, double i, double value)  { Arrs.Set(arr, i, value); }
+  void SetArr(int arr, double i, double j, double value)
+    { Arrs.Set(arr, i, j, value); }
+
+  // whole-array built-ins
+  double Sum(int arr)  { return Arrs.Sum(arr); }
+  double Dot(int arr1, int arr2)  { return Arrs.Dot(arr1, arr2); }
+  double Min(int arr)  { return Arrs.Min(arr); }
+  double Max(int arr)  { return Arrs.Max(arr); }
+  void MatAdd(int dst, int arr1, int arr2)  { Arrs.Add(dst, arr1, arr2); }
+  void MatScale(int dst, int arr, double k)  { Arrs.Scale(dst, arr, k); }
+  void MatApply(int dst, int arr, TokCode func)
+    { Arrs.Apply(dst, arr, func); }
+
+  // loops and subroutines
+  // For(), While(): return false to skip the loop
+  // Next(), Wend(), Until(), Return(): return the loc to jump to, or
+  // -1 to go on after the command
+  bool For(double* vars, int var, double start, double end, double step,
+    int loc);
+  int Next(double* vars);
+  bool While(bool res, int var, TokCode op, double expr, int loc);
+  int Wend(double* vars);
+  void Do(int loc);
+  int Until(bool res, int var, TokCode op, double expr);
+  void Gosub(int loc);
+  int Return();
+  void Break(TokCode end);
+
+private:
+  double DivZero();
+  bool Compare(TokCode op, double x, double y);
+  void RepeatError(ErrCode ec);
+
+  Context Ctx;  // output, errors and RND of the run
+  int Precision;  // num of decimal places to display
+  ArrTable Arrs;  // arrays, freed with the Runtime
+
+  ForStack ForStk;
+  WhileStack WhileStk;
+  DoStack DoStk;
+  GosubStack GosubStk;
+};
+//===========================================
+// NEXT command
+// Step the loop on top of the FOR stack, as Parser::StepFor() does.
+
+inline int Runtime::Next(double* vars)
+{
+  double var_value;
+  bool skip_loop;
+
+  if (ForStk.IsEmpty())
+  {
+    RepeatError(ecNEXT_WITHOUT_FOR);
+    return -1;
+  }
+
+  ForStkItem& i = ForStk.Peek();
+  var_value = vars[i.Var] + i.StepValue;
+  skip_loop = i.StepValue > 0.0 ? var_value > i.EndValue :
+    var_value < i.EndValue;
+
+  if (skip_loop)
+  {
+    ForStk.Pop();
+    return -1;
+  }
+
+  vars[i.Var] = var_value;
+  return i.Loc;
+}
+//===========================================
+// WEND command
+
+inline int Runtime::Wend(double* vars)
+{
+  if (WhileStk.IsEmpty())
+  {
+    RepeatError(ecWEND_WITHOUT_WHILE);
+    return -1;
+  }
+
+  WhileStkItem& i = WhileStk.Peek();
+
+  if (!Compare(i.Op, vars[i.Var], i.Expr))
+  {
+    WhileStk.Pop();
+    return -1;
+  }
+
+  return i.Loc;
+}
+//===========================================
+inline bool Runtime::Compare(TokCode op, double x, double y)
+{
+  switch (op)
+  {
+    case tcLT: return x < y;
+    case tcLE: return x <= y;
+    case tcGT: return x > y;
+    case tcGE: return x >= y;
+    case tcEQ: return x == y;
+    default: return x != y;
+  }
+}
+//===========================================
+
+#endif
@@ -10,11 +10,20 @@
 //===========================================
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#ifdef _WIN32
 #include <sys\stat.h>
+#else
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 #include "Error.h"
 #include "Misc.h"
+#include "Output.h"
 #include "Scanner.h"
 
 //===========================================
@@ -24,7 +33,7 @@ struct TokTblItem  // item of TokTbl
   char Str[TOK_STR_LEN+1];  // token str
 };
 //===========================================
-TokTblItem TokTbl[] =  // token table
+constexpr TokTblItem TokTbl[] =  // token table
 {
 // logical ops
   tcOR, "OR",
@@ -61,6 +70,8 @@ TokTblItem TokTbl[] =  // token table
   tcINPUT, "INPUT",
   tcPRINT, "PRINT",
   tcRANDOMIZE, "RANDOMIZE",
+  tcDIM, "DIM",
+  tcMAT, "MAT",
 
 // built-in funcs
   tcABS, "ABS",
@@ -73,6 +84,12 @@ TokTblItem TokTbl[] =  // token table
   tcLOG, "LOG",
   tcRND, "RND",
 
+// whole-array built-in funcs
+  tcSUM, "SUM",
+  tcDOT, "DOT",
+  tcMIN, "MIN",
+  tcMAX, "MAX",
+
 // immediate commands
   tcPRECISION, "PRECISION",
   tcDEB_MODE, "DEB_MODE",
@@ -107,21 +124,181 @@ TokTblItem TokTbl[] =  // token table
   tcINVALID, ""  // terminal mark. Do not remove.
 };
 //===========================================
+// *** KEYWORD HASH TABLE ***
+//
+// The token strs are looked up through a perfect hash: the compiler
+// picks the hash seed, so that no two token strs of TokTbl share a
+// slot, and builds the table. A lookup is then one hash and one compare.
+
+const int KW_HASH_SIZE = 1024;  // num of slots, must be a power of 2
+const unsigned int KW_MAX_SEED = 4096;  // seeds tried before giving up
+
+struct KwTables  // perfect hash of TokTbl
+{
+  int Hash[KW_HASH_SIZE];  // slot -> index in TokTbl, -1 = empty
+  unsigned int Seed;  // seed of the perfect hash
+  const char* TokStr[tcINVALID+1];  // token code -> token str
+};
+//===========================================
+// Hash the token str str. Case is ignored.
+
+constexpr unsigned int KwHash(const char* str, unsigned int seed)
+{
+  unsigned int h = seed;
+  unsigned char c = 0;
+
+  while (*str)
+  {
+    c = (unsigned char)*str++;
+    h = h * 33 + (c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c);
+  }
+
+  return (h ^ (h >> 10)) & (KW_HASH_SIZE - 1);
+}
+//===========================================
+// Build the hash table and the token str table of TokTbl.
+// Seed = KW_MAX_SEED if no seed is free of collisions.
+
+constexpr KwTables MakeKwTables()
+{
+  KwTables t = {};
+  int i = 0, slot = 0;
+  bool ok = false;
+
+  for (t.Seed = 0; t.Seed < KW_MAX_SEED; t.Seed++)  // try every seed
+  {
+    for (i = 0; i < KW_HASH_SIZE; i++)
+      t.Hash[i] = -1;
+
+    ok = true;
+
+    for (i = 0; TokTbl[i].Token != tcINVALID && ok; i++)
+    {
+      slot = KwHash(TokTbl[i].Str, t.Seed);
+
+      if (t.Hash[slot] >= 0)
+        ok = false;  // collision, so try the next seed
+      else
+        t.Hash[slot] = i;
+    }
+
+    if (ok)
+      break;
+  }
+
+  for (i = 0; i <= tcINVALID; i++)
+    t.TokStr[i] = NULL;
+
+  for (i = 0; TokTbl[i].Token != tcINVALID; i++)
+    t.TokStr[TokTbl[i].Token] = TokTbl[i].Str;
+
+  return t;
+}
+//===========================================
+constexpr KwTables KwTbl = MakeKwTables();  // built by the compiler
+
+static_assert(KwTbl.Seed < KW_MAX_SEED,
+  "no perfect hash seed for TokTbl, enlarge KW_HASH_SIZE");
+//===========================================
 //===========================================
-Scanner::Scanner()
+Scanner::Scanner(Context* ctx) : LblTbl(ctx)
 {
+  Ctx = ctx;
   Source = Prog = NULL;
+  SourceLen = 0;
+#ifndef _WIN32
+  MapSize = 0;
+#endif
   Token = tcINVALID;
   TokStr[0] = 0;
-  Line = 0;
+  StrLoc = -1;
+
+  Tokens = NULL;
+  NumToks = TokSize = 0;
+  StrPool = NULL;
+  PoolLen = PoolSize = 0;
+  NumPool = NULL;
+  NumLits = NumSize = 0;
+  VarNames = NULL;
+  NumVars = VarSize = 0;
+  Pos = Cur = 0;
+  Attached = false;
+
+  for (int i = 0; i < NUM_HASH_SIZE; i++)
+    NumHash[i] = VarHash[i] = -1;
 }
 //===========================================
 Scanner::~Scanner()
 {
-  delete [] Source;
-  Source = NULL;
+  FreeSource();
+
+  if (!Attached)
+  {
+    delete [] Tokens;
+    delete [] StrPool;
+    delete [] NumPool;
+    delete [] VarNames;
+  }
+
+  Tokens = NULL;
+  StrPool = NULL;
+  NumPool = NULL;
+  VarNames = NULL;
+}
+//===========================================
+// Load the file fname into Source buffer.
+// Return false if the file cannot be loaded.
+
+bool Scanner::Open(const char* fname)
+{
+  if (fname == NULL)
+  {
+    Ctx->ErrRpt.FatalError(ecFNAME_NULL);
+    return false;
+  }
+
+  if (fname[0] == 0)
+  {
+    Ctx->ErrRpt.FatalError(ecFNAME_EMPTY);
+    return false;
+  }
+
+  return LoadSource(fname);
 }
 //===========================================
+// Tokenize the Source buffer and resolve the labels and the blocks.
+// Return false if there were too many errors.
+
+bool Scanner::Scan()
+{
+  Tokenize();
+  ScanLabels();
+  BindLabels();
+  MatchBlocks();
+  return !Ctx->ErrRpt.IsAborted();
+}
+//===========================================
+// Use the token array, NumPool, VarNames and StrPool of a compiled cache
+// instead of scanning Source. The arrays stay owned by the caller.
+
+void Scanner::Attach(TokItem* toks, int num_toks, NumLit* nums,
+  int num_lits, VarName* vars, int num_vars, char* pool, int pool_len)
+{
+  Tokens = toks;
+  NumToks = TokSize = num_toks;
+  NumPool = nums;
+  NumLits = NumSize = num_lits;
+  VarNames = vars;
+  NumVars = VarSize = num_vars;
+  StrPool = pool;
+  PoolLen = PoolSize = pool_len;
+  Pos = Cur = 0;
+  Token = tcINVALID;
+  Attached = true;
+}
+//===========================================
+#ifdef _WIN32
+//===========================================
 // Return the file size in bytes of file fp.
 
 int Scanner::GetFileSize(FILE* fp)
@@ -132,134 +309,541 @@ int Scanner::GetFileSize(FILE* fp)
   return statbuf.st_size;
 }
 //===========================================
-// Initialize the scanner. Load the file fname into Source buffer.
+// Load the file fname into a NUL-terminated Source buffer.
+// Return false on failure.
 
-void Scanner::Init(const char* fname)
+bool Scanner::LoadSource(const char* fname)
 {
   int fsize, count;
+  char* buf;
   FILE* fp;
 
-  if (fname == NULL)
-    ErrRpt.FatalError(ecFNAME_NULL);
-
-  if (fname[0] == 0)
-    ErrRpt.FatalError(ecFNAME_EMPTY);
-
   fp = fopen(fname, "rb");
 
   if (fp == NULL)
-    ErrRpt.FatalError(ecFOPEN, fname);
+  {
+    Ctx->ErrRpt.FatalError(ecFOPEN, fname);
+    return false;
+  }
 
   fsize = GetFileSize(fp);
-  Source = new char [fsize+1];
+  buf = new char [fsize+1];
 
-  if (Source == NULL)
-    ErrRpt.FatalError(ecMEM_ALLOC);
+  if (buf == NULL)
+  {
+    fclose(fp);
+    Ctx->ErrRpt.FatalError(ecMEM_ALLOC);
+    return false;
+  }
 
-  count = fread(Source, 1, fsize, fp);
-  Source[count] = 0;
+  count = fread(buf, 1, fsize, fp);
+  buf[count] = 0;
   fclose(fp);
-  FilterCR();
-  Prog = Source;
-  Line = 1;
-  ScanLabels();
+  Source = buf;
+  SourceLen = count;
+  return true;
 }
 //===========================================
-// Preprocessor scan.
-//  Scan the source for labels and insert them into the label table.
+// Free the Source buffer.
 
-void Scanner::ScanLabels()
+void Scanner::FreeSource()
 {
-  bool done = false;
+  delete [] (char*) Source;
+  Source = NULL;
+}
+//===========================================
+#else
+//===========================================
+// Map the file fname read-only into memory and use the mapping as the
+// Source buffer, so the source is never copied.
+// The lexer needs a NUL after the last char: an anonymous zero-filled
+// region one page longer than the file is reserved first, and the
+// file is mapped over its beginning. The tail of the last file page
+// and the spare page are zero, so Source is always NUL-terminated.
+// CR chars are left in place; the lexer skips them.
+// Return false on failure.
+
+bool Scanner::LoadSource(const char* fname)
+{
+  struct stat statbuf;
+  size_t fsize, page;
+  void* p;
+  int fd;
 
-  Prog = Source;
-  Line = 1;
+  fd = open(fname, O_RDONLY);
 
-  while (!done)
+  if (fd < 0)
   {
-    ReadToken();
+    Ctx->ErrRpt.FatalError(ecFOPEN, fname);
+    return false;
+  }
+
+  if (fstat(fd, &statbuf) < 0)
+  {
+    close(fd);
+    Ctx->ErrRpt.FatalError(ecFOPEN, fname);
+    return false;
+  }
 
-    switch (Token)
+  fsize = statbuf.st_size;
+  page = sysconf(_SC_PAGESIZE);
+  MapSize = (fsize / page + 1) * page;
+  p = mmap(NULL, MapSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (p == MAP_FAILED)
+  {
+    close(fd);
+    Ctx->ErrRpt.FatalError(ecMEM_ALLOC);
+    return false;
+  }
+
+  if (fsize > 0)
+  {
+    if (mmap(p, fsize, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) ==
+      MAP_FAILED)
     {
-      case tcEOF:
-        done = true;
-        break;
+      munmap(p, MapSize);
+      close(fd);
+      Ctx->ErrRpt.FatalError(ecFOPEN, fname);
+      return false;
+    }
 
-      case tcEOL:
-        break;
+    madvise(p, fsize, MADV_SEQUENTIAL);  // lexed once, front to back
+  }
 
-      case tcNUM:
-        if (LblTbl.IsFull())  // lbl table is full, so we are done
-          done = true;
-        else
-          LblTbl.Insert(TokStr, Prog, Line);
+  close(fd);  // the mapping stays valid
+  Source = (const char*) p;
+  SourceLen = fsize;
+  return true;
+}
+//===========================================
+// Unmap the Source buffer.
 
-        SkipToEOL();
-        break;
+void Scanner::FreeSource()
+{
+  if (Source != NULL)
+    munmap((void*) Source, MapSize);
 
-      // not a number => skip the rest of line and go to the next line
-      default:
-        SkipToEOL();
+  Source = NULL;
+  SourceLen = 0;
+  MapSize = 0;
+}
+//===========================================
+#endif
+//===========================================
+// Lex the whole Source buffer once into the token array.
+// The executor then walks the token array by index, so no source
+// line is ever lexed twice.
+
+void Scanner::Tokenize()
+{
+  int line;
+
+  Prog = Source;
+  Ctx->Line = 1;
+
+  do
+  {
+    line = Ctx->Line;  // line where the token begins
+    LexToken();
+    AddToken(line);
+  } while (Token != tcEOF);
+
+  Pos = Cur = 0;
+  Token = tcINVALID;
+  Ctx->Line = 1;
+}
+//===========================================
+// Append the last lexed token to the token array.
+// The str of a VAR or STR token is copied into StrPool, a NUM token
+// is interned into NumPool.
+
+void Scanner::AddToken(int line)
+{
+  TokItem* t;
+
+  if (NumToks == TokSize)  // token array is full, so grow it
+  {
+    TokSize = TokSize ? 2 * TokSize : 1024;
+    t = new TokItem [TokSize];
+
+    if (t == NULL)
+      Ctx->ErrRpt.FatalError(ecMEM_ALLOC);
+
+    if (NumToks)
+      memcpy(t, Tokens, NumToks * sizeof(TokItem));
+
+    delete [] Tokens;
+    Tokens = t;
+  }
+
+  t = &Tokens[NumToks++];
+  t->Token = Token;
+  t->Index = -1;
+  t->Line = line;
+  t->Jump = -1;
+
+  if (Token == tcNUM)
+    t->Index = InternNum(TokStr);
+  else if (Token == tcVAR || Token == tcARR)
+    t->Index = InternVar(TokStr);
+  else if (Token == tcSTR)
+    t->Index = StrLoc;  // ReadStr() put it in StrPool
+}
+//===========================================
+// Copy str into StrPool and return its offset in StrPool.
+
+int Scanner::AddStr(const char* str)
+{
+  return AddStr(str, strlen(str));
+}
+//===========================================
+// Copy the len chars at str into StrPool, as a NUL-terminated str,
+// and return its offset in StrPool.
+
+int Scanner::AddStr(const char* str, int len)
+{
+  char* p;
+  int loc;
+
+  len++;  // room for the NUL
+
+  if (PoolLen + len > PoolSize)  // str pool is full, so grow it
+  {
+    PoolSize = PoolSize ? 2 * PoolSize : 4096;
+
+    if (PoolSize < PoolLen + len)
+      PoolSize = PoolLen + len;
+
+    p = new char [PoolSize];
+
+    if (p == NULL)
+      Ctx->ErrRpt.FatalError(ecMEM_ALLOC);
+
+    if (PoolLen)
+      memcpy(p, StrPool, PoolLen);
+
+    delete [] StrPool;
+    StrPool = p;
+  }
+
+  memcpy(StrPool + PoolLen, str, len - 1);
+  StrPool[PoolLen + len - 1] = 0;
+  loc = PoolLen;
+  PoolLen += len;
+  return loc;
+}
+//===========================================
+// Append the number value to NumPool and return its index.
+// str = offset of the literal str in StrPool, -1 = no str.
+// Also used by the compiler for numbers that are not in the source.
+
+int Scanner::AddNum(double value, int str)
+{
+  NumLit* p;
+
+  if (NumLits == NumSize)  // number pool is full, so grow it
+  {
+    NumSize = NumSize ? 2 * NumSize : 256;
+    p = new NumLit [NumSize];
+
+    if (p == NULL)
+      Ctx->ErrRpt.FatalError(ecMEM_ALLOC);
+
+    if (NumLits)
+      memcpy(p, NumPool, NumLits * sizeof(NumLit));
+
+    delete [] NumPool;
+    NumPool = p;
+  }
+
+  NumPool[NumLits].Value = value;
+  NumPool[NumLits].Str = str;
+  NumPool[NumLits].Next = -1;
+  return NumLits++;
+}
+//===========================================
+// Intern the number literal str: convert it once, so that the same
+// literal str always maps to the same NumPool item.
+// Return the index of the literal in NumPool.
+
+int Scanner::InternNum(const char* str)
+{
+  unsigned int h = 0;
+  const char* p;
+  int i;
+
+  for (p = str; *p; p++)
+    h = h * 31 + *p;
+
+  h &= NUM_HASH_SIZE - 1;
+
+  for (i = NumHash[h]; i >= 0; i = NumPool[i].Next)
+    if (!strcmp(StrPool + NumPool[i].Str, str))
+      return i;  // already interned
+
+  i = AddNum(atof(str), AddStr(str));
+  NumPool[i].Next = NumHash[h];  // chain literal into hash slot
+  NumHash[h] = i;
+  return i;
+}
+//===========================================
+// Intern the var name: the same name always maps to the same slot.
+// Return the slot of the var.
+
+int Scanner::InternVar(const char* name)
+{
+  unsigned int h = 0;
+  const char* p;
+  VarName* v;
+  int i;
+
+  for (p = name; *p; p++)
+    h = h * 31 + *p;
+
+  h &= NUM_HASH_SIZE - 1;
+
+  for (i = VarHash[h]; i >= 0; i = VarNames[i].Next)
+    if (!strcmp(StrPool + VarNames[i].Str, name))
+      return i;  // already interned
+
+  if (NumVars == VarSize)  // var name table is full, so grow it
+  {
+    VarSize = VarSize ? 2 * VarSize : 64;
+    v = new VarName [VarSize];
+
+    if (v == NULL)
+      Ctx->ErrRpt.FatalError(ecMEM_ALLOC);
+
+    if (NumVars)
+      memcpy(v, VarNames, NumVars * sizeof(VarName));
+
+    delete [] VarNames;
+    VarNames = v;
+  }
+
+  VarNames[NumVars].Str = AddStr(name);
+  VarNames[NumVars].Next = VarHash[h];  // chain name into hash slot
+  VarHash[h] = NumVars;
+  return NumVars++;
+}
+//===========================================
+// Return the str of number literal i, or "" if it has no str.
+
+const char* Scanner::GetNumStr(int i) const
+{
+  return (NumPool[i].Str >= 0) ? StrPool + NumPool[i].Str : "";
+}
+//===========================================
+// Preprocessor scan.
+//  Scan the token array for labels and insert them into the label
+//  table. A label is a number at the beginning of a line.
+
+void Scanner::ScanLabels()
+{
+  bool bol = true;  // true => token is at the beginning of a line
+
+  for (int i = 0; i < NumToks; i++)
+  {
+    if (bol && Tokens[i].Token == tcNUM)
+    {
+      if (LblTbl.IsFull())  // lbl table is full, so we are done
         break;
+
+      Ctx->Line = Tokens[i].Line;
+      LblTbl.Insert(GetNumStr(Tokens[i].Index), i + 1, Ctx->Line);
     }
+
+    bol = (Tokens[i].Token == tcEOL);
   }
 
-  Prog = Source;
-  Line = 1;
+  Ctx->Line = 1;
 }
 //===========================================
-// Filter out the CR (Carriage Return) chars from the Source buffer.
+// Resolve the label of every GOTO and GOSUB once, so that a jump at
+// run time is a single loc assignment.
+// The target loc is stored in the label token following the command.
+// Undefined labels keep Jump = -1 and are reported when executed.
 
-void Scanner::FilterCR()
+void Scanner::BindLabels()
 {
-  char* s = Source;  // ptr to source char
-  char* d = s;  // ptr to destination char
+  TokItem* t;
 
-  while (*s)
+  for (int i = 0; i + 1 < NumToks; i++)
   {
-    if (*s == '\r')  // CR char => skip it
-      s++;
-    else
-    *d++ = *s++;  // any other char => copy it
+    if (Tokens[i].Token != tcGOTO && Tokens[i].Token != tcGOSUB)
+      continue;
+
+    t = &Tokens[i+1];
+
+    if (t->Token == tcNUM)
+      t->Jump = LblTbl.FindLoc(GetNumStr(t->Index));
+  }
+}
+//===========================================
+// Match the block statements, respecting nesting:
+//   IF ... [ ELSE ... ] ENDIF, FOR ... NEXT, WHILE ... WEND,
+//   DO ... UNTIL
+// and store the loc of the matching token in each opening token, so
+// that skipping a block at run time is a single jump.
+
+void Scanner::MatchBlocks()
+{
+  int* stk;  // locs of open blocks
+  int tos = 0;  // top of stk
+  int i, j, end_loc;
+  TokCode open;  // opening token of the block closed by current token
+
+  stk = new int [NumToks];
+
+  if (stk == NULL)
+    Ctx->ErrRpt.FatalError(ecMEM_ALLOC);
+
+  for (i = 0; i < NumToks; i++)
+  {
+    switch (Tokens[i].Token)
+    {
+      case tcIF:
+      case tcFOR:
+      case tcWHILE:
+      case tcDO:
+        stk[tos++] = i;
+        continue;
+
+      // BREAK and CONTINUE remember the loc of their loop for now
+      case tcBREAK:
+      case tcCONTINUE:
+        for (j = tos - 1; j >= 0; j--)
+          if (Tokens[stk[j]].Token != tcIF &&
+            Tokens[stk[j]].Token != tcELSE)
+          {
+            Tokens[i].Jump = stk[j];
+            break;
+          }
+        continue;
+
+      case tcELSE: open = tcIF; break;
+      case tcENDIF: open = tcIF; break;
+      case tcNEXT: open = tcFOR; break;
+      case tcWEND: open = tcWHILE; break;
+      case tcUNTIL: open = tcDO; break;
+
+      default:
+        continue;
+    }
+
+    // find the innermost matching block; blocks above it are unmatched
+    for (j = tos - 1; j >= 0; j--)
+      if (Tokens[stk[j]].Token == open ||
+        (open == tcIF && Tokens[stk[j]].Token == tcELSE &&
+        Tokens[i].Token == tcENDIF))
+        break;
+
+    if (j < 0)  // no matching block, so ignore the token
+      continue;
+
+    Tokens[stk[j]].Jump = i;
+    tos = j;
+
+    if (Tokens[i].Token == tcELSE)  // ELSE opens the 2nd block of IF
+      stk[tos++] = i;
   }
 
-  *d = 0;
+  delete [] stk;
+
+  // now the loop of each BREAK and CONTINUE knows its end
+  for (i = 0; i < NumToks; i++)
+    if ((Tokens[i].Token == tcBREAK || Tokens[i].Token == tcCONTINUE) &&
+      Tokens[i].Jump >= 0)
+      Tokens[i].Jump = Tokens[Tokens[i].Jump].Jump;
+
+  // an unmatched block goes to the next END, like the old skip did
+  end_loc = NumToks - 1;  // loc of tcEOF
+
+  for (i = NumToks - 1; i >= 0; i--)
+  {
+    switch (Tokens[i].Token)
+    {
+      case tcEND:
+        end_loc = i;
+        break;
+
+      case tcIF:
+      case tcELSE:
+      case tcFOR:
+      case tcWHILE:
+      case tcDO:
+      case tcBREAK:
+      case tcCONTINUE:
+        if (Tokens[i].Jump < 0)
+          Tokens[i].Jump = end_loc;
+        break;
+
+      default:
+        break;
+    }
+  }
 }
 //===========================================
 // Return token code corresponding to token string str.
 
-TokCode Scanner::FindToken(const char* str)
+TokCode Scanner::FindToken(const char* str) const
 {
-  for (int i = 0; TokTbl[i].Token != tcINVALID; i++)
-    if (!stricmp(TokTbl[i].Str, str))
-      return TokTbl[i].Token;
+  int i = KwTbl.Hash[KwHash(str, KwTbl.Seed)];
+
+  if (i >= 0 && !stricmp(TokTbl[i].Str, str))
+    return TokTbl[i].Token;
 
   return tcINVALID;  // str is not a valid token string
 }
 //===========================================
 // Return token string corresponding to token code tok.
 
-const char* Scanner::FindTokStr(TokCode tok)
+const char* Scanner::FindTokStr(TokCode tok) const
 {
-  for (int i = 0; TokTbl[i].Token != tcINVALID; i++)
-    if (TokTbl[i].Token == tok)
-      return TokTbl[i].Str;
+  if (tok < 0 || tok > tcINVALID)
+    return NULL;
+
+  return KwTbl.TokStr[tok];  // NULL => tok is not a valid token
+}
+//===========================================
+// Return the str of the token at loc.
+// For tokens without user-defined content the token table str is
+// returned, so error messages can always display the token.
+
+const char* Scanner::GetTokStr(int loc) const
+{
+  const char* s;
+
+  if (Tokens == NULL)
+    return "";
+
+  if (Tokens[loc].Token == tcNUM)
+    return GetNumStr(Tokens[loc].Index);
+
+  if (Tokens[loc].Token == tcVAR || Tokens[loc].Token == tcARR)
+    return GetVarName(Tokens[loc].Index);
 
-  return NULL;  // tok is not a valid token
+  if (Tokens[loc].Index >= 0)
+    return StrPool + Tokens[loc].Index;
+
+  s = FindTokStr(Tokens[loc].Token);
+  return s ? s : "";
 }
 //===========================================
-// Find loc in source of label name.
+// Find loc in token array of label name.
 
-char* Scanner::FindLblLoc(const char* name)
+int Scanner::FindLblLoc(const char* name)
 {
   return LblTbl.FindLoc(name);
 }
 //===========================================
-// Return true if char is a white char, i.e. space or tab.
+// Return true if char is a white char, i.e. space, tab or CR.
+// CR is white, so CR-LF line ends need no filtering.
 
 bool Scanner::IsWhite(char ch)
 {
-  return ch == ' ' || ch == '\t';
+  return ch == ' ' || ch == '\t' || ch == '\r';
 }
 //===========================================
 // Skip white chars.
@@ -280,7 +864,7 @@ void Scanner::SkipToEOL()
   if (*Prog == '\n')
   {
     Prog++;  // skip EOL
-    Line++;
+    Ctx->Line++;
   }
 }
 //===========================================
@@ -297,7 +881,7 @@ void Scanner::ReadComment()
 void Scanner::ReadEOL()
 {
   Prog++;
-  Line++;
+  Ctx->Line++;
   Token = tcEOL;
 }
 //===========================================
@@ -305,33 +889,54 @@ void Scanner::ReadEOL()
 
 void Scanner::ReadNum()
 {
-  char* p = TokStr;
+  const char* s = Prog;
+  int len;
 
   while (isdigit(*Prog))  // read the int part
-    *p++ = *Prog++;
+    Prog++;
 
   if (*Prog == '.')  // we have a decimal point
   {
-    *p++ = *Prog++;
+    Prog++;
 
     while (isdigit(*Prog))  // read the fract part
-      *p++ = *Prog++;
+      Prog++;
   }
 
-  *p = 0;
+  len = int(Prog - s);
+
+  if (len > TOK_STR_LEN)  // does not fit in TokStr
+  {
+    memcpy(TokStr, s, TOK_STR_LEN);
+    TokStr[TOK_STR_LEN] = 0;
+    Ctx->ErrRpt.Error(ecNUM_TOO_LONG, TokStr);
+    Token = tcINVALID;
+    return;
+  }
+
+  memcpy(TokStr, s, len);
+  TokStr[len] = 0;
   Token = tcNUM;
 }
 //===========================================
-// Read a str literal.
+// Read a str literal, of any length, straight into StrPool.
 
 void Scanner::ReadStr()
 {
-  char* p = TokStr;
+  const char* s;
+  char *p, *q;
 
   Prog++;  // skip "
+  s = Prog;
 
   while (*Prog != '"' && *Prog != '\n' && *Prog)
-    *p++ = *Prog++;
+    Prog++;
+
+  StrLoc = AddStr(s, int(Prog - s));
+
+  for (p = q = StrPool + StrLoc; *q; q++)  // drop the CRs of CR-LF ends
+    if (*q != '\r')
+      *p++ = *q;
 
   *p = 0;
 
@@ -342,40 +947,52 @@ void Scanner::ReadStr()
     return;
   }
 
-  ErrRpt.Error(ecQUOTE_MISSING, TokStr);  // no closing quote "
+  Ctx->ErrRpt.Error(ecQUOTE_MISSING, StrPool + StrLoc);  // no closing "
 
   if (*Prog == '\n')  // end of line
   {
     Prog++;
-    Line++;
+    Ctx->Line++;
   }
 
   Token = tcINVALID;
 }
 //===========================================
-// Read an identifier, i.e. var name, command or func name.
-// An ID must begin with an alpha char and can contain the _ char.
+// Read an identifier, i.e. var name, array name, command or func name.
+// An ID must begin with an alpha char and can contain digits and the
+// _ char. Every ID that is not a command or func name is a var name,
+// or an array name if a ( follows it.
 
 void Scanner::ReadAlpha()
 {
   char* p = TokStr;
+  int len = 0;
 
-  while (isalpha(*Prog) || *Prog == '_')
-    *p++ = toupper(*Prog++);  // make ID uppercase
+  while (isalnum(*Prog) || *Prog == '_')
+  {
+    if (len++ < TOK_STR_LEN)
+      *p++ = toupper(*Prog);  // make ID uppercase
+
+    Prog++;
+  }
 
   *p = 0;
 
-  if (strlen(TokStr) == 1)  // 1-char ID => var name
+  if (len > TOK_STR_LEN)  // too long for a var name
   {
-    Token = tcVAR;
+    Ctx->ErrRpt.Error(ecILL_VAR_NAME, TokStr);
+    Token = tcINVALID;
     return;
   }
 
   Token = FindToken(TokStr);  // look up ID in token table
 
-  // ID is not in token table, so it's not a command or func name
+  // ID is not a command or func name, so it's a var or array name
   if (Token == tcINVALID)
-    ErrRpt.Error(ecUNREC_TOKEN, TokStr);
+  {
+    SkipWhite();
+    Token = (*Prog == '(') ? tcARR : tcVAR;
+  }
 }
 //===========================================
 // Read a 1-char token.
@@ -426,15 +1043,16 @@ void Scanner::ReadOp3()
   }
 }
 //===========================================
-// Read a token from the input stream.
+// Lex a token from the Source buffer.
 
-TokCode Scanner::ReadToken()
+TokCode Scanner::LexToken()
 {
   SkipWhite();  // skip leading white chars, if any
 
   if (*Prog == 0)  // end of file
     Token = tcEOF;
-  else if (!_strnicmp(Prog, "REM", 3))  // comment
+  else if (!_strnicmp(Prog, "REM", 3) && !isalnum(Prog[3]) &&
+    Prog[3] != '_')  // comment; REMAIN etc. are names
     ReadComment();
   else if (*Prog == '\n')  // end of line
     ReadEOL();
@@ -452,7 +1070,9 @@ TokCode Scanner::ReadToken()
     ReadOp3();
   else
   {
-    ErrRpt.Error(ecUNREC_TOKEN, TokStr);  // not a valid token
+    TokStr[0] = *Prog++;  // skip the offending char
+    TokStr[1] = 0;
+    Ctx->ErrRpt.Error(ecUNREC_TOKEN, TokStr);  // not a valid token
     Token = tcINVALID;
   }
 
@@ -464,27 +1084,36 @@ TokCode Scanner::ReadToken()
 
 void Scanner::DispSource() const
 {
-  char* p = Source;
+  const char* p = Source;
   int count = 0, line = 1;  // char counter, line counter
 
-  DispCh('=', SCR_LINE_WIDTH);
-  printf("\nSource File:\n\n");
-  printf("%3d   ", line);
+  if (Source == NULL)  // no file loaded
+    return;
+
+  Ctx->Out.PutCh('=', SCR_LINE_WIDTH);
+  Ctx->Out.PutStr("\nSource File:\n\n");
+  Ctx->Out.Printf("%3d   ", line);
 
   while (*p)
   {
+    if (*p == '\r')  // CR char => skip it
+    {
+      p++;
+      continue;
+    }
+
     if (*p == '\n')
-      printf("\n%3d   ", ++line);  // EOL char
+      Ctx->Out.Printf("\n%3d   ", ++line);  // EOL char
     else
-      printf("%c", *p);  // printable char
+      Ctx->Out.PutCh(*p);  // printable char
 
     p++;
     count++;
   }
 
-  printf("\n\nLines = %d, Chars = %d\n", line, count);
-  DispCh('=', SCR_LINE_WIDTH);
-  DispCh('\n', 2);
+  Ctx->Out.Printf("\n\nLines = %d, Chars = %d\n", line, count);
+  Ctx->Out.PutCh('=', SCR_LINE_WIDTH);
+  Ctx->Out.PutCh('\n', 2);
 }
 //===========================================
 // Display all the tokens of source.
@@ -493,54 +1122,60 @@ void Scanner::DispSource() const
 void Scanner::DispTokens()
 {
   int count = 0;  // token counter
+  TokItem* t;
 
-  Prog = Source;
-  Line = 1;
+  if (Tokens == NULL)  // no file loaded
+    return;
 
-  DispCh('=', SCR_LINE_WIDTH);
-  printf("\nTokens:\n\n");
-  printf("Line  Token\n");
-  DispCh('-', SCR_LINE_WIDTH);
-  printf("\n");
+  Ctx->Out.PutCh('=', SCR_LINE_WIDTH);
+  Ctx->Out.PutStr("\nTokens:\n\n");
+  Ctx->Out.PutStr("Line  Token\n");
+  Ctx->Out.PutCh('-', SCR_LINE_WIDTH);
+  Ctx->Out.PutCh('\n');
 
-  while (ReadToken() != tcEOF)
+  for (t = Tokens; t->Token != tcEOF; t++)
   {
     count++;
 
-    switch (Token)
+    switch (t->Token)
     {
       case tcVAR:
-        printf("%3d   Token = Variable, Value = %s\n", Line, TokStr);
+        Ctx->Out.Printf("%3d   Token = Variable, Value = %s\n", t->Line,
+          GetVarName(t->Index));
+        break;
+
+      case tcARR:
+        Ctx->Out.Printf("%3d   Token = Array, Value = %s\n", t->Line,
+          GetVarName(t->Index));
         break;
 
       case tcNUM:
-        printf("%3d   Token = Number, Value = %s\n", Line, TokStr);
+        Ctx->Out.Printf("%3d   Token = Number, Value = %s\n", t->Line,
+          GetNumStr(t->Index));
         break;
 
       case tcSTR:
-        printf("%3d   Token = String, Value = %s\n", Line, TokStr);
+        Ctx->Out.Printf("%3d   Token = String, Value = %s\n", t->Line,
+          StrPool + t->Index);
         break;
 
        case tcEOL:
-        printf("%3d   Token = EOL\n", Line-1);
+        Ctx->Out.Printf("%3d   Token = EOL\n", t->Line);
         break;
 
        case tcINVALID:
-        printf("%3d   Token = Invalid\n", Line-1);
+        Ctx->Out.Printf("%3d   Token = Invalid\n", t->Line);
         break;
 
       default:  // any other token
-        printf("%3d   Token = %s\n", Line, FindTokStr(Token));
+        Ctx->Out.Printf("%3d   Token = %s\n", t->Line, FindTokStr(t->Token));
     }
   }
 
-  DispCh('-', SCR_LINE_WIDTH);
-  printf("\n\nTokens = %d\n", count);
-  DispCh('=', SCR_LINE_WIDTH);
-  DispCh('\n', 2);
-
-  Prog = Source;
-  Line = 1;
+  Ctx->Out.PutCh('-', SCR_LINE_WIDTH);
+  Ctx->Out.Printf("\n\nTokens = %d\n", count);
+  Ctx->Out.PutCh('=', SCR_LINE_WIDTH);
+  Ctx->Out.PutCh('\n', 2);
 }
 //===========================================
 // Display label table.
@@ -12,12 +12,15 @@
 #ifndef SCANNER_H
 #define SCANNER_H
 
+#include "Misc.h"
+#include "Context.h"
 #include "LblTable.h"
 
 //===========================================
 // *** CONST ***
 
 const int TOK_STR_LEN = 64;  // max token str len
+const int NUM_HASH_SIZE = 1024;  // num of hash slots of NumPool
 //===========================================
 // *** DEFINITIONS ***
 
@@ -58,6 +61,8 @@ enum TokCode  // token code
   tcINPUT,
   tcPRINT,
   tcRANDOMIZE,
+  tcDIM,
+  tcMAT,
 
 // built-in funcs
   tcABS,
@@ -70,6 +75,12 @@ enum TokCode  // token code
   tcLOG,
   tcRND,
 
+// whole-array built-in funcs
+  tcSUM,
+  tcDOT,
+  tcMIN,
+  tcMAX,
+
 // immediate commands
   tcPRECISION,
   tcDEB_MODE,
@@ -103,6 +114,7 @@ enum TokCode  // token code
 
 // tokens with user-defined content
   tcVAR,  // variable
+  tcARR,  // array name, followed by (
   tcNUM,  // number literal
   tcSTR,  // string literal
 
@@ -113,40 +125,117 @@ enum TokCode  // token code
   tcINVALID  // illegal token
 };
 //===========================================
+struct TokItem  // item of token array = pre-tokenized program image
+{
+  TokCode Token;  // token code
+  // operand index = index in NumPool for NUM, slot in var table for
+  // VAR and ARR, offset of token str in StrPool for STR, -1 for the rest
+  int Index;
+  int Line;  // line num of token in source
+  int Jump;  // jump target loc in token array, -1 = none
+};
+//===========================================
+struct NumLit  // item of number literal pool
+{
+  double Value;  // number value, converted once at load time
+  int Str;  // offset of literal str in StrPool, -1 = none
+  int Next;  // next literal in same hash slot, -1 = none
+};
+//===========================================
+// Var names are interned at load time: every distinct name gets the
+// next slot of the var table, so a run never handles names. An array
+// gets the slot of its name too, in the array table, so the var X and
+// the array X( ) are two different things.
+
+struct VarName  // item of var name table, indexed by slot
+{
+  int Str;  // offset of var name in StrPool
+  int Next;  // next name in same hash slot, -1 = none
+};
+//===========================================
+// Jump targets stored in the token array at load time:
+//   label after GOTO/GOSUB -> 1st token after the label
+//   IF -> matching ELSE or ENDIF
+//   ELSE -> matching ENDIF
+//   FOR -> matching NEXT
+//   WHILE -> matching WEND
+//   DO -> matching UNTIL
+//   BREAK, CONTINUE -> NEXT, WEND or UNTIL of the innermost loop
+// An unmatched block points to the next END, or to the end of file.
+//===========================================
 //===========================================
 class Scanner
 {
 public:
-  Scanner();
+  Scanner(Context* ctx);
   ~Scanner();
 
-  void Init(const char* fname);
+  bool Init(const char* fname)  { return Open(fname) && Scan(); }
+  bool Open(const char* fname);
+  bool Scan();
+  void Attach(TokItem* toks, int num_toks, NumLit* nums, int num_lits,
+    VarName* vars, int num_vars, char* pool, int pool_len);
 
   TokCode GetToken()  { return Token; }
-  char* GetTokStr()  { return TokStr; }
-  char* GetProg()  { return Prog; }
-  void SetProg(char* loc)  { Prog = loc; }
+  const char* GetTokStr()  { return GetTokStr(Cur); }
+  const char* GetTokStr(int loc) const;
+  int GetPos()  { return Pos; }
+  int GetCur()  { return Cur; }
+  int GetJump()  { return Tokens[Cur].Jump; }
+  TokCode GetTokenAt(int loc)  { return Tokens[loc].Token; }
+  int GetNumIndex()  { return Tokens[Cur].Index; }  // of NUM token
+  int GetVarIndex()  { return Tokens[Cur].Index; }  // of VAR, ARR token
+  const TokItem* GetTokens() const  { return Tokens; }
+  const NumLit* GetNumPool() const  { return NumPool; }
+  int GetNumLits() const  { return NumLits; }
+  const VarName* GetVarNames() const  { return VarNames; }
+  int GetNumVars() const  { return NumVars; }
+  const char* GetVarName(int var) const  { return StrPool + VarNames[var].Str; }
+  const char* GetStrPool() const  { return StrPool; }
+  int GetPoolLen() const  { return PoolLen; }
+  const char* GetSource() const  { return Source; }
+  size_t GetSourceLen() const  { return SourceLen; }
+  LblTable& GetLblTbl()  { return LblTbl; }
+
+  int AddNum(double value, int str = -1);
+  const char* GetNumStr(int i) const;
+  int GetNumToks() const  { return NumToks; }
+  int GetNumLines() const  { return NumToks ? Tokens[NumToks-1].Line : 0; }
+  void SetPos(int loc)  { Pos = loc; }
 
   TokCode ReadToken();
 
-  void SkipToEOL();
-  char* FindLblLoc(const char* name);
+  int FindLblLoc(const char* name);
 
-  TokCode FindToken(const char* str);
-  const char* FindTokStr(TokCode tok);
+  TokCode FindToken(const char* str) const;
+  const char* FindTokStr(TokCode tok) const;
 
   void DispSource() const;
   void DispTokens();
   void DispLblTbl();
 
 private:
+#ifdef _WIN32
   int GetFileSize(FILE* fp);
-  void FilterCR();
-
+#endif
+  bool LoadSource(const char* fname);
+  void FreeSource();
+
+  void Tokenize();
+  void AddToken(int line);
+  int AddStr(const char* str);
+  int AddStr(const char* str, int len);
+  int InternNum(const char* str);
+  int InternVar(const char* name);
   void ScanLabels();
+  void BindLabels();
+  void MatchBlocks();
 
   bool IsWhite(char ch);
   void SkipWhite();
+  void SkipToEOL();
+
+  TokCode LexToken();
 
   void ReadComment();
   void ReadEOL();
@@ -159,13 +248,54 @@ private:
 
 ///////////////////////////////////////////
 
-  char* Source;  // source buffer
-  char* Prog;  // current loc in source
+  Context* Ctx;  // state of the interpreter run
+  const char* Source;  // source buffer, NUL-terminated, read-only
+  size_t SourceLen;  // num of chars in Source
+  const char* Prog;  // current loc in source (used by the lexer only)
+#ifndef _WIN32
+  size_t MapSize;  // size of the memory mapping that holds Source
+#endif
   TokCode Token;  // current token code
-  char TokStr[TOK_STR_LEN+1];  // current token str
+  char TokStr[TOK_STR_LEN+1];  // str of last lexed token
+  int StrLoc;  // offset in StrPool of last lexed str literal
+
+  TokItem* Tokens;  // token array, terminated by tcEOF
+  int NumToks;  // num of tokens in token array
+  int TokSize;  // allocated size of token array
+  char* StrPool;  // strs of VAR, NUM and STR tokens
+  int PoolLen;  // num of chars used in StrPool
+  int PoolSize;  // allocated size of StrPool
+  NumLit* NumPool;  // number literals
+  int NumLits;  // num of items in NumPool
+  int NumSize;  // allocated size of NumPool
+  int NumHash[NUM_HASH_SIZE];  // 1st literal in hash slot, -1 = none
+  VarName* VarNames;  // var names, one per slot
+  int NumVars;  // num of items in VarNames = num of var slots
+  int VarSize;  // allocated size of VarNames
+  int VarHash[NUM_HASH_SIZE];  // 1st name in hash slot, -1 = none
+  int Pos;  // loc of next token to read in token array
+  int Cur;  // loc of current token in token array
+  bool Attached;  // true = the arrays belong to a compiled cache
 
   LblTable LblTbl;  // label table
 };
 //===========================================
+// Read the next token from the token array.
+// At the end of the array, tcEOF is returned over and over.
+
+inline TokCode Scanner::ReadToken()
+{
+  TokItem& t = Tokens[Pos];
+
+  Cur = Pos;
+
+  if (t.Token != tcEOF)
+    Pos++;
+
+  Ctx->Line = t.Line;
+  Token = t.Token;
+  return Token;
+}
+//===========================================
 
 #endif
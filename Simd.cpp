@@ -0,0 +1,523 @@
+//===========================================
+//
+//  Simd.cpp
+//
+// Author: Theo P. (theo_pap@otenet.gr)
+// Language used: C++
+// Copyright: No copyright. You can do with this software whatever
+// you like.
+// Warranty: No warranty. Use this software at your own risk.
+//===========================================
+
+#include <math.h>
+#include "Simd.h"
+
+// SSE2 is part of x86-64; the AVX2 kernels are compiled for AVX2 only
+// and run only if the CPU has it
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SIMD_X86
+#include <immintrin.h>
+#define AVX2_FUNC __attribute__((target("avx2")))
+#endif
+
+//===========================================
+const int SIMD_LANES = 8;  // num of partial sums, mins, maxes
+
+static SimdIsa Limit = siAVX2;  // highest set that may be used
+//===========================================
+// *** LANES ***
+//===========================================
+// Add the partial sums s[0] ... s[7], in the order of the AVX2 kernel.
+
+static double AddLanes(const double* s)
+{
+  return ((s[0] + s[4]) + (s[2] + s[6])) + ((s[1] + s[5]) + (s[3] + s[7]));
+}
+//===========================================
+static double MinLanes(const double* m)
+{
+  double res = m[0];
+
+  for (int l = 1; l < SIMD_LANES; l++)
+    if (m[l] < res)
+      res = m[l];
+
+  return res;
+}
+//===========================================
+static double MaxLanes(const double* m)
+{
+  double res = m[0];
+
+  for (int l = 1; l < SIMD_LANES; l++)
+    if (m[l] > res)
+      res = m[l];
+
+  return res;
+}
+//===========================================
+// MIN of an array shorter than SIMD_LANES, by all versions.
+
+static double MinShort(const double* x, int n)
+{
+  double res = x[0];
+
+  for (int i = 1; i < n; i++)
+    if (x[i] < res)
+      res = x[i];
+
+  return res;
+}
+//===========================================
+static double MaxShort(const double* x, int n)
+{
+  double res = x[0];
+
+  for (int i = 1; i < n; i++)
+    if (x[i] > res)
+      res = x[i];
+
+  return res;
+}
+//===========================================
+// *** PLAIN C++ ***
+//===========================================
+static double SumScalar(const double* x, int n)
+{
+  double s[SIMD_LANES] = { 0.0 };
+
+  for (int i = 0; i < n; i++)
+    s[i % SIMD_LANES] += x[i];
+
+  return AddLanes(s);
+}
+//===========================================
+static double DotScalar(const double* x, const double* y, int n)
+{
+  double s[SIMD_LANES] = { 0.0 };
+
+  for (int i = 0; i < n; i++)
+    s[i % SIMD_LANES] += x[i] * y[i];
+
+  return AddLanes(s);
+}
+//===========================================
+static double MinScalar(const double* x, int n)
+{
+  double m[SIMD_LANES];
+  int i;
+
+  if (n < SIMD_LANES)
+    return MinShort(x, n);
+
+  for (i = 0; i < SIMD_LANES; i++)
+    m[i] = x[i];
+
+  for (; i < n; i++)
+    if (x[i] < m[i % SIMD_LANES])
+      m[i % SIMD_LANES] = x[i];
+
+  return MinLanes(m);
+}
+//===========================================
+static double MaxScalar(const double* x, int n)
+{
+  double m[SIMD_LANES];
+  int i;
+
+  if (n < SIMD_LANES)
+    return MaxShort(x, n);
+
+  for (i = 0; i < SIMD_LANES; i++)
+    m[i] = x[i];
+
+  for (; i < n; i++)
+    if (x[i] > m[i % SIMD_LANES])
+      m[i % SIMD_LANES] = x[i];
+
+  return MaxLanes(m);
+}
+//===========================================
+static void ScaleScalar(double* z, const double* x, double k, int n)
+{
+  for (int i = 0; i < n; i++)
+    z[i] = x[i] * k;
+}
+//===========================================
+static void AddScalar(double* z, const double* x, const double* y, int n)
+{
+  for (int i = 0; i < n; i++)
+    z[i] = x[i] + y[i];
+}
+//===========================================
+static void SqrtScalar(double* z, const double* x, int n)
+{
+  for (int i = 0; i < n; i++)
+    z[i] = sqrt(x[i]);
+}
+//===========================================
+static const SimdKernels ScalarKernels =
+{
+  siSCALAR, "scalar", SumScalar, DotScalar, MinScalar, MaxScalar,
+  ScaleScalar, AddScalar, SqrtScalar
+};
+//===========================================
+#ifdef SIMD_X86
+//===========================================
+// *** SSE2 ***
+// 4 regs of 2 lanes each hold lanes 0-1, 2-3, 4-5, 6-7. The elements
+// left over after the last full group of 8 go to their lanes one by
+// one.
+//===========================================
+static double SumSse2(const double* x, int n)
+{
+  __m128d a0 = _mm_setzero_pd(), a1 = a0, a2 = a0, a3 = a0;
+  double s[SIMD_LANES];
+  int i;
+
+  for (i = 0; i + SIMD_LANES <= n; i += SIMD_LANES)
+  {
+    a0 = _mm_add_pd(a0, _mm_loadu_pd(x + i));
+    a1 = _mm_add_pd(a1, _mm_loadu_pd(x + i + 2));
+    a2 = _mm_add_pd(a2, _mm_loadu_pd(x + i + 4));
+    a3 = _mm_add_pd(a3, _mm_loadu_pd(x + i + 6));
+  }
+
+  _mm_storeu_pd(s, a0);
+  _mm_storeu_pd(s + 2, a1);
+  _mm_storeu_pd(s + 4, a2);
+  _mm_storeu_pd(s + 6, a3);
+
+  for (; i < n; i++)
+    s[i % SIMD_LANES] += x[i];
+
+  return AddLanes(s);
+}
+//===========================================
+static double DotSse2(const double* x, const double* y, int n)
+{
+  __m128d a0 = _mm_setzero_pd(), a1 = a0, a2 = a0, a3 = a0;
+  double s[SIMD_LANES];
+  int i;
+
+  for (i = 0; i + SIMD_LANES <= n; i += SIMD_LANES)
+  {
+    a0 = _mm_add_pd(a0, _mm_mul_pd(_mm_loadu_pd(x + i),
+      _mm_loadu_pd(y + i)));
+    a1 = _mm_add_pd(a1, _mm_mul_pd(_mm_loadu_pd(x + i + 2),
+      _mm_loadu_pd(y + i + 2)));
+    a2 = _mm_add_pd(a2, _mm_mul_pd(_mm_loadu_pd(x + i + 4),
+      _mm_loadu_pd(y + i + 4)));
+    a3 = _mm_add_pd(a3, _mm_mul_pd(_mm_loadu_pd(x + i + 6),
+      _mm_loadu_pd(y + i + 6)));
+  }
+
+  _mm_storeu_pd(s, a0);
+  _mm_storeu_pd(s + 2, a1);
+  _mm_storeu_pd(s + 4, a2);
+  _mm_storeu_pd(s + 6, a3);
+
+  for (; i < n; i++)
+    s[i % SIMD_LANES] += x[i] * y[i];
+
+  return AddLanes(s);
+}
+//===========================================
+// _mm_min_pd(x, m) = x < m ? x : m, as MinScalar() compares.
+
+static double MinSse2(const double* x, int n)
+{
+  __m128d m0, m1, m2, m3;
+  double m[SIMD_LANES];
+  int i;
+
+  if (n < SIMD_LANES)
+    return MinShort(x, n);
+
+  m0 = _mm_loadu_pd(x);
+  m1 = _mm_loadu_pd(x + 2);
+  m2 = _mm_loadu_pd(x + 4);
+  m3 = _mm_loadu_pd(x + 6);
+
+  for (i = SIMD_LANES; i + SIMD_LANES <= n; i += SIMD_LANES)
+  {
+    m0 = _mm_min_pd(_mm_loadu_pd(x + i), m0);
+    m1 = _mm_min_pd(_mm_loadu_pd(x + i + 2), m1);
+    m2 = _mm_min_pd(_mm_loadu_pd(x + i + 4), m2);
+    m3 = _mm_min_pd(_mm_loadu_pd(x + i + 6), m3);
+  }
+
+  _mm_storeu_pd(m, m0);
+  _mm_storeu_pd(m + 2, m1);
+  _mm_storeu_pd(m + 4, m2);
+  _mm_storeu_pd(m + 6, m3);
+
+  for (; i < n; i++)
+    if (x[i] < m[i % SIMD_LANES])
+      m[i % SIMD_LANES] = x[i];
+
+  return MinLanes(m);
+}
+//===========================================
+static double MaxSse2(const double* x, int n)
+{
+  __m128d m0, m1, m2, m3;
+  double m[SIMD_LANES];
+  int i;
+
+  if (n < SIMD_LANES)
+    return MaxShort(x, n);
+
+  m0 = _mm_loadu_pd(x);
+  m1 = _mm_loadu_pd(x + 2);
+  m2 = _mm_loadu_pd(x + 4);
+  m3 = _mm_loadu_pd(x + 6);
+
+  for (i = SIMD_LANES; i + SIMD_LANES <= n; i += SIMD_LANES)
+  {
+    m0 = _mm_max_pd(_mm_loadu_pd(x + i), m0);
+    m1 = _mm_max_pd(_mm_loadu_pd(x + i + 2), m1);
+    m2 = _mm_max_pd(_mm_loadu_pd(x + i + 4), m2);
+    m3 = _mm_max_pd(_mm_loadu_pd(x + i + 6), m3);
+  }
+
+  _mm_storeu_pd(m, m0);
+  _mm_storeu_pd(m + 2, m1);
+  _mm_storeu_pd(m + 4, m2);
+  _mm_storeu_pd(m + 6, m3);
+
+  for (; i < n; i++)
+    if (x[i] > m[i % SIMD_LANES])
+      m[i % SIMD_LANES] = x[i];
+
+  return MaxLanes(m);
+}
+//===========================================
+static void ScaleSse2(double* z, const double* x, double k, int n)
+{
+  __m128d kk = _mm_set1_pd(k);
+  int i;
+
+  for (i = 0; i + 2 <= n; i += 2)
+    _mm_storeu_pd(z + i, _mm_mul_pd(_mm_loadu_pd(x + i), kk));
+
+  for (; i < n; i++)
+    z[i] = x[i] * k;
+}
+//===========================================
+static void AddSse2(double* z, const double* x, const double* y, int n)
+{
+  int i;
+
+  for (i = 0; i + 2 <= n; i += 2)
+    _mm_storeu_pd(z + i, _mm_add_pd(_mm_loadu_pd(x + i),
+      _mm_loadu_pd(y + i)));
+
+  for (; i < n; i++)
+    z[i] = x[i] + y[i];
+}
+//===========================================
+static void SqrtSse2(double* z, const double* x, int n)
+{
+  int i;
+
+  for (i = 0; i + 2 <= n; i += 2)
+    _mm_storeu_pd(z + i, _mm_sqrt_pd(_mm_loadu_pd(x + i)));
+
+  for (; i < n; i++)
+    z[i] = sqrt(x[i]);
+}
+//===========================================
+static const SimdKernels Sse2Kernels =
+{
+  siSSE2, "sse2", SumSse2, DotSse2, MinSse2, MaxSse2, ScaleSse2, AddSse2,
+  SqrtSse2
+};
+//===========================================
+// *** AVX2 ***
+// 2 regs of 4 lanes each hold lanes 0-3 and 4-7.
+//===========================================
+AVX2_FUNC static double SumAvx2(const double* x, int n)
+{
+  __m256d a0 = _mm256_setzero_pd(), a1 = a0;
+  double s[SIMD_LANES];
+  int i;
+
+  for (i = 0; i + SIMD_LANES <= n; i += SIMD_LANES)
+  {
+    a0 = _mm256_add_pd(a0, _mm256_loadu_pd(x + i));
+    a1 = _mm256_add_pd(a1, _mm256_loadu_pd(x + i + 4));
+  }
+
+  _mm256_storeu_pd(s, a0);
+  _mm256_storeu_pd(s + 4, a1);
+
+  for (; i < n; i++)
+    s[i % SIMD_LANES] += x[i];
+
+  return AddLanes(s);
+}
+//===========================================
+AVX2_FUNC static double DotAvx2(const double* x, const double* y, int n)
+{
+  __m256d a0 = _mm256_setzero_pd(), a1 = a0;
+  double s[SIMD_LANES];
+  int i;
+
+  for (i = 0; i + SIMD_LANES <= n; i += SIMD_LANES)
+  {
+    a0 = _mm256_add_pd(a0, _mm256_mul_pd(_mm256_loadu_pd(x + i),
+      _mm256_loadu_pd(y + i)));
+    a1 = _mm256_add_pd(a1, _mm256_mul_pd(_mm256_loadu_pd(x + i + 4),
+      _mm256_loadu_pd(y + i + 4)));
+  }
+
+  _mm256_storeu_pd(s, a0);
+  _mm256_storeu_pd(s + 4, a1);
+
+  for (; i < n; i++)
+    s[i % SIMD_LANES] += x[i] * y[i];
+
+  return AddLanes(s);
+}
+//===========================================
+AVX2_FUNC static double MinAvx2(const double* x, int n)
+{
+  __m256d m0, m1;
+  double m[SIMD_LANES];
+  int i;
+
+  if (n < SIMD_LANES)
+    return MinShort(x, n);
+
+  m0 = _mm256_loadu_pd(x);
+  m1 = _mm256_loadu_pd(x + 4);
+
+  for (i = SIMD_LANES; i + SIMD_LANES <= n; i += SIMD_LANES)
+  {
+    m0 = _mm256_min_pd(_mm256_loadu_pd(x + i), m0);
+    m1 = _mm256_min_pd(_mm256_loadu_pd(x + i + 4), m1);
+  }
+
+  _mm256_storeu_pd(m, m0);
+  _mm256_storeu_pd(m + 4, m1);
+
+  for (; i < n; i++)
+    if (x[i] < m[i % SIMD_LANES])
+      m[i % SIMD_LANES] = x[i];
+
+  return MinLanes(m);
+}
+//===========================================
+AVX2_FUNC static double MaxAvx2(const double* x, int n)
+{
+  __m256d m0, m1;
+  double m[SIMD_LANES];
+  int i;
+
+  if (n < SIMD_LANES)
+    return MaxShort(x, n);
+
+  m0 = _mm256_loadu_pd(x);
+  m1 = _mm256_loadu_pd(x + 4);
+
+  for (i = SIMD_LANES; i + SIMD_LANES <= n; i += SIMD_LANES)
+  {
+    m0 = _mm256_max_pd(_mm256_loadu_pd(x + i), m0);
+    m1 = _mm256_max_pd(_mm256_loadu_pd(x + i + 4), m1);
+  }
+
+  _mm256_storeu_pd(m, m0);
+  _mm256_storeu_pd(m + 4, m1);
+
+  for (; i < n; i++)
+    if (x[i] > m[i % SIMD_LANES])
+      m[i % SIMD_LANES] = x[i];
+
+  return MaxLanes(m);
+}
+//===========================================
+AVX2_FUNC static void ScaleAvx2(double* z, const double* x, double k, int n)
+{
+  __m256d kk = _mm256_set1_pd(k);
+  int i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    _mm256_storeu_pd(z + i, _mm256_mul_pd(_mm256_loadu_pd(x + i), kk));
+
+  for (; i < n; i++)
+    z[i] = x[i] * k;
+}
+//===========================================
+AVX2_FUNC static void AddAvx2(double* z, const double* x, const double* y,
+  int n)
+{
+  int i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    _mm256_storeu_pd(z + i, _mm256_add_pd(_mm256_loadu_pd(x + i),
+      _mm256_loadu_pd(y + i)));
+
+  for (; i < n; i++)
+    z[i] = x[i] + y[i];
+}
+//===========================================
+AVX2_FUNC static void SqrtAvx2(double* z, const double* x, int n)
+{
+  int i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    _mm256_storeu_pd(z + i, _mm256_sqrt_pd(_mm256_loadu_pd(x + i)));
+
+  for (; i < n; i++)
+    z[i] = sqrt(x[i]);
+}
+//===========================================
+static const SimdKernels Avx2Kernels =
+{
+  siAVX2, "avx2", SumAvx2, DotAvx2, MinAvx2, MaxAvx2, ScaleAvx2, AddAvx2,
+  SqrtAvx2
+};
+//===========================================
+#endif
+//===========================================
+// *** DISPATCH ***
+//===========================================
+// Highest set of the CPU.
+
+static SimdIsa GetCpuIsa()
+{
+#ifdef SIMD_X86
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") ? siAVX2 : siSSE2;
+#else
+  return siSCALAR;
+#endif
+}
+//===========================================
+// Return the kernels of the highest set of the CPU, up to the limit.
+// The CPU is checked once; that is thread-safe, as a static local.
+
+const SimdKernels& GetSimd()
+{
+  static const SimdIsa cpu = GetCpuIsa();
+
+#ifdef SIMD_X86
+  if (cpu >= siAVX2 && Limit >= siAVX2)
+    return Avx2Kernels;
+
+  if (cpu >= siSSE2 && Limit >= siSSE2)
+    return Sse2Kernels;
+#endif
+
+  return ScalarKernels;
+}
+//===========================================
+// Use no set above isa, e.g. siSCALAR to measure the plain C++ kernels.
+// Call it before the runs begin; the threads of a batch share it.
+
+void SetSimdLimit(SimdIsa isa)
+{
+  Limit = isa;
+}
+//===========================================
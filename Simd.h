@@ -0,0 +1,51 @@
+//===========================================
+//
+//  Simd.h
+//
+// Author: Theo P. (theo_pap@otenet.gr)
+// Language used: C++
+// Copyright: No copyright. You can do with this software whatever
+// you like.
+// Warranty: No warranty. Use this software at your own risk.
+//===========================================
+
+#ifndef SIMD_H
+#define SIMD_H
+
+//===========================================
+// Kernels of the whole-array built-ins, over n >= 1 doubles.
+// Every kernel exists in three versions: AVX2, SSE2 and plain C++. The
+// best version the CPU runs is picked at the 1st call of GetSimd().
+// All versions give exactly the same results. A sum is kept in 8
+// partial sums, element i going to sum i % 8, and they are added in a
+// fixed order at the end; no FMA is used. So SUM and DOT may differ in
+// the last bits from a FOR loop that adds the elements one by one.
+// MIN and MAX compare the elements as x < min and x > max do.
+// The elementwise kernels may write z over x or y.
+
+enum SimdIsa  // instruction set of the kernels
+{
+  siSCALAR,  // plain C++, any CPU
+  siSSE2,  // x86-64
+  siAVX2  // x86-64 with AVX2
+};
+//===========================================
+struct SimdKernels  // kernels of one instruction set
+{
+  SimdIsa Isa;
+  const char* Name;  // name of Isa
+
+  double (*Sum)(const double* x, int n);
+  double (*Dot)(const double* x, const double* y, int n);
+  double (*Min)(const double* x, int n);
+  double (*Max)(const double* x, int n);
+  void (*Scale)(double* z, const double* x, double k, int n);  // x * k
+  void (*Add)(double* z, const double* x, const double* y, int n);
+  void (*Sqrt)(double* z, const double* x, int n);
+};
+//===========================================
+const SimdKernels& GetSimd();
+void SetSimdLimit(SimdIsa isa);  // use no set above isa, before any run
+//===========================================
+
+#endif
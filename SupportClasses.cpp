@@ -10,254 +10,413 @@
 //===========================================
 
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
-#include <ctype.h>
+#include <math.h>
 #include "Error.h"
 #include "Misc.h"
+#include "Simd.h"
 #include"SupportClasses.h"
 
 //===========================================
-Stack::Stack()
+template <class Item>
+FrameStack<Item>::FrameStack(Context* ctx, ErrCode full, ErrCode empty,
+  ErrCode empty2, const Item& invalid)
 {
-  for (int i = 0; i < MAX_STACK; i++)
-    Array[i] = 0.0;
+  Ctx = ctx;
+  FullErr = full;
+  EmptyErr = empty;
+  EmptyErr2 = empty2;
+  Invalid = invalid;
 
-  Tos = 0;
-}
-//===========================================
-void Stack::Push(double num)
-{
-  if (IsFull())
+  for (int k = 0; k < STK_MAX_CHUNKS; k++)
   {
-    ErrRpt.Error(ecSTK_FULL);
-    return;
+    Chunks[k] = NULL;
+    Mem[k] = NULL;
   }
 
-  Array[Tos++] = num;
+  Chunks[0] = Cur = First;
+  CurChunk = Pos = Base = HighWater = 0;
+  Limit = DEF_STK_LIMIT;
+  Room = STK_CHUNK;
 }
 //===========================================
-double Stack::Pop()
+template <class Item>
+FrameStack<Item>::~FrameStack()
 {
-  if (IsEmpty())
-  {
-    ErrRpt.Error(ecSTK_EMPTY);
-    return 0.0;
-  }
-	
-  return Array[--Tos];
+  for (int k = 1; k < STK_MAX_CHUNKS; k++)
+    delete [] Mem[k];
 }
 //===========================================
-//===========================================
-GosubStack::GosubStack()
+// Set the max num of items to limit, 1 ... STK_MAX_LIMIT, and not
+// below the current depth.
+
+template <class Item>
+void FrameStack<Item>::SetLimit(int limit)
 {
-  for (int i = 0; i < NUM_GOSUB_NEST; i++)
-    Array[i] = NULL;
+  if (limit < 1)
+    limit = 1;
+  else if (limit > STK_MAX_LIMIT)
+    limit = STK_MAX_LIMIT;
 
-  Tos = 0;
+  Limit = limit < Base + Pos ? Base + Pos : limit;
+  Room = Limit - Base < (STK_CHUNK << CurChunk) ? Limit - Base :
+    STK_CHUNK << CurChunk;
 }
 //===========================================
-void GosubStack::Push(char* loc)
+// Cur has no room: go on in the next chunk, made at its 1st use.
+// Return false if the stack is full.
+
+template <class Item>
+bool FrameStack<Item>::Grow()
 {
-  if (IsFull())
+  int size = STK_CHUNK << (CurChunk + 1);  // of next chunk
+  char* mem;
+
+  if (Base + Pos >= Limit)
   {
-    ErrRpt.Error(ecGOSUB_FULL);
-    return;
+    Ctx->ErrRpt.Error(FullErr);
+    return false;
   }
 
-  Array[Tos++] = loc;
+  if (Chunks[CurChunk+1] == NULL)
+  {
+    mem = new char [size * sizeof(Slot) + ARR_ALIGN - 1];
+
+    if (mem == NULL)
+      Ctx->ErrRpt.FatalError(ecMEM_ALLOC);
+
+    Mem[CurChunk+1] = mem;
+    Chunks[CurChunk+1] = (Slot*) (((uintptr_t) mem + ARR_ALIGN - 1) &
+      ~(uintptr_t) (ARR_ALIGN - 1));
+  }
+
+  Base += Pos;
+  Cur = Chunks[++CurChunk];
+  Pos = 0;
+  Room = Limit - Base < size ? Limit - Base : size;
+  return true;
 }
 //===========================================
-char* GosubStack::Pop()
+// Cur is empty: the top item is the last one of the chunk below.
+
+template <class Item>
+void FrameStack<Item>::Shrink()
 {
-  if (IsEmpty())
-  {
-    ErrRpt.Error(ecGOSUB_EMPTY);
-    return NULL;
-  }
+  int size = STK_CHUNK << (CurChunk - 1);  // of chunk below
 
-  return Array[--Tos];
+  Cur = Chunks[--CurChunk];
+  Base -= size;
+  Pos = Room = size;
 }
 //===========================================
+// the stacks of the executor and of Runtime
+
+template class FrameStack<int>;
+template class FrameStack<ForStkItem>;
+template class FrameStack<WhileStkItem>;
+template class FrameStack<DoStkItem>;
 //===========================================
-// Invalid FOR stack item. Used as retutn value in Pop() and Peek();
-ForStkItem fsi_INVALID = { 0, 0.0, 0.0, NULL };
+VarTable::VarTable(Context* ctx)
+{
+  Ctx = ctx;
+  Array = NULL;
+  NumVars = 0;
+}
 //===========================================
-ForStack::ForStack()
+VarTable::~VarTable()
 {
-  for (int i = 0; i < NUM_FOR_NEST; i++)
-  {
-    Array[i].Var = 0;
-    Array[i].EndValue = Array[i].StepValue = 0.0;
-    Array[i].Loc = NULL;
-  }
-
-  Tos = 0;
+  delete [] Array;
 }
 //===========================================
-void ForStack::Push(ForStkItem& i)
+// Make a var table of num_vars slots, all 0.
+// A table of the same size is kept as it is, vars and address alike.
+
+void VarTable::Init(int num_vars)
 {
-  if (IsFull())
-  {
-    ErrRpt.Error(ecFOR_FULL);
+  if (Array != NULL && num_vars == NumVars)
     return;
-  }
 
-  Array[Tos++] = i;
+  delete [] Array;
+  NumVars = num_vars;
+  Array = new double [num_vars ? num_vars : 1];
+
+  if (Array == NULL)
+    Ctx->ErrRpt.FatalError(ecMEM_ALLOC);
+
+  for (int i = 0; i < NumVars; i++)
+    Array[i] = 0.0;
+}
+//===========================================
+//===========================================
+ArrTable::ArrTable(Context* ctx)
+{
+  Ctx = ctx;
+  Array = NULL;
+  NumArrs = 0;
 }
 //===========================================
-ForStkItem& ForStack::Pop()
+ArrTable::~ArrTable()
 {
-  if (IsEmpty())
-  {
-    ErrRpt.Error(ecFOR_EMPTY);
-    return fsi_INVALID;
-  }
-
-  return Array[--Tos];
+  Free();
+  delete [] Array;
 }
 //===========================================
-ForStkItem& ForStack::Peek()
+// Make an array table of num_arrs slots, none dimensioned.
+// A table of the same size keeps its address, so the native code of a
+// previous run stays valid.
+
+void ArrTable::Init(int num_arrs)
 {
-  if (IsEmpty())
+  if (Array != NULL && num_arrs == NumArrs)
   {
-    ErrRpt.Error(ecFOR_EMPTY2);
-    return fsi_INVALID;
+    Free();
+    return;
   }
 
-  return Array[Tos-1];
+  Free();
+  delete [] Array;
+  NumArrs = num_arrs;
+  Array = new ArrItem [num_arrs ? num_arrs : 1];
+
+  if (Array == NULL)
+    Ctx->ErrRpt.FatalError(ecMEM_ALLOC);
+
+  for (int i = 0; i < NumArrs; i++)
+  {
+    Array[i].Data = NULL;
+    Array[i].Size = Array[i].Rows = Array[i].Cols = 0;
+    Array[i].Mem = NULL;
+  }
 }
 //===========================================
-//===========================================
-// Invalid WHILE stack item. Used as retutn value in Pop() and Peek();
-WhileStkItem wsi_INVALID = { 0, tcINVALID, 0.0, NULL };
-//===========================================
-WhileStack::WhileStack()
+// Release the elements of all the arrays, at the end of a run.
+
+void ArrTable::Free()
 {
-  for (int i = 0; i < NUM_WHILE_NEST; i++)
+  for (int i = 0; i < NumArrs; i++)
   {
-    Array[i].Var = 0;
-//    Array[i].Op = tcINVALID;
-    Array[i].Op = tcINVALID;
-    Array[i].Expr = 0.0;
-    Array[i].Loc = NULL;
+    delete [] Array[i].Mem;
+    Array[i].Data = NULL;
+    Array[i].Size = Array[i].Rows = Array[i].Cols = 0;
+    Array[i].Mem = NULL;
   }
-
-  Tos = 0;
 }
 //===========================================
-// Push an item on WHILE stack.
+// DIM A(n) for dims = 1, DIM A(n, m) for dims = 2.
+// The old elements of a dimensioned array are dropped.
 
-void WhileStack::Push(WhileStkItem& i)
+void ArrTable::Dim(int arr, int dims, double n, double m)
 {
-  if (IsFull())
+  ArrItem& a = Array[arr];
+  int rows, cols;
+  char* mem;
+
+  if (dims == 1)
+    m = 0.0;
+
+  // a NaN fails every compare
+  if (!(n >= 0.0 && n < ARR_MAX_SIZE && m >= 0.0 && m < ARR_MAX_SIZE))
   {
-    ErrRpt.Error(ecWHILE_FULL);
+    Ctx->ErrRpt.Error(ecDIM_SIZE);
     return;
   }
 
-  Array[Tos++] = i;
-}
-//===========================================
-// Pop an item from WHILE stack.
+  rows = int(n) + 1;
+  cols = int(m) + 1;
 
-WhileStkItem& WhileStack::Pop()
-{
-  if (IsEmpty())
+  if (double(rows) * cols > ARR_MAX_SIZE)
   {
-    ErrRpt.Error(ecWHILE_EMPTY);
-    return wsi_INVALID;;
+    Ctx->ErrRpt.Error(ecDIM_SIZE);
+    return;
   }
 
-  return Array[--Tos];
+  mem = new char [rows * cols * sizeof(double) + ARR_ALIGN - 1];
+
+  if (mem == NULL)
+    Ctx->ErrRpt.FatalError(ecMEM_ALLOC);
+
+  delete [] a.Mem;
+  a.Mem = mem;
+  a.Data = (double*) (((uintptr_t) mem + ARR_ALIGN - 1) &
+    ~(uintptr_t) (ARR_ALIGN - 1));
+  memset(a.Data, 0, rows * cols * sizeof(double));
+
+  if (dims == 1)
+  {
+    a.Size = rows;
+    a.Rows = a.Cols = 0;
+  }
+  else
+  {
+    a.Size = 0;
+    a.Rows = rows;
+    a.Cols = cols;
+  }
 }
 //===========================================
-// Get the top item from WHILE stack, without removing it.
+// Report why an index of array arr, with dims indexes, is illegal.
 
-WhileStkItem& WhileStack::Peek()
+void ArrTable::IndexError(int arr, int dims)
 {
-  if (IsEmpty())
-  {
-    ErrRpt.Error(ecWHILE_EMPTY2);
-    return wsi_INVALID;
-  }
+  const ArrItem& a = Array[arr];
 
-  return Array[Tos-1];
+  if (a.Data == NULL)
+    Ctx->ErrRpt.Error(ecARR_NOT_DIM);
+  else if ((dims == 1) != (a.Size > 0))
+    Ctx->ErrRpt.Error(ecARR_NUM_INDEX);
+  else
+    Ctx->ErrRpt.Error(ecARR_INDEX);
 }
 //===========================================
+// *** WHOLE-ARRAY BUILT-INS ***
 //===========================================
-DoStkItem dsi_INVALID = { 0, tcINVALID, 0.0, NULL };
-//===========================================
-DoStack::DoStack()
+// Return the num of elements of array arr, 0 if not dimensioned.
+
+int ArrTable::GetLen(int arr)
 {
-  for (int i = 0; i < NUM_DO_NEST; i++)
+  const ArrItem& a = Array[arr];
+
+  if (a.Data == NULL)
   {
-    Array[i].Var = 0;
-    Array[i].Op = tcINVALID;
-    Array[i].Expr = 0.0;
-    Array[i].Loc = NULL;
+    Ctx->ErrRpt.Error(ecARR_NOT_DIM);
+    return 0;
   }
 
-  Tos = 0;
+  return a.Size > 0 ? a.Size : a.Rows * a.Cols;
 }
 //===========================================
-// Push an item on DO stack.
+// Return true if arrays arr1 and arr2 are dimensioned alike.
 
-void DoStack::Push(DoStkItem& i)
+bool ArrTable::SameDims(int arr1, int arr2)
 {
-  if (IsFull())
+  const ArrItem& a = Array[arr1];
+  const ArrItem& b = Array[arr2];
+
+  if (GetLen(arr1) == 0 || GetLen(arr2) == 0)
+    return false;
+
+  if (a.Size != b.Size || a.Rows != b.Rows || a.Cols != b.Cols)
   {
-    ErrRpt.Error(ecDO_FULL);
-    return;
+    Ctx->ErrRpt.Error(ecARR_DIMS);
+    return false;
   }
 
-  Array[Tos++] = i;
+  return true;
 }
 //===========================================
-// Pop an item from DO stack.
+// SUM(A) = sum of all the elements of A
 
-DoStkItem& DoStack::Pop()
+double ArrTable::Sum(int arr)
 {
-  if (IsEmpty())
-  {
-    ErrRpt.Error(ecDO_EMPTY);
-    return dsi_INVALID;
-  }
+  int n = GetLen(arr);
 
-  return Array[--Tos];
+  return n ? GetSimd().Sum(Array[arr].Data, n) : 0.0;
 }
 //===========================================
+// DOT(A, B) = sum of A(i) * B(i), for arrays dimensioned alike
+
+double ArrTable::Dot(int arr1, int arr2)
+{
+  if (!SameDims(arr1, arr2))
+    return 0.0;
+
+  return GetSimd().Dot(Array[arr1].Data, Array[arr2].Data,
+    GetLen(arr1));
+}
 //===========================================
-VarTable::VarTable()
+// MIN(A) = smallest element of A
+
+double ArrTable::Min(int arr)
 {
-  for (int i = 0; i < NUM_VARS; i++)
-    Array[i] = 0.0;
+  int n = GetLen(arr);
+
+  return n ? GetSimd().Min(Array[arr].Data, n) : 0.0;
 }
 //===========================================
-// Set var value.
-// var = var name = A ... Z
+// MAX(A) = largest element of A
 
-void VarTable::Set(char var, double value)
+double ArrTable::Max(int arr)
 {
-  if (!isalpha(var))
-  {
-    ErrRpt.Error(ecILL_VAR_NAME);
+  int n = GetLen(arr);
+
+  return n ? GetSimd().Max(Array[arr].Data, n) : 0.0;
+}
+//===========================================
+// MAT C = A + B
+
+void ArrTable::Add(int dst, int arr1, int arr2)
+{
+  if (!SameDims(arr1, arr2) || !SameDims(dst, arr1))
     return;
-  }
 
-  Array[toupper(var) - 'A'] = value;
+  GetSimd().Add(Array[dst].Data, Array[arr1].Data, Array[arr2].Data,
+    GetLen(dst));
 }
 //===========================================
-// Get var value.
-// var = var name = A ... Z
+// MAT C = A * k
 
-double VarTable::Get(char var)
+void ArrTable::Scale(int dst, int arr, double k)
 {
-  if (!isalpha(var))
+  if (!SameDims(dst, arr))
+    return;
+
+  GetSimd().Scale(Array[dst].Data, Array[arr].Data, k, GetLen(dst));
+}
+//===========================================
+// MAT C = func(A), func = SQR, EXP or LOG.
+// The elements that are illegal args of func are reported once and
+// give 0, as the func itself does. EXP and LOG call the C library per
+// element, so they give exactly what EXP() and LOG() give.
+
+void ArrTable::Apply(int dst, int arr, TokCode func)
+{
+  const double* x = Array[arr].Data;
+  double* z = Array[dst].Data;
+  int n, i;
+  bool bad = false;
+
+  if (!SameDims(dst, arr))
+    return;
+
+  n = GetLen(dst);
+
+  switch (func)
   {
-    ErrRpt.Error(ecILL_VAR_NAME);
-    return 0.0;
-  }
+    case tcSQR:
+      for (i = 0; i < n; i++)
+        bad |= x[i] < 0.0;
+
+      if (!bad)
+      {
+        GetSimd().Sqrt(z, x, n);
+        break;
+      }
+
+      Ctx->ErrRpt.Error(ecSQR_ARG_NEG);
 
-  return Array[toupper(var) - 'A'];
+      for (i = 0; i < n; i++)
+        z[i] = x[i] < 0.0 ? 0.0 : sqrt(x[i]);
+      break;
+
+    case tcEXP:
+      for (i = 0; i < n; i++)
+        z[i] = exp(x[i]);
+      break;
+
+    case tcLOG:
+      for (i = 0; i < n; i++)
+        bad |= x[i] <= 0.0;
+
+      if (bad)
+        Ctx->ErrRpt.Error(ecLOG_ARG_NEG);
+
+      for (i = 0; i < n; i++)
+        z[i] = x[i] <= 0.0 ? 0.0 : log(x[i]);
+      break;
+
+    default:
+      break;
+  }
 }
 //===========================================
@@ -17,135 +17,298 @@
 //===========================================
 // *** CONST ***
 
-const int MAX_STACK = 100;  // stack size
-const int NUM_GOSUB_NEST = 32; // max num of gosub nesting levels
-const int NUM_FOR_NEST = 32;  // max num of FOR nesting levels
-const int NUM_WHILE_NEST = 32; // max num of WHILE nesting levels
-const int NUM_DO_NEST = 32;  // max num of DO nesting levels
-const int NUM_VARS = 26;  // num of predefined vars A ... Z
-//===========================================
-class Stack
+const int MAX_STACK = 100;  // operand stack size of expr VM
+const int STK_CHUNK = 32;  // num of items of the 1st chunk of a FrameStack
+const int STK_MAX_CHUNKS = 20;  // max num of chunks of a FrameStack
+const int STK_MAX_LIMIT = 1 << 24;  // max limit of a FrameStack
+const int DEF_STK_LIMIT = 1 << 16;  // default limit of a FrameStack
+const int ARR_MAX_SIZE = 1 << 24;  // max num of elements of an array
+const int ARR_ALIGN = 64;  // alignment of array elements, a cache line
+//===========================================
+// Size of a FrameStack slot of an item of size bytes: the next power
+// of 2, so that no item crosses a cache line.
+
+constexpr int SlotSize(int size)
+{
+  return size <= 1 ? 1 : 2 * SlotSize((size + 1) / 2);
+}
+//===========================================
+// Stack of the frames of one kind of block: GOSUB return locs, FOR,
+// WHILE or DO loops. Push() of a full stack and Pop() or Peek() of an
+// empty one report the errors given to the constructor; Pop() and
+// Peek() then return the Invalid item.
+// The 1st STK_CHUNK items are part of the stack, so most programs never
+// allocate. Past them, the stack grows by chunks, each twice as big as
+// the previous one, up to Limit items. A chunk is kept until the stack
+// is destroyed, so once the stack has been as deep as it gets, push and
+// pop never allocate, and an item never moves while it is on the stack.
+// Every chunk is aligned on a cache line and every slot on its size,
+// so a push or pop touches a single cache line.
+
+template <class Item>
+class FrameStack
 {
 public:
-  Stack();
+  FrameStack(Context* ctx, ErrCode full, ErrCode empty, ErrCode empty2,
+    const Item& invalid);
+  ~FrameStack();
 
-  bool IsEmpty() const  { return Tos == 0; }
-  bool IsFull() const  { return Tos == MAX_STACK; }
+  bool IsEmpty() const  { return Pos == 0; }
+  bool IsFull() const  { return Base + Pos == Limit; }
+  int GetDepth() const  { return Base + Pos; }
+  int GetRoom() const  { return Limit - Base - Pos; }  // num of free items
+  int GetHighWater() const  { return HighWater; }  // max depth so far
+  void SetLimit(int limit);
 
-  void Push(double num);
-  double Pop();
+  void Push(const Item& i);
+  Item& Pop();
+  Item& Peek();
 
 private:
-  double Array[MAX_STACK];
-  int Tos;
+  struct alignas(SlotSize(sizeof(Item))) Slot
+  {
+    Item I;
+  };
+
+  static_assert(sizeof(Slot) <= ARR_ALIGN,
+    "a FrameStack item must fit in a cache line");
+
+  bool Grow();
+  void Shrink();
+
+  Slot First[STK_CHUNK];  // chunk 0
+  Slot* Chunks[STK_MAX_CHUNKS];  // chunk k has STK_CHUNK << k items
+  char* Mem[STK_MAX_CHUNKS];  // memory blocks that hold the chunks
+  Slot* Cur;  // top chunk, the 1st one with room or the only one
+  int CurChunk;  // index of Cur
+  int Pos;  // num of items in Cur; 0 only if the stack is empty
+  int Room;  // num of items that fit in Cur, within Limit
+  int Base;  // num of items in the chunks below Cur
+  int Limit;  // max num of items
+  int HighWater;  // max num of items so far
+  ErrCode FullErr, EmptyErr, EmptyErr2;  // errors of Push, Pop, Peek
+  Item Invalid;  // returned by Pop() and Peek() of an empty stack
+  Context* Ctx;  // state of the interpreter run
 };
 //===========================================
+template <class Item>
+inline void FrameStack<Item>::Push(const Item& i)
+{
+  if (Pos == Room && !Grow())
+    return;
+
+  Cur[Pos++].I = i;
+
+  if (Base + Pos > HighWater)
+    HighWater = Base + Pos;
+}
 //===========================================
-class GosubStack
+// The item returned stays valid until the next Push().
+
+template <class Item>
+inline Item& FrameStack<Item>::Pop()
 {
-public:
-  GosubStack();
+  if (Pos == 0)
+  {
+    Ctx->ErrRpt.Error(EmptyErr);
+    return Invalid;
+  }
 
-  bool IsEmpty() const  { return Tos == 0; }
-  bool IsFull() const  { return Tos == NUM_GOSUB_NEST; }
+  Item& i = Cur[--Pos].I;
 
-  void Push(char* loc);
-  char* Pop();
+  if (Pos == 0 && CurChunk > 0)  // the top item is in the chunk below
+    Shrink();
 
-private:
-  char* Array[NUM_GOSUB_NEST];
-  int Tos;
-};
+  return i;
+}
 //===========================================
+template <class Item>
+inline Item& FrameStack<Item>::Peek()
+{
+  if (Pos == 0)
+  {
+    Ctx->ErrRpt.Error(EmptyErr2);
+    return Invalid;
+  }
+
+  return Cur[Pos-1].I;
+}
 //===========================================
+// A loop whose start, end and step values are all integers, and whose
+// counter stays below 2^53, is an int loop: it counts on the int64
+// fields and gives the counter var the double value of Count after each
+// step. The executor also keeps Left, the num of passes left, so a step
+// is one decrement and branch; the native code steps Count only.
+// Any other loop counts on the double fields.
+
 struct ForStkItem  // item of FOR stack
 {
-  char Var;  // counter var name
+  int Var;  // counter var slot
+  bool IsInt;  // true => int loop
   double EndValue;  // end value of counter
   double StepValue;  // step value of counter
-  char* Loc;  // loc of FOR command in source
+  long long Count;  // counter of int loop
+  long long EndCount;  // end value of int loop
+  long long StepCount;  // step value of int loop
+  long long Left;  // num of passes left of int loop, in the executor
+  int Loc;  // loc of FOR command in token array
 };
 //===========================================
-class ForStack
+struct WhileStkItem  // item of WHILE stack
 {
-public:
-  ForStack();
-
-  bool IsEmpty() const  { return Tos == 0; }
-  bool IsFull() const  { return Tos == NUM_FOR_NEST; }
-
-  void Push(ForStkItem& i);
-  ForStkItem& Pop();
-  ForStkItem& Peek();
-
-private:
-  ForStkItem Array[NUM_FOR_NEST];
-  int Tos;
+  int Var;  // control var slot
+  TokCode Op;  // relational op
+  double Expr;  // value to compare Var against
+  int Loc;  // loc of WHILE command in token array
 };
 //===========================================
-//===========================================
-struct WhileStkItem  // item of WHILE stack
+struct DoStkItem  // item of DO stack
 {
-  char Var;  // control var name
+  int Var;  // control var slot
   TokCode Op;  // relational op
   double Expr;  // value to compare Var against
-  char* Loc;  // loc of WHILE command in source
+  int Loc;  // loc of DO command in token array
 };
 //===========================================
-class WhileStack
+// items returned by Pop() and Peek() of an empty stack
+const int INVALID_GOSUB = -1;
+const ForStkItem INVALID_FOR = { 0, false, 0.0, 0.0, 0, 0, 0, 0, -1 };
+const WhileStkItem INVALID_WHILE = { 0, tcINVALID, 0.0, -1 };
+const DoStkItem INVALID_DO = { 0, tcINVALID, 0.0, -1 };
+
+typedef FrameStack<int> GosubStack;  // return locs
+typedef FrameStack<ForStkItem> ForStack;
+typedef FrameStack<WhileStkItem> WhileStack;
+typedef FrameStack<DoStkItem> DoStack;
+//===========================================
+class VarTable  // var table, one slot per var name of the program
 {
 public:
-  WhileStack();
+  VarTable(Context* ctx);
+  ~VarTable();
+
+  void Init(int num_vars);
 
-  bool IsEmpty()  { return Tos == 0; }
-  bool IsFull()  { return Tos == NUM_WHILE_NEST; }
+  // var = slot of var, given by the scanner, so it is never checked
+  double Get(int var) const  { return Array[var]; }
+  void Set(int var, double value)  { Array[var] = value; }
 
-  void Push(WhileStkItem& i);
-  WhileStkItem& Pop();
-  WhileStkItem& Peek();
+  // the vars stay at this address, native code accesses them directly
+  double* GetVars()  { return Array; }
 
 private:
-  WhileStkItem Array[NUM_WHILE_NEST];
-  int Tos;
+  double* Array;  // actual var table
+  int NumVars;  // num of slots in Array
+  Context* Ctx;  // state of the interpreter run
 };
 //===========================================
-//===========================================
-struct DoStkItem  // item of DO stack
+// DIM A(n) makes the elements A(0) ... A(n), DIM A(n, m) the elements
+// A(0, 0) ... A(n, m), row by row. The elements are one block of
+// doubles, aligned on a cache line, and all 0. An index is truncated
+// to an int, as FIX() does.
+// Size is 0 for a 2-dim array, and Rows, Cols are 0 for a 1-dim one,
+// so a single unsigned compare per index checks the num of indexes as
+// well as the index.
+
+struct ArrItem  // item of array table
 {
-  char Var;  // control var name
-  TokCode Op;  // relational op
-  double Expr;  // value to compare Var against
-  char* Loc;  // loc of DO command in source
+  double* Data;  // elements, NULL = not dimensioned
+  int Size;  // num of elements of a 1-dim array
+  int Rows;  // num of rows of a 2-dim array
+  int Cols;  // num of cols of a 2-dim array
+  char* Mem;  // memory block that holds Data
 };
 //===========================================
-class DoStack
+class ArrTable  // array table, one slot per var name of the program
 {
 public:
-  DoStack();
+  ArrTable(Context* ctx);
+  ~ArrTable();
+
+  void Init(int num_arrs);
+  void Free();
+  void Dim(int arr, int dims, double n, double m);
+
+  // arr = slot of array, given by the scanner, so it is never checked.
+  // An index out of range is reported; it reads 0 and writes nothing.
+  double Get(int arr, double i);
+  double Get(int arr, double i, double j);
+  void Set(int arr, double i, double value);
+  void Set(int arr, double i, double j, double value);
 
-  bool IsEmpty()  { return Tos == 0; }
-  bool IsFull()  { return Tos == NUM_DO_NEST; }
+  // the items stay at this address, native code accesses them directly
+  ArrItem* GetArrs()  { return Array; }
 
-  void Push(DoStkItem& i);
-  DoStkItem& Pop();
+  // whole-array built-ins, run by the SIMD kernels (see Simd.h)
+  // An illegal array is reported; a func then gives 0 and a MAT
+  // command writes nothing.
+  double Sum(int arr);
+  double Dot(int arr1, int arr2);
+  double Min(int arr);
+  double Max(int arr);
+  void Add(int dst, int arr1, int arr2);
+  void Scale(int dst, int arr, double k);
+  void Apply(int dst, int arr, TokCode func);
 
 private:
-  DoStkItem Array[NUM_DO_NEST];
-  int Tos;
+  void IndexError(int arr, int dims);
+  int GetLen(int arr);
+  bool SameDims(int arr1, int arr2);
+
+  ArrItem* Array;  // actual array table
+  int NumArrs;  // num of slots in Array
+  Context* Ctx;  // state of the interpreter run
 };
 //===========================================
+// A(i)
+
+inline double ArrTable::Get(int arr, double i)
+{
+  ArrItem& a = Array[arr];
+
+  if (i > -1.0 && i < a.Size)
+    return a.Data[int(i)];
+
+  IndexError(arr, 1);
+  return 0.0;
+}
+//===========================================
+// A(i, j)
+
+inline double ArrTable::Get(int arr, double i, double j)
+{
+  ArrItem& a = Array[arr];
+
+  if (i > -1.0 && i < a.Rows && j > -1.0 && j < a.Cols)
+    return a.Data[int(i) * a.Cols + int(j)];
+
+  IndexError(arr, 2);
+  return 0.0;
+}
 //===========================================
-class VarTable  // predefined variables table
+// A(i) = value
+
+inline void ArrTable::Set(int arr, double i, double value)
 {
-public:
-  VarTable();
+  ArrItem& a = Array[arr];
 
-  void Set(char var, double value);
-  double Get(char var);
+  if (i > -1.0 && i < a.Size)
+    a.Data[int(i)] = value;
+  else
+    IndexError(arr, 1);
+}
+//===========================================
+// A(i, j) = value
 
-private:
-  double Array[NUM_VARS];  // actual var table
-};
+inline void ArrTable::Set(int arr, double i, double j, double value)
+{
+  ArrItem& a = Array[arr];
+
+  if (i > -1.0 && i < a.Rows && j > -1.0 && j < a.Cols)
+    a.Data[int(i) * a.Cols + int(j)] = value;
+  else
+    IndexError(arr, 2);
+}
 //===========================================
 
 #endif
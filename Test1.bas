@@ -7,10 +7,9 @@ PRECISION 2
 REM Testing the assignment op.
 a = 2.8
 PRINT "A =", A
-PRINT "This is incorrent. It should be A = 2.80."
 PRINT
 
-REM Testing the expression calulator.
+REM Testing the expression calculator.
 DEB_MODE ON
 PRINT
 PRINT "Calculating arithmetic expression: A = (2+3)*7/2-5"
@@ -0,0 +1,39 @@
+REM ArrayLoop.bas
+REM The work of ArrayOps.bas done by FOR loops, one element at a time.
+
+PRECISION 6
+N = 99999
+DIM A(N), B(N), C(N)
+FOR I = 0 TO N
+  A(I) = (I % 1000) / 1000
+  B(I) = 1 + I / N
+NEXT
+S = 0
+FOR K = 1 TO 50
+  FOR I = 0 TO N
+    C(I) = A(I) + B(I)
+  NEXT
+  FOR I = 0 TO N
+    C(I) = C(I) * 0.5
+  NEXT
+  FOR I = 0 TO N
+    C(I) = SQR(C(I))
+  NEXT
+  T = 0
+  D = 0
+  LO = C(0)
+  HI = C(0)
+  FOR I = 0 TO N
+    T = T + C(I)
+    D = D + A(I) * C(I)
+    IF C(I) < LO THEN
+      LO = C(I)
+    ENDIF
+    IF C(I) > HI THEN
+      HI = C(I)
+    ENDIF
+  NEXT
+  S = S + T + D + LO + HI
+NEXT
+PRINT "S =", S
+END
@@ -0,0 +1,20 @@
+REM ArrayOps.bas
+REM Whole-array built-ins on 100000 elements; ArrayLoop.bas does the
+REM same work by FOR loops.
+
+PRECISION 6
+N = 99999
+DIM A(N), B(N), C(N)
+FOR I = 0 TO N
+  A(I) = (I % 1000) / 1000
+  B(I) = 1 + I / N
+NEXT
+S = 0
+FOR K = 1 TO 50
+  MAT C = A + B
+  MAT C = C * 0.5
+  MAT C = SQR(C)
+  S = S + SUM(C) + DOT(A, C) + MIN(C) + MAX(C)
+NEXT
+PRINT "S =", S
+END
@@ -0,0 +1,255 @@
+//===========================================
+//
+//  BasBench.cpp
+//
+// Author: Theo P. (theo_pap@otenet.gr)
+// Language used: C++
+// Copyright: No copyright. You can do with this software whatever
+// you like.
+// Warranty: No warranty. Use this software at your own risk.
+//
+// Benchmark harness of the interpreter.
+// Runs every BASIC workload of the bench directory several times and
+// reports, in JSON on stdout, the num of commands executed, the run
+// time, commands/s, ns/command and the peak RSS of every workload.
+//
+// Every run is done in a child process, so the peak RSS is the one of
+// that workload alone. The 1st run of a workload is a profiled run
+// that counts the commands executed; it is not timed. The timed runs
+// follow, with the program output sent to /dev/null.
+// The run time reported is the median of the timed runs; it covers
+// the execution only, not the load and compile of the source.
+// A statement is a command dispatched by the executor, as counted by
+// the profiler; the end of every line executed counts as one too.
+//
+// Build from the bench directory:
+//   g++ -std=c++17 -O2 -I.. -o BasBench BasBench.cpp ../[A-HJ-Z]*.cpp
+// (Interpreter.cpp is left out, it has its own main.)
+// Run from the bench directory:
+//   BasBench [-n runs] [-i] [-s] [file_name ...]
+// With no file names, all the workloads below are run.
+// -i runs in the interpreter only, without native code for hot loops.
+// -s runs the whole-array built-ins by their plain C++ kernels, without
+// SIMD instructions. ArrayOps.bas and ArrayLoop.bas do the same work,
+// by the built-ins and by FOR loops, to compare the two.
+//===========================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "Parser.h"
+#include "Simd.h"
+
+//===========================================
+const int BENCH_FORMAT = 2;  // version of the JSON format
+const int DEF_RUNS = 5;  // default num of timed runs per workload
+const int MAX_RUNS = 100;  // max num of timed runs per workload
+
+bool JitMode = true;  // false = -i, interpreter only
+
+const char* Workloads[] =  // default workloads
+{
+  "ForLoop.bas",  // tight FOR loops
+  "Gosub.bas",  // deep GOSUB recursion
+  "GotoFsm.bas",  // GOTO-heavy state machine
+  "Math.bas",  // expression-heavy math
+  "Print.bas",  // PRINT-heavy output
+  "Branch.bas",  // IF/ELSE-heavy branching
+  "ArrayOps.bas",  // whole-array built-ins
+  "ArrayLoop.bas",  // the work of ArrayOps.bas by FOR loops
+  NULL
+};
+//===========================================
+struct RunResult  // result of a run, sent by the child to the parent
+{
+  bool Ok;  // true = the run had no errors
+  double Secs;  // wall time of the execution
+  long long NumCmds;  // num of commands executed, profiled runs only
+};
+//===========================================
+// Run program fname once, in the current process.
+
+RunResult RunOnce(const char* fname, bool profile)
+{
+  RunResult res;
+  Program prog;
+  Parser p(prog);
+  int fd = open("/dev/null", O_WRONLY);
+
+  res.Ok = false;
+  res.Secs = 0.0;
+  res.NumCmds = 0;
+
+  prog.GetContext().Out.SetFd(fd);
+  p.GetContext().Out.SetFd(fd);
+
+  if (!prog.Load(fname) || prog.GetNumErrors())
+    return res;
+
+  p.SetProfile(profile);
+  p.SetJit(JitMode);
+
+  auto start = std::chrono::steady_clock::now();
+  res.Ok = p.Execute();
+  res.Secs = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+
+  if (profile)
+    res.NumCmds = p.GetNumCmds();
+
+  return res;
+}
+//===========================================
+// Run program fname once in a child process.
+// Return the result in res and the peak RSS of the child in KB in
+// max_rss. Return false if the child failed.
+
+bool RunChild(const char* fname, bool profile, RunResult& res,
+  long& max_rss)
+{
+  struct rusage usage;
+  int fds[2], status;
+  pid_t pid;
+  bool ok;
+
+  if (pipe(fds) < 0)
+    return false;
+
+  fflush(stdout);
+  pid = fork();
+
+  if (pid < 0)
+    return false;
+
+  if (pid == 0)  // child
+  {
+    close(fds[0]);
+    res = RunOnce(fname, profile);
+    ok = write(fds[1], &res, sizeof(res)) == sizeof(res);
+    _exit(ok ? 0 : 1);
+  }
+
+  close(fds[1]);
+  ok = read(fds[0], &res, sizeof(res)) == sizeof(res);
+  close(fds[0]);
+
+  if (wait4(pid, &status, 0, &usage) < 0)
+    return false;
+
+  max_rss = usage.ru_maxrss;  // KB on Linux
+  return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0 && res.Ok;
+}
+//===========================================
+int CompSecs(const void* a, const void* b)
+{
+  double x = *(const double*) a, y = *(const double*) b;
+
+  return x < y ? -1 : x > y ? 1 : 0;
+}
+//===========================================
+// Benchmark program fname and output its JSON object.
+// Return false if any run failed.
+
+bool Bench(const char* fname, int runs, bool last)
+{
+  RunResult res;
+  double secs[MAX_RUNS], median;
+  long long num_cmds = 0;
+  long rss, peak_rss = 0;
+  bool ok;
+  int i;
+
+  ok = RunChild(fname, true, res, rss);  // count the commands
+  num_cmds = res.NumCmds;
+  peak_rss = rss;
+
+  for (i = 0; i < runs && ok; i++)
+  {
+    ok = RunChild(fname, false, res, rss);
+    secs[i] = res.Secs;
+
+    if (rss > peak_rss)
+      peak_rss = rss;
+  }
+
+  median = 0.0;
+
+  if (ok)
+  {
+    qsort(secs, runs, sizeof(double), CompSecs);
+    median = runs % 2 ? secs[runs/2] : (secs[runs/2-1] + secs[runs/2]) / 2;
+  }
+
+  printf("    {\n");
+  printf("      \"name\": \"%s\",\n", fname);
+  printf("      \"ok\": %s,\n", ok ? "true" : "false");
+  printf("      \"statements\": %lld,\n", num_cmds);
+  printf("      \"median_s\": %.6f,\n", median);
+  printf("      \"min_s\": %.6f,\n", ok ? secs[0] : 0.0);
+  printf("      \"max_s\": %.6f,\n", ok ? secs[runs-1] : 0.0);
+  printf("      \"statements_per_s\": %.0f,\n",
+    median > 0.0 ? num_cmds / median : 0.0);
+  printf("      \"ns_per_statement\": %.3f,\n",
+    num_cmds ? median * 1e9 / num_cmds : 0.0);
+  printf("      \"peak_rss_kb\": %ld\n", peak_rss);
+  printf("    }%s\n", last ? "" : ",");
+  return ok;
+}
+//===========================================
+int main(int argc, const char* argv[])
+{
+  const char** fnames = Workloads;
+  int i = 1, n, runs = DEF_RUNS;
+  bool ok = true;
+
+  if (argc > 2 && !strcmp(argv[1], "-n"))
+  {
+    runs = atoi(argv[2]);
+    i = 3;
+  }
+
+  if (i < argc && !strcmp(argv[i], "-i"))
+  {
+    JitMode = false;
+    i++;
+  }
+
+  if (i < argc && !strcmp(argv[i], "-s"))
+  {
+    SetSimdLimit(siSCALAR);
+    i++;
+  }
+
+  if (runs < 1 || runs > MAX_RUNS)
+  {
+    fprintf(stderr, "The num of runs must be 1 ... %d.\n", MAX_RUNS);
+    return 1;
+  }
+
+  if (i < argc)
+    fnames = argv + i;  // argv[argc] is NULL, like the end of Workloads
+
+  for (n = 0; fnames[n] != NULL; n++)
+    ;
+
+  printf("{\n");
+  printf("  \"format\": %d,\n", BENCH_FORMAT);
+  printf("  \"runs\": %d,\n", runs);
+  printf("  \"jit\": %s,\n", JitMode ? "true" : "false");
+  printf("  \"simd\": \"%s\",\n", GetSimd().Name);
+  printf("  \"benchmarks\": [\n");
+
+  for (i = 0; i < n; i++)
+    if (!Bench(fnames[i], runs, i == n - 1))
+      ok = false;
+
+  printf("  ]\n");
+  printf("}\n");
+  return ok ? 0 : 1;
+}
+//===========================================
@@ -0,0 +1,24 @@
+REM Branch.bas
+REM IF/ELSE-heavy branching: nested IF ... ELSE ... ENDIF blocks with
+REM conditions that change on every pass.
+
+A = 0
+B = 0
+C = 0
+D = 0
+FOR I = 1 TO 1000000
+  IF I % 3 = 0 THEN
+    A = A + 1
+  ELSE
+    IF I % 5 = 0 THEN
+      B = B + 1
+    ELSE
+      C = C + 1
+    ENDIF
+  ENDIF
+  IF I % 2 = 0 AND I % 7 <> 0 THEN
+    D = D + 1
+  ENDIF
+NEXT
+PRINT "A =", A, "B =", B, "C =", C, "D =", D
+END
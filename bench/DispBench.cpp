@@ -0,0 +1,116 @@
+//===========================================
+//
+//  DispBench.cpp
+//
+// Author: Theo P. (theo_pap@otenet.gr)
+// Language used: C++
+// Copyright: No copyright. You can do with this software whatever
+// you like.
+// Warranty: No warranty. Use this software at your own risk.
+//
+// Microbenchmark of the command dispatch of the executor.
+// Runs two generated programs with the same FOR loop: one with an
+// empty block and one with a block of REM lines. A REM line is a
+// single EOL token, the cheapest command there is, so the time
+// difference per REM line is the dispatch overhead per command.
+// Native code is off, else the hot loop would not be dispatched.
+//
+// Build both dispatch modes from the bench directory:
+//   g++ -std=c++17 -O2 -I.. -o DispBench DispBench.cpp ../[A-HJ-Z]*.cpp
+//   g++ -std=c++17 -O2 -I.. -DNO_COMPUTED_GOTO -o DispBenchSw
+//     DispBench.cpp ../[A-HJ-Z]*.cpp
+// (Interpreter.cpp is left out, it has its own main.)
+// Run:
+//   DispBench [loop_count]
+//===========================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include "Parser.h"
+
+//===========================================
+const int NUM_REMS = 100;  // num of REM lines in loop block
+const char* EMPTY_FNAME = "DispEmpty.bas";
+const char* REMS_FNAME = "DispRems.bas";
+//===========================================
+// Write a program with a FOR loop of count passes, its block made of
+// num_rems REM lines.
+
+bool WriteProg(const char* fname, int count, int num_rems)
+{
+  FILE* fp = fopen(fname, "w");
+  int i;
+
+  if (fp == NULL)
+    return false;
+
+  fprintf(fp, "FOR I = 1 TO %d\n", count);
+
+  for (i = 0; i < num_rems; i++)
+    fprintf(fp, "REM\n");
+
+  fprintf(fp, "NEXT\nEND\n");
+  fclose(fp);
+  return true;
+}
+//===========================================
+// Return the elapsed secs of running program fname.
+
+double RunProg(const char* fname)
+{
+  std::chrono::steady_clock::time_point start, stop;
+  Program prog;
+  Parser p(prog);
+
+  if (!prog.Load(fname))
+    return 0.0;
+
+  p.SetJit(false);  // the loop must run in the executor, not natively
+
+  start = std::chrono::steady_clock::now();
+  p.Execute();
+  stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(stop - start).count();
+}
+//===========================================
+int main(int argc, const char* argv[])
+{
+  int count = 1000000;
+  double empty_secs, rems_secs, num_cmds;
+
+  if (argc > 1)
+    count = atoi(argv[1]);
+
+  if (count <= 0)
+  {
+    printf("Usage: %s [loop_count]\n", argv[0]);
+    return 1;
+  }
+
+  if (!WriteProg(EMPTY_FNAME, count, 0) ||
+    !WriteProg(REMS_FNAME, count, NUM_REMS))
+  {
+    printf("Cannot write the test programs.\n");
+    return 1;
+  }
+
+  empty_secs = RunProg(EMPTY_FNAME);
+  rems_secs = RunProg(REMS_FNAME);
+  num_cmds = double(count) * NUM_REMS;
+  remove(EMPTY_FNAME);
+  remove(REMS_FNAME);
+
+#ifdef COMPUTED_GOTO
+  printf("Dispatch: computed goto\n");
+#else
+  printf("Dispatch: switch\n");
+#endif
+  printf("Commands dispatched: %.0f\n", num_cmds);
+  printf("Loop overhead: %.3f s\n", empty_secs);
+  printf("Dispatch time: %.3f s\n", rems_secs - empty_secs);
+  printf("Per command: %.2f ns\n",
+    (rems_secs - empty_secs) / num_cmds * 1e9);
+  return 0;
+}
+//===========================================
@@ -0,0 +1,188 @@
+//===========================================
+//
+//  FmtBench.cpp
+//
+// Author: Theo P. (theo_pap@otenet.gr)
+// Language used: C++
+// Copyright: No copyright. You can do with this software whatever
+// you like.
+// Warranty: No warranty. Use this software at your own risk.
+//
+// Benchmark of DispFloat() against the old printf-based version.
+// Formats the same set of nums with both and reports nums/s.
+// The output goes to the null device, so only formatting is timed.
+//
+// Build from the bench directory:
+//   g++ -std=c++17 -O2 -I.. -o FmtBench FmtBench.cpp ../Misc.cpp
+//     ../Output.cpp
+// Run:
+//   FmtBench [num_count]
+//===========================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <chrono>
+#ifdef _WIN32
+#include <io.h>
+#define NULL_DEV "NUL"
+#define open _open
+#else
+#include <unistd.h>
+#define NULL_DEV "/dev/null"
+#endif
+#include "Misc.h"
+#include "Output.h"
+
+//===========================================
+Output Out;  // formatted nums go here
+//===========================================
+const int NUM_PRECS = 4;  // num of precisions tested
+const int PRECS[NUM_PRECS] = { 0, 2, 4, 6 };
+//===========================================
+// The old DispFloat(), kept here for comparison.
+// It scales by repeated *= 10, truncates through int and prints the
+// parts with printf, so 2.8 -> 2.79 and nums beyond int overflow.
+
+void OldDispFloat(double num, int ndp)
+{
+  int i, ip;  // ip = integer part
+  double fp;  // fp = fractional part
+
+  if (ndp > 6)
+    ndp = 6;  // max precision possible
+
+  if (num == 0.0)
+  {
+    printf("0");
+
+    if (ndp == 0)
+      return;
+
+    printf(".");
+
+    for (i = 0; i < ndp; i++)
+      printf("0");
+
+    return;
+  }
+
+  if (num < 0.0)
+  {
+    printf("-");
+    num = -num;
+  }
+
+  for (i = 0; i < ndp; i++)
+    num *= 10;
+
+  num = double(int(num + 0.5));
+
+  for (i = 0; i < ndp; i++)
+    num /= 10;
+
+  ip = int(num);
+  fp = num - double(ip);
+  printf("%d", ip);
+
+  if (ndp == 0)
+    return;
+
+  printf(".");
+
+  if (fp == 0.0)
+  {
+    for (i = 0; i < ndp; i++)
+      printf("0");
+
+    return;
+  }
+
+  for (i = 0; i < ndp; i++)
+    fp *= 10;
+
+  printf("%d", int(fp));
+}
+//===========================================
+// The new DispFloat(), writing to Out.
+
+void NewDispFloat(double num, int ndp)
+{
+  DispFloat(Out, num, ndp);
+}
+//===========================================
+// Return the elapsed secs of formatting all nums with func.
+
+double TimeFunc(void (*func)(double, int), const double* nums, int count)
+{
+  std::chrono::steady_clock::time_point start, stop;
+  int i, j;
+
+  start = std::chrono::steady_clock::now();
+
+  for (j = 0; j < NUM_PRECS; j++)
+    for (i = 0; i < count; i++)
+    {
+      func(nums[i], PRECS[j]);
+      func == OldDispFloat ? (void) putchar('\n') : Out.PutCh('\n');
+    }
+
+  fflush(stdout);
+  Out.Flush();
+  stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(stop - start).count();
+}
+//===========================================
+int main(int argc, const char* argv[])
+{
+  int i, count = 1000000;
+  double* nums;
+  double old_secs, new_secs, total;
+  int fd;
+
+  if (argc > 1)
+    count = atoi(argv[1]);
+
+  if (count <= 0)
+  {
+    printf("Usage: %s [num_count]\n", argv[0]);
+    return 1;
+  }
+
+  nums = new double [count];
+
+  // a mix of ints, short decimals and nums with many digits
+  srand(1);
+
+  for (i = 0; i < count; i++)
+    switch (i % 3)
+    {
+      case 0: nums[i] = rand() % 100000; break;
+      case 1: nums[i] = (rand() % 100000) / 100.0; break;
+      case 2: nums[i] = (rand() - RAND_MAX / 2) / 7.0; break;
+    }
+
+  fd = open(NULL_DEV, O_WRONLY);
+
+  if (fd < 0 || freopen(NULL_DEV, "w", stdout) == NULL)
+  {
+    fprintf(stderr, "Cannot open %s.\n", NULL_DEV);
+    return 1;
+  }
+
+  Out.SetFd(fd);
+  old_secs = TimeFunc(OldDispFloat, nums, count);
+  new_secs = TimeFunc(NewDispFloat, nums, count);
+  total = double(count) * NUM_PRECS;
+
+  fprintf(stderr, "Nums formatted: %.0f\n", total);
+  fprintf(stderr, "Old DispFloat: %.3f s, %.0f nums/s\n", old_secs,
+    total / old_secs);
+  fprintf(stderr, "New DispFloat: %.3f s, %.0f nums/s\n", new_secs,
+    total / new_secs);
+  fprintf(stderr, "Speedup: %.2fx\n", old_secs / new_secs);
+
+  delete [] nums;
+  return 0;
+}
+//===========================================
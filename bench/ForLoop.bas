@@ -0,0 +1,11 @@
+REM ForLoop.bas
+REM Tight nested FOR loops with a simple assignment in the body.
+
+S = 0
+FOR I = 1 TO 5000
+  FOR J = 1 TO 1000
+    S = S + J
+  NEXT
+NEXT
+PRINT "S =", S
+END
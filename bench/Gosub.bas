@@ -0,0 +1,18 @@
+REM Gosub.bas
+REM Deep GOSUB recursion: a subroutine that calls itself 30 times
+REM (the GOSUB stack holds its first 32 levels in place), run many times.
+
+C = 0
+FOR I = 1 TO 60000
+  D = 30
+  GOSUB 100
+NEXT
+PRINT "C =", C
+END
+
+100 IF D > 0 THEN
+  D = D - 1
+  C = C + 1
+  GOSUB 100
+ENDIF
+RETURN
@@ -0,0 +1,23 @@
+REM GotoFsm.bas
+REM A state machine made of GOTOs: the Collatz steps of a number,
+REM one state per label, restarted on a new number when it reaches 1.
+
+K = 0
+X = 27
+100 K = K + 1
+IF K > 1000000 THEN
+  GOTO 900
+ENDIF
+IF X % 2 = 0 THEN
+  GOTO 200
+ENDIF
+GOTO 300
+200 X = X / 2
+GOTO 400
+300 X = 3 * X + 1
+400 IF X = 1 THEN
+  X = K % 97 + 27
+ENDIF
+GOTO 100
+900 PRINT "K =", K, "X =", X
+END
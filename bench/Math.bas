@@ -0,0 +1,13 @@
+REM Math.bas
+REM Expression-heavy math: long exprs with all the built-in funcs.
+
+PRECISION 6
+S = 0
+FOR I = 1 TO 500000
+  X = I / 1000
+  Y = SQR(X * X + 1) + POW(X, 2) - EXP(X / 1000) * LOG(X + 1)
+  Z = ABS(Y - X) * SGN(Y) + FIX(Y / 3) - CINT(X) % 7
+  S = S + (Y + Z) / (1 + X * X)
+NEXT
+PRINT "S =", S
+END
@@ -0,0 +1,8 @@
+REM Print.bas
+REM PRINT-heavy output: strings, integers and fractions on every line.
+
+PRECISION 3
+FOR I = 1 TO 300000
+  PRINT "Line", I, I / 7; I * 1.5
+NEXT
+END